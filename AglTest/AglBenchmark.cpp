@@ -0,0 +1,642 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglBenchmark.cpp
+//
+
+#include "AglBenchmark.h"
+#include "AglImagePool.h"
+#include "AglOffscreenContext.h"
+#include "AglPooledImage.h"
+#include "AglRawVideoRecorder.h"
+#include "AglTextureStream.h"
+#include "AglTextureUbyte.h"
+#include "AglThreadPool.h"
+#include "AglUploadFormat.h"
+#include "AglUtilities.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace Agl
+{
+    
+    namespace
+    {
+        
+        // Return the average time in milliseconds for one call of the
+        // function, over enough calls to make the timing meaningful.
+        
+        template <typename Function>
+        double averageMilliseconds(Function function, int iterations = 20)
+        {
+            function();
+            
+            std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i)
+                function();
+            std::chrono::steady_clock::duration elapsed =
+                std::chrono::steady_clock::now() - start;
+            
+            return std::chrono::duration<double, std::milli>(elapsed).count() /
+                   iterations;
+        }
+        
+    }
+    
+    void benchmarkReduceImageBy2Parallel()
+    {
+        std::cerr << "Starting Agl::benchmarkReduceImageBy2Parallel()\n";
+        
+        // A 4K camera frame.
+        
+        const GLsizei width = 3840;
+        const GLsizei height = 2160;
+        const GLsizei bytesPerPixel = 4;
+        
+        std::vector<GLubyte> orig(width * height * bytesPerPixel, 128);
+        std::vector<GLubyte> result(width / 2 * height / 2 * bytesPerPixel);
+        
+        double serial = averageMilliseconds([&]
+        {
+            reduceImageBy2(result.data(), orig.data(), width, height,
+                           bytesPerPixel);
+        });
+        
+        std::cerr << "reduceImageBy2(): " << std::fixed << std::setprecision(3)
+                  << serial << " ms\n";
+        
+        GLsizei maxThreads = GLsizei(ThreadPool::shared().threadCount() + 1);
+        for (GLsizei threads = 1; threads <= maxThreads; ++threads)
+        {
+            double parallel = averageMilliseconds([&]
+            {
+                reduceImageBy2Parallel(result.data(), orig.data(), width,
+                                       height, bytesPerPixel, 0, 0, 0, threads);
+            });
+            
+            std::cerr << "reduceImageBy2Parallel(), " << threads
+                      << " thread(s): " << parallel << " ms, speedup "
+                      << std::setprecision(2) << serial / parallel << "x\n"
+                      << std::setprecision(3);
+        }
+        
+        std::cerr << "done\n";
+    }
+    
+    void benchmarkReduceImageBy2Srgb()
+    {
+        std::cerr << "Starting Agl::benchmarkReduceImageBy2Srgb()\n";
+        
+        const GLsizei width = 3840;
+        const GLsizei height = 2160;
+        const GLsizei bytesPerPixel = 4;
+        
+        std::vector<GLubyte> orig(width * height * bytesPerPixel);
+        for (size_t i = 0; i < orig.size(); ++i)
+            orig[i] = GLubyte(i * 7 + i / 4096);
+        std::vector<GLubyte> result(width / 2 * height / 2 * bytesPerPixel);
+        
+        double bytes = averageMilliseconds([&]
+        {
+            reduceImageBy2(result.data(), orig.data(), width, height,
+                           bytesPerPixel);
+        });
+        double srgb = averageMilliseconds([&]
+        {
+            reduceImageBy2Srgb(result.data(), orig.data(), width, height,
+                               bytesPerPixel);
+        });
+        
+        std::cerr << std::fixed << std::setprecision(3)
+                  << "reduceImageBy2(): " << bytes << " ms\n"
+                  << "reduceImageBy2Srgb(): " << srgb << " ms, "
+                  << std::setprecision(2) << srgb / bytes << "x as long\n";
+        
+        std::cerr << "done\n";
+    }
+    
+    void benchmarkConvertToRgba()
+    {
+        std::cerr << "Starting Agl::benchmarkConvertToRgba()\n";
+        
+        const GLsizei width = 3840;
+        const GLsizei height = 2160;
+        
+        std::vector<GLubyte> yuyv(width * height * 2);
+        for (size_t i = 0; i < yuyv.size(); ++i)
+            yuyv[i] = GLubyte(i * 7 + i / 4096);
+        std::vector<GLubyte> result(width * height * 4);
+        
+        GLsizei maxThreads = GLsizei(ThreadPool::shared().threadCount() + 1);
+        for (GLsizei threads = 1; threads <= maxThreads; ++threads)
+        {
+            double yuyvTime = averageMilliseconds([&]
+            {
+                convertYuyvToRgba(result.data(), yuyv.data(), width, height,
+                                  0, 0, 0, threads);
+            });
+            double nv12Time = averageMilliseconds([&]
+            {
+                convertNv12ToRgba(result.data(), yuyv.data(),
+                                  yuyv.data() + width * height, width, height,
+                                  0, 0, 0, threads);
+            });
+            
+            std::cerr << std::fixed << std::setprecision(3) << threads
+                      << " thread(s): convertYuyvToRgba() " << yuyvTime
+                      << " ms, convertNv12ToRgba() " << nv12Time << " ms\n";
+        }
+        
+        std::cerr << "done\n";
+    }
+    
+    void benchmarkReduceYuvToRgbaBy2()
+    {
+        std::cerr << "Starting Agl::benchmarkReduceYuvToRgbaBy2()\n";
+        
+        const GLsizei width = 3840;
+        const GLsizei height = 2160;
+        
+        std::vector<GLubyte> yuyv(width * height * 2);
+        for (size_t i = 0; i < yuyv.size(); ++i)
+            yuyv[i] = GLubyte(i * 7 + i / 4096);
+        std::vector<GLubyte> rgba(width * height * 4);
+        std::vector<GLubyte> result(width / 2 * height / 2 * 4);
+        
+        double separate = averageMilliseconds([&]
+        {
+            convertYuyvToRgba(rgba.data(), yuyv.data(), width, height);
+            reduceImageBy2Parallel(result.data(), rgba.data(), width, height, 4);
+        });
+        double fused = averageMilliseconds([&]
+        {
+            reduceYuyvToRgbaBy2(result.data(), yuyv.data(), width, height);
+        });
+        
+        std::cerr << std::fixed << std::setprecision(3)
+                  << "convertYuyvToRgba() then reduceImageBy2Parallel(): "
+                  << separate << " ms\n"
+                  << "reduceYuyvToRgbaBy2(): " << fused << " ms, speedup "
+                  << std::setprecision(2) << separate / fused << "x\n";
+        
+        std::cerr << "done\n";
+    }
+    
+    void benchmarkImagePoolContention()
+    {
+        std::cerr << "Starting Agl::benchmarkImagePoolContention()\n";
+        
+        // Every thread repeatedly allocates and frees, which is much more
+        // contention than a real producer and consumer would cause, to show
+        // how the cost of the pool operations scales with threads, with and
+        // without thread caches.  The total work is the same for each thread
+        // count, so on enough cores the time per pair should drop.
+        
+        const int totalPairs = 4000000;
+        
+        for (size_t threadCacheSize : {size_t(0), size_t(8)})
+        {
+            std::cerr << "Thread cache size " << threadCacheSize << ":\n";
+            for (int threadCount = 1; threadCount <= 64; threadCount *= 2)
+            {
+                ImagePool pool;
+                ImagePool::Options options;
+                options.threadCacheSize = threadCacheSize;
+                pool.setImageSize(640, 480, 4, options);
+                
+                int pairsPerThread = totalPairs / threadCount;
+                double milliseconds = averageMilliseconds([&]
+                {
+                    std::vector<std::thread> threads;
+                    for (int t = 0; t < threadCount; ++t)
+                    {
+                        threads.push_back(std::thread([&pool, pairsPerThread]
+                        {
+                            for (int i = 0; i < pairsPerThread; ++i)
+                            {
+                                GLubyte* image = pool.alloc();
+                                image[0] = GLubyte(i);
+                                pool.free(image);
+                            }
+                        }));
+                    }
+                    for (std::thread& thread : threads)
+                        thread.join();
+                }, 3);
+                
+                double pairs = double(pairsPerThread) * threadCount;
+                ImagePool::Stats stats = pool.stats();
+                std::cerr << std::fixed << std::setprecision(1) << threadCount
+                          << " thread(s): " << milliseconds * 1.0e6 / pairs
+                          << " ns per alloc() and free(), "
+                          << std::setprecision(1)
+                          << pairs / milliseconds / 1000.0
+                          << " M pairs/s, " << std::setprecision(3)
+                          << double(stats.retryCount) / stats.allocCount
+                          << " retries per alloc(), "
+                          << stats.highWaterCount << " images at most\n";
+            }
+        }
+        
+        std::cerr << "done\n";
+    }
+    
+    void benchmarkRawVideoRecorder()
+    {
+        std::cerr << "Starting Agl::benchmarkRawVideoRecorder()\n";
+        
+        // A producer submits frames as fast as it can, which shows the most
+        // a submit() call takes (the stall the render loop would see) and how
+        // many frames the writer keeps up with, through the file cache and
+        // with direct I/O.
+        
+        const GLsizei width = 640;
+        const GLsizei height = 480;
+        const int frameCount = 200;
+        
+        ImagePool pool;
+        pool.setImageSize(width, height, 4);
+        
+        for (bool directIo : {false, true})
+        {
+            char path[] = "/tmp/aglbenchmark-XXXXXX";
+            int fd = mkstemp(path);
+            close(fd);
+            
+            RawVideoRecorder::Options options;
+            options.directIo = directIo;
+            options.preallocateFrameCount = frameCount;
+            RawVideoRecorder recorder(path, width, height, 4, options);
+            
+            double maxSubmitMilliseconds = 0;
+            std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+            for (int i = 0; i < frameCount; ++i)
+            {
+                PooledImage image(pool);
+                memset(image.data(), i, width * height * 4);
+                
+                std::chrono::steady_clock::time_point submitStart =
+                    std::chrono::steady_clock::now();
+                recorder.submit(std::move(image));
+                maxSubmitMilliseconds = std::max(maxSubmitMilliseconds,
+                    std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - submitStart).count());
+            }
+            recorder.close();
+            double milliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            unlink(path);
+            
+            RawVideoRecorder::Stats stats = recorder.stats();
+            std::cerr << std::fixed << std::setprecision(3)
+                      << (directIo ? "Direct I/O: " : "File cache: ")
+                      << maxSubmitMilliseconds << " ms longest submit(), "
+                      << stats.writtenCount << " written, "
+                      << stats.droppedCount << " dropped, "
+                      << std::setprecision(1)
+                      << stats.bytesWritten / 1.0e6 / (milliseconds / 1000.0)
+                      << " MB/s, " << stats.writeCount << " writes\n";
+        }
+        
+        std::cerr << "done\n";
+    }
+    
+    
+    void benchmarkTextureUpload()
+    {
+        std::cerr << "Starting Agl::benchmarkTextureUpload()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        std::cerr << "Renderer: " << glGetString(GL_RENDERER) << "\n";
+        
+        // Stream frames of one size, as from a camera, comparing the
+        // original approach of respecifying the texture with glTexImage2D()
+        // for every frame against TextureUbyte::setData(), which allocates
+        // the storage once and copies later frames into it.  A byte of each
+        // frame changes so no frame is identical to the previous one, and
+        // glFinish() makes each upload complete within its timing.
+        
+        const GLsizei sizes [][2] = { { 1280, 720 }, { 1920, 1080 } };
+        
+        for (const GLsizei* size : sizes)
+        {
+            const GLsizei width = size[0];
+            const GLsizei height = size[1];
+            std::vector<GLubyte> frame(width * height * 4, 100);
+            GLubyte counter = 0;
+            
+            GLuint reallocated = 0;
+            glGenTextures(1, &reallocated);
+            double respecify = averageMilliseconds([&]
+            {
+                frame[0] = ++counter;
+                glBindTexture(GL_TEXTURE_2D, reallocated);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
+                             GL_RGBA, GL_UNSIGNED_BYTE, frame.data());
+                glFinish();
+            }, 50);
+            glDeleteTextures(1, &reallocated);
+            
+            TextureUbyte texture(GL_TEXTURE_2D);
+            texture.build();
+            double stream = averageMilliseconds([&]
+            {
+                frame[0] = ++counter;
+                texture.setData(frame.data(), width, height);
+                glFinish();
+            }, 50);
+            
+            std::cerr << std::fixed << std::setprecision(3)
+                      << width << "x" << height << ": glTexImage2D() per frame "
+                      << respecify << " ms, setData() " << stream << " ms, "
+                      << std::setprecision(2) << respecify / stream
+                      << "x faster\n";
+        }
+        
+        std::cerr << "done\n";
+    }
+    
+    void benchmarkTextureStream()
+    {
+        std::cerr << "Starting Agl::benchmarkTextureStream()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        std::cerr << "Renderer: " << glGetString(GL_RENDERER) << "\n";
+        
+        // Time only the render thread's upload call for each frame, comparing
+        // TextureUbyte::setData() from client memory with a TextureStream.
+        // The glFinish() after each upload stands in for the rest of the
+        // frame's rendering, and is not timed, so the result is the cost the
+        // upload adds to the critical path.
+        
+        const GLsizei sizes [][2] = { { 1280, 720 }, { 1920, 1080 } };
+        const int iterations = 50;
+        
+        for (const GLsizei* size : sizes)
+        {
+            const GLsizei width = size[0];
+            const GLsizei height = size[1];
+            std::vector<GLubyte> frame(width * height * 4, 100);
+            ImageView view(frame.data(), width, height, 4);
+            GLubyte counter = 0;
+            
+            TextureUbyte direct(GL_TEXTURE_2D);
+            direct.build();
+            std::chrono::steady_clock::duration directTime(0);
+            for (int i = 0; i <= iterations; ++i)
+            {
+                frame[0] = ++counter;
+                std::chrono::steady_clock::time_point start =
+                    std::chrono::steady_clock::now();
+                direct.setData(frame.data(), width, height);
+                if (i > 0)
+                    directTime += std::chrono::steady_clock::now() - start;
+                glFinish();
+            }
+            
+            TextureUbyte streamed(GL_TEXTURE_2D);
+            streamed.build();
+            TextureStream stream(streamed, width, height);
+            std::chrono::steady_clock::duration streamTime(0);
+            for (int i = 0; i <= iterations; ++i)
+            {
+                frame[0] = ++counter;
+                std::chrono::steady_clock::time_point start =
+                    std::chrono::steady_clock::now();
+                stream.upload(view);
+                if (i > 0)
+                    streamTime += std::chrono::steady_clock::now() - start;
+                glFinish();
+            }
+            
+            double directMs = std::chrono::duration<double, std::milli>(
+                directTime).count() / iterations;
+            double streamMs = std::chrono::duration<double, std::milli>(
+                streamTime).count() / iterations;
+            
+            std::cerr << std::fixed << std::setprecision(3)
+                      << width << "x" << height << ": setData() " << directMs
+                      << " ms, TextureStream::upload() " << streamMs << " ms ("
+                      << stream.waitCount() << " waits), speedup "
+                      << std::setprecision(2) << directMs / streamMs << "x\n";
+        }
+        
+        std::cerr << "done\n";
+    }
+    
+    void benchmarkUploadFormats()
+    {
+        std::cerr << "Starting Agl::benchmarkUploadFormats()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        std::cerr << "Renderer: " << glGetString(GL_RENDERER) << "\n";
+        
+        // The upload bandwidth of a 1080p frame for each combination, in
+        // megabytes and in megapixels per second, since the 16-bit packed
+        // formats move half the bytes for each pixel.
+        
+        struct Format
+        {
+            const char* name;
+            GLint       internalFormat;
+            GLenum      format;
+            GLenum      type;
+            GLsizei     bytesPerPixel;
+        };
+        const Format formats [] =
+        {
+            { "RGBA UNSIGNED_BYTE", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+            { "RGBA UNSIGNED_INT_8_8_8_8_REV", GL_RGBA8, GL_RGBA,
+              GL_UNSIGNED_INT_8_8_8_8_REV, 4 },
+            { "BGRA UNSIGNED_BYTE", GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, 4 },
+            { "BGRA UNSIGNED_INT_8_8_8_8_REV", GL_RGBA8, GL_BGRA,
+              GL_UNSIGNED_INT_8_8_8_8_REV, 4 },
+            { "RGB UNSIGNED_SHORT_5_6_5", GL_RGB5, GL_RGB,
+              GL_UNSIGNED_SHORT_5_6_5, 2 },
+            { "BGRA UNSIGNED_SHORT_1_5_5_5_REV", GL_RGB5_A1, GL_BGRA,
+              GL_UNSIGNED_SHORT_1_5_5_5_REV, 2 },
+            { "BGRA UNSIGNED_SHORT_4_4_4_4_REV", GL_RGBA4, GL_BGRA,
+              GL_UNSIGNED_SHORT_4_4_4_4_REV, 2 }
+        };
+        
+        const GLsizei width = 1920;
+        const GLsizei height = 1080;
+        
+        for (const Format& format : formats)
+        {
+            double rate = measureUploadRate(format.internalFormat, format.format,
+                                            format.type, format.bytesPerPixel,
+                                            width, height, 20);
+            double pixelRate = rate * 1024 * 1024 / format.bytesPerPixel / 1e6;
+            std::cerr << std::fixed << std::setprecision(0)
+                      << std::setw(32) << std::left << format.name << std::right
+                      << std::setw(7) << rate << " MB/s, " << std::setw(5)
+                      << pixelRate << " Mpixels/s\n";
+        }
+        
+        GLenum preferred = preferredUploadFormat();
+        GLenum type = preferredUploadType(preferred);
+        std::cerr << "Preferred: "
+                  << ((preferred == GL_BGRA) ? "BGRA" : "RGBA") << " "
+                  << ((type == GL_UNSIGNED_BYTE) ? "UNSIGNED_BYTE" :
+                      "UNSIGNED_INT_8_8_8_8_REV") << "\n";
+        
+        std::cerr << "done\n";
+    }
+    
+    void benchmarkMipmapUpload()
+    {
+        std::cerr << "Starting Agl::benchmarkMipmapUpload()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        std::cerr << "Renderer: " << glGetString(GL_RENDERER) << "\n";
+        
+        // The cost of a whole 1080p frame with each mipmap policy, waiting
+        // for the upload to finish, and of a frame in which one 64 by 64
+        // tile changed, with updateData().
+        
+        const GLsizei width = 1920;
+        const GLsizei height = 1080;
+        std::vector<GLubyte> frame(width * height * 4, 100);
+        ImageView view(frame.data(), width, height, 4);
+        GLubyte counter = 0;
+        
+        const TextureUbyte::MipmapPolicy policies [] =
+        {
+            TextureUbyte::MipmapNone, TextureUbyte::MipmapGenerate,
+            TextureUbyte::MipmapPyramid, TextureUbyte::MipmapAutomatic
+        };
+        const char* names [] = { "none", "generate", "pyramid", "automatic" };
+        
+        for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); ++i)
+        {
+            TextureUbyte texture(GL_TEXTURE_2D);
+            texture.build();
+            texture.setMipmapPolicy(policies[i]);
+            
+            double whole = averageMilliseconds([&]
+            {
+                frame[0] = ++counter;
+                texture.setData(view);
+                glFinish();
+            }, 20);
+            
+            texture.updateData(view);
+            double tile = averageMilliseconds([&]
+            {
+                frame[(500 * width + 700) * 4] = ++counter;
+                texture.updateData(view);
+                glFinish();
+            }, 20);
+            
+            std::cerr << std::fixed << std::setprecision(3) << std::setw(9)
+                      << names[i] << ": setData() " << whole
+                      << " ms, updateData() of one tile " << tile << " ms";
+            if (policies[i] == TextureUbyte::MipmapAutomatic)
+            {
+                std::cerr << ", chose "
+                          << names[texture.mipmapMethod()];
+            }
+            std::cerr << "\n";
+        }
+        
+        std::cerr << "done\n";
+    }
+    
+    void benchmarkTextureBind()
+    {
+        std::cerr << "Starting Agl::benchmarkTextureBind()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        std::cerr << "Renderer: " << glGetString(GL_RENDERER) << "\n";
+        
+        // The cost of Texture::bind() when the texture is already bound,
+        // which should be only a lookup, and when it is not, as for a draw
+        // loop that binds a different texture to each of 4 units for each
+        // surface.
+        
+        const int units = 4;
+        const int calls = 100000;
+        std::vector<std::unique_ptr<TextureUbyte>> textures;
+        for (int i = 0; i < 2 * units; ++i)
+        {
+            textures.emplace_back(new TextureUbyte(GL_TEXTURE_2D));
+            textures.back()->build();
+        }
+        
+        double hit = averageMilliseconds([&]
+        {
+            for (int i = 0; i < calls; ++i)
+                textures[i % units]->bind(GLenum(GL_TEXTURE0 + i % units));
+        }, 10);
+        
+        double miss = averageMilliseconds([&]
+        {
+            for (int i = 0; i < calls; ++i)
+            {
+                int unit = i % units;
+                int texture = unit + ((i / units) % 2) * units;
+                textures[texture]->bind(GLenum(GL_TEXTURE0 + unit));
+            }
+        }, 10);
+        
+        std::cerr << std::fixed << std::setprecision(1)
+                  << "bind() of a bound texture " << hit * 1e6 / calls
+                  << " ns, of an unbound texture " << miss * 1e6 / calls
+                  << " ns\n";
+        
+        std::cerr << "done\n";
+    }
+    
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglOffscreenContext.cpp
+//
+
+#include "AglOffscreenContext.h"
+
+#if defined(__APPLE__)
+#include <OpenGL/OpenGL.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace Agl
+{
+    
+#if defined(__APPLE__)
+    
+    bool makeOffscreenContextCurrent()
+    {
+        static CGLContextObj context = nullptr;
+        if (!context)
+        {
+            CGLPixelFormatAttribute attributes [] = {
+                kCGLPFAOpenGLProfile,
+                CGLPixelFormatAttribute(kCGLOGLPVersion_3_2_Core),
+                CGLPixelFormatAttribute(0)
+            };
+            CGLPixelFormatObj pixelFormat = nullptr;
+            GLint count = 0;
+            if ((CGLChoosePixelFormat(attributes, &pixelFormat, &count) != kCGLNoError) ||
+                !pixelFormat)
+                return false;
+            
+            CGLError error = CGLCreateContext(pixelFormat, nullptr, &context);
+            CGLDestroyPixelFormat(pixelFormat);
+            if (error != kCGLNoError)
+            {
+                context = nullptr;
+                return false;
+            }
+        }
+        return CGLSetCurrentContext(context) == kCGLNoError;
+    }
+    
+#else
+    
+    bool makeOffscreenContextCurrent()
+    {
+        static EGLDisplay display = EGL_NO_DISPLAY;
+        static EGLContext context = EGL_NO_CONTEXT;
+        if (context == EGL_NO_CONTEXT)
+        {
+            // Prefer Mesa's surfaceless platform, which needs no display
+            // server.
+            
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                    eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (getPlatformDisplay)
+            {
+                display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                             EGL_DEFAULT_DISPLAY, nullptr);
+            }
+            if (display == EGL_NO_DISPLAY)
+                display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            
+            EGLint major = 0;
+            EGLint minor = 0;
+            if ((display == EGL_NO_DISPLAY) ||
+                !eglInitialize(display, &major, &minor) ||
+                !eglBindAPI(EGL_OPENGL_API))
+                return false;
+            
+            const EGLint attributes [] = {
+                EGL_CONTEXT_MAJOR_VERSION, 3,
+                EGL_CONTEXT_MINOR_VERSION, 2,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+            };
+            context = eglCreateContext(display, EGL_NO_CONFIG_KHR,
+                                       EGL_NO_CONTEXT, attributes);
+            if (context == EGL_NO_CONTEXT)
+                return false;
+        }
+        return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                              context) == EGL_TRUE;
+    }
+    
+#endif
+    
+}
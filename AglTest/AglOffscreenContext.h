@@ -0,0 +1,47 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglOffscreenContext.h
+//
+// An OpenGL context without a window, for the texture tests and the benchmarks
+// of texture uploads.
+// On OS X it is a CGL context, and elsewhere an EGL context, which Mesa
+// provides with its software renderer (llvmpipe) when there is no GPU.
+//
+
+#ifndef __AglOffscreenContext__
+#define __AglOffscreenContext__
+
+namespace Agl
+{
+    
+    // Make an OpenGL 3.2 (or later) core profile context current on the
+    // calling thread, creating it on the first call.  Returns false if no
+    // such context can be created, in which case the caller should skip
+    // its OpenGL work.
+    
+    bool    makeOffscreenContextCurrent();
+    
+}
+
+#endif
@@ -24,8 +24,38 @@
 // AglTest.cpp
 //
 
+#include "AglFrameChannel.h"
+#include "AglImagePool.h"
+#include "AglImageView.h"
+#include "AglOffscreenContext.h"
+#include "AglPooledImage.h"
+#include "AglRawVideoFormat.h"
+#include "AglRawVideoRecorder.h"
+#include "AglRawVideoSource.h"
+#include "AglSharedMemoryImagePool.h"
+#include "AglSizedImagePool.h"
+#include "AglTextureStream.h"
+#include "AglTextureUbyte.h"
+#include "AglThreadPool.h"
+#include "AglTileChangeDetector.h"
+#include "AglTypedImagePool.h"
+#include "AglUploadFormat.h"
 #include "AglUtilities.h"
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <OpenEXR/half.h>
+#include <math.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 namespace Agl
 {
@@ -77,5 +107,3041 @@ namespace Agl
         std::cerr << "ok\n";
     }
     
+    void testReduceImageBy2Sizes()
+    {
+        std::cerr << "Starting Agl::testReduceImageBy2Sizes()\n";
+        
+        // The SIMD implementations of reduceImageBy2() process pixels in
+        // groups, leaving a remainder at the end of each row, so try a variety
+        // of widths, pixel sizes and regions.  The expected results come from
+        // the same arithmetic as in testReduceImageBy2().  With AVX2, the
+        // SSE2 kernel finishes each row, so the widths 98, 50 and 72 leave at
+        // least 16 result bytes after the AVX2 iterations for 1, 2 and 4
+        // bytes per pixel, respectively, to reach the SSE2 main loop.
+        
+        const GLsizei widths [] = { 2, 3, 9, 16, 31, 50, 64, 67, 72, 98, 130,
+                                    257 };
+        
+        srand(1);
+        
+        for (GLsizei bytesPerPixel = 1; bytesPerPixel <= 5; ++bytesPerPixel)
+        {
+            for (GLsizei width : widths)
+            {
+                const GLsizei height = 5;
+                const GLsizei skipPixels = width % 3;
+                const GLsizei skipRows = 1;
+                const GLsizei rowLength = width + skipPixels + 2;
+                
+                std::vector<GLubyte> orig(rowLength * (height + skipRows) *
+                                          bytesPerPixel);
+                for (GLubyte& b : orig)
+                    b = rand() % 256;
+                
+                const GLsizei resultWidth = width / 2;
+                const GLsizei resultHeight = height / 2;
+                std::vector<GLubyte> result(resultWidth * resultHeight *
+                                            bytesPerPixel);
+                
+                reduceImageBy2(result.data(), orig.data(), width, height,
+                               bytesPerPixel, rowLength, skipPixels, skipRows);
+                
+                for (GLsizei i = 0; i < resultHeight; ++i)
+                {
+                    for (GLsizei j = 0; j < resultWidth; ++j)
+                    {
+                        for (GLsizei k = 0; k < bytesPerPixel; ++k)
+                        {
+                            GLsizei x = skipPixels + 2 * j;
+                            GLsizei y = skipRows + 2 * i;
+                            GLuint a = orig[(y * rowLength + x) * bytesPerPixel + k];
+                            GLuint b = orig[(y * rowLength + x + 1) * bytesPerPixel + k];
+                            GLuint c = orig[((y + 1) * rowLength + x) * bytesPerPixel + k];
+                            GLuint d = orig[((y + 1) * rowLength + x + 1) * bytesPerPixel + k];
+                            GLubyte r = result[(i * resultWidth + j) * bytesPerPixel + k];
+                            assert (r == (a + b + c + d) / 4);
+                        }
+                    }
+                }
+            }
+        }
+        
+        std::cerr << "ok\n";
+    }
+    
+    namespace
+    {
+        
+        // The expected result of reducing the components a0 and b0 of adjacent
+        // pixels and a1 and b1 of the pixels below them, as documented for each
+        // component type.
+        
+        GLushort expectedAverage(GLushort a0, GLushort b0, GLushort a1, GLushort b1)
+        {
+            return GLushort((GLuint(a0) + b0 + a1 + b1) / 4);
+        }
+        
+        GLfloat expectedAverage(GLfloat a0, GLfloat b0, GLfloat a1, GLfloat b1)
+        {
+            return ((a0 + a1) + (b0 + b1)) * 0.25f;
+        }
+        
+        half expectedAverage(half a0, half b0, half a1, half b1)
+        {
+            return half(((float(a0) + float(a1)) + (float(b0) + float(b1))) * 0.25f);
+        }
+        
+        GLushort randomComponent(GLushort*)
+        {
+            return GLushort(rand() % 65536);
+        }
+        
+        GLfloat randomComponent(GLfloat*)
+        {
+            return GLfloat(rand()) / RAND_MAX * 1000.0f - 100.0f;
+        }
+        
+        half randomComponent(half*)
+        {
+            return half(GLfloat(rand()) / RAND_MAX * 100.0f - 10.0f);
+        }
+        
+        bool sameComponent(GLushort a, GLushort b)
+        {
+            return a == b;
+        }
+        
+        bool sameComponent(GLfloat a, GLfloat b)
+        {
+            return memcmp(&a, &b, sizeof(a)) == 0;
+        }
+        
+        bool sameComponent(half a, half b)
+        {
+            return a.bits() == b.bits();
+        }
+        
+        // Check the typed reduceImageBy2() and reduceImageBy2Parallel() for a
+        // variety of widths, pixel sizes and regions, as testReduceImageBy2Sizes()
+        // does for bytes.
+        
+        template <class T>
+        void checkReduceImageBy2Typed()
+        {
+            const GLsizei widths [] = { 2, 5, 9, 16, 31, 64, 67, 130 };
+        
+            for (GLsizei componentsPerPixel = 1; componentsPerPixel <= 5;
+                 ++componentsPerPixel)
+            {
+                for (GLsizei width : widths)
+                {
+                    const GLsizei height = 6;
+                    const GLsizei skipPixels = width % 3;
+                    const GLsizei skipRows = 1;
+                    const GLsizei rowLength = width + skipPixels + 1;
+                
+                    std::vector<T> orig(rowLength * (height + skipRows) *
+                                        componentsPerPixel);
+                    for (T& c : orig)
+                        c = randomComponent(static_cast<T*>(nullptr));
+                
+                    const GLsizei resultWidth = width / 2;
+                    const GLsizei resultHeight = height / 2;
+                    std::vector<T> result(resultWidth * resultHeight *
+                                          componentsPerPixel);
+                    std::vector<T> resultParallel(result.size());
+                
+                    reduceImageBy2(result.data(), orig.data(), width, height,
+                                   componentsPerPixel, rowLength, skipPixels,
+                                   skipRows);
+                    reduceImageBy2Parallel(resultParallel.data(), orig.data(),
+                                           width, height, componentsPerPixel,
+                                           rowLength, skipPixels, skipRows, 2);
+                
+                    for (GLsizei i = 0; i < resultHeight; ++i)
+                    {
+                        for (GLsizei j = 0; j < resultWidth; ++j)
+                        {
+                            for (GLsizei k = 0; k < componentsPerPixel; ++k)
+                            {
+                                GLsizei x = skipPixels + 2 * j;
+                                GLsizei y = skipRows + 2 * i;
+                                size_t a = (y * rowLength + x) * componentsPerPixel + k;
+                                size_t b = a + componentsPerPixel;
+                                size_t c = a + rowLength * componentsPerPixel;
+                                size_t d = c + componentsPerPixel;
+                                T e = expectedAverage(orig[a], orig[b], orig[c],
+                                                      orig[d]);
+                                size_t r = (i * resultWidth + j) * componentsPerPixel + k;
+                                assert (sameComponent(result[r], e));
+                                assert (sameComponent(resultParallel[r], e));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        
+    }
+    
+    void testReduceImageBy2Typed()
+    {
+        std::cerr << "Starting Agl::testReduceImageBy2Typed()\n";
+        
+        srand(19);
+        checkReduceImageBy2Typed<GLushort>();
+        checkReduceImageBy2Typed<half>();
+        checkReduceImageBy2Typed<GLfloat>();
+        
+        // The extremes of the 16-bit range must not wrap around.
+        
+        const GLushort extremes [] = {
+            65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+            65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+            0, 1, 65534, 65535, 32767, 32768, 32768, 32769,
+            0, 1, 65534, 65535, 32767, 32768, 32768, 32769
+        };
+        GLushort extremesResult[8];
+        reduceImageBy2(extremesResult, extremes, 16, 2, 1);
+        for (int j = 0; j < 8; ++j)
+        {
+            assert (extremesResult[j] ==
+                    expectedAverage(extremes[2 * j], extremes[2 * j + 1],
+                                    extremes[16 + 2 * j], extremes[16 + 2 * j + 1]));
+        }
+        
+        // A typed pool allocates images of the component type.
+        
+        TypedImagePool<GLfloat> pool;
+        pool.setImageSize(8, 4, 3);
+        assert (pool.imageWidth() == 8);
+        assert (pool.imageHeight() == 4);
+        assert (pool.componentsPerPixel() == 3);
+        assert (pool.pool().bytesPerPixel() == 3 * GLsizei(sizeof(GLfloat)));
+        GLfloat* image = pool.alloc();
+        assert (reinterpret_cast<uintptr_t>(image) % alignof(GLfloat) == 0);
+        for (GLsizei i = 0; i < 8 * 4 * 3; ++i)
+            image[i] = GLfloat(i);
+        pool.free(image);
+        assert (pool.alloc() == image);
+        pool.free(image);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testReduceImageBy2Parallel()
+    {
+        std::cerr << "Starting Agl::testReduceImageBy2Parallel()\n";
+        
+        // The parallel version should give exactly the same result as the
+        // serial version, for any number of bands, including more bands than
+        // result rows.
+        
+        const GLsizei width = 101;
+        const GLsizei height = 37;
+        const GLsizei bytesPerPixel = 4;
+        const GLsizei rowLength = 110;
+        const GLsizei skipPixels = 5;
+        const GLsizei skipRows = 3;
+        
+        std::vector<GLubyte> orig(rowLength * (height + skipRows) * bytesPerPixel);
+        srand(2);
+        for (GLubyte& b : orig)
+            b = rand() % 256;
+        
+        const size_t resultSize = (width / 2) * (height / 2) * bytesPerPixel;
+        std::vector<GLubyte> expected(resultSize);
+        reduceImageBy2(expected.data(), orig.data(), width, height, bytesPerPixel,
+                       rowLength, skipPixels, skipRows);
+        
+        for (GLsizei threadCount = 0; threadCount <= 20; ++threadCount)
+        {
+            std::vector<GLubyte> result(resultSize);
+            reduceImageBy2Parallel(result.data(), orig.data(), width, height,
+                                   bytesPerPixel, rowLength, skipPixels,
+                                   skipRows, threadCount);
+            assert (result == expected);
+        }
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testThreadPool()
+    {
+        std::cerr << "Starting Agl::testThreadPool()\n";
+        
+        // Every task should run exactly once per call to run(), including
+        // nested calls, which run on the calling thread.
+        
+        ThreadPool pool(3);
+        assert (pool.threadCount() == 3);
+        
+        for (size_t taskCount = 0; taskCount < 50; ++taskCount)
+        {
+            std::vector<std::atomic<int>> counts(taskCount);
+            for (std::atomic<int>& count : counts)
+                count = 0;
+            
+            pool.run(taskCount, [&](size_t i)
+            {
+                ++counts[i];
+                pool.run(2, [&](size_t) { ++counts[i]; });
+            });
+            
+            for (std::atomic<int>& count : counts)
+                assert (count == 3);
+        }
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testGenerateImagePyramid()
+    {
+        std::cerr << "Starting Agl::testGenerateImagePyramid()\n";
+        
+        // Each level of the pyramid should be exactly what repeated calls to
+        // reduceImageBy2() produce.  Try sizes that are not multiples of the
+        // tile size, and that run out of pixels before the last level.
+        
+        struct Case { GLsizei width, height, bytesPerPixel, levelCount; };
+        const Case cases [] = {
+            { 64, 64, 4, 3 }, { 1001, 67, 3, 5 }, { 300, 7, 1, 4 },
+            { 77, 90, 2, 8 }, { 2050, 130, 4, 1 }
+        };
+        
+        srand(3);
+        
+        for (const Case& c : cases)
+        {
+            const GLsizei skipPixels = 3;
+            const GLsizei skipRows = 2;
+            const GLsizei rowLength = c.width + 5;
+            
+            std::vector<GLubyte> orig(rowLength * (c.height + skipRows) *
+                                      c.bytesPerPixel);
+            for (GLubyte& b : orig)
+                b = rand() % 256;
+            
+            std::vector<GLubyte> pyramid(imagePyramidSize(c.width, c.height,
+                                                          c.bytesPerPixel,
+                                                          c.levelCount));
+            assert (pyramid.size() <= orig.size() / 2);
+            generateImagePyramid(pyramid.data(), c.levelCount, orig.data(),
+                                 c.width, c.height, c.bytesPerPixel, rowLength,
+                                 skipPixels, skipRows);
+            
+            std::vector<GLubyte> level(orig);
+            GLsizei levelWidth = c.width;
+            GLsizei levelHeight = c.height;
+            GLsizei levelRowLength = rowLength;
+            GLsizei levelSkipPixels = skipPixels;
+            GLsizei levelSkipRows = skipRows;
+            
+            for (GLsizei n = 1; n <= c.levelCount; ++n)
+            {
+                std::vector<GLubyte> reduced((levelWidth / 2) * (levelHeight / 2) *
+                                             c.bytesPerPixel);
+                reduceImageBy2(reduced.data(), level.data(), levelWidth,
+                               levelHeight, c.bytesPerPixel, levelRowLength,
+                               levelSkipPixels, levelSkipRows);
+                level.swap(reduced);
+                levelWidth /= 2;
+                levelHeight /= 2;
+                levelRowLength = levelWidth;
+                levelSkipPixels = 0;
+                levelSkipRows = 0;
+                
+                const GLsizei pyramidRowSize = c.width / 2 * c.bytesPerPixel;
+                const GLubyte* pyramidLevel = pyramid.data() +
+                    imagePyramidSkipRows(c.height, n) * pyramidRowSize;
+                for (GLsizei i = 0; i < levelHeight; ++i)
+                {
+                    for (GLsizei j = 0; j < levelWidth * c.bytesPerPixel; ++j)
+                    {
+                        assert (pyramidLevel[i * pyramidRowSize + j] ==
+                                level[i * levelWidth * c.bytesPerPixel + j]);
+                    }
+                }
+            }
+        }
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testReduceImage()
+    {
+        std::cerr << "Starting Agl::testReduceImage()\n";
+        
+        // Compare against area averaging done in double precision.  The
+        // fixed-point weights can make the result differ by at most one from
+        // the correctly rounded value.
+        
+        struct Case { GLsizei width, height, resultWidth, resultHeight, bytesPerPixel; };
+        const Case cases [] = {
+            { 40, 30, 40, 30, 4 }, { 40, 30, 20, 15, 3 }, { 100, 50, 33, 17, 4 },
+            { 641, 480, 427, 320, 1 }, { 37, 23, 5, 2, 2 }, { 19, 19, 1, 1, 4 }
+        };
+        
+        srand(4);
+        
+        for (const Case& c : cases)
+        {
+            const GLsizei skipPixels = 2;
+            const GLsizei skipRows = 1;
+            const GLsizei rowLength = c.width + 3;
+            
+            std::vector<GLubyte> orig(rowLength * (c.height + skipRows) *
+                                      c.bytesPerPixel);
+            for (GLubyte& b : orig)
+                b = rand() % 256;
+            
+            std::vector<GLubyte> result(c.resultWidth * c.resultHeight *
+                                        c.bytesPerPixel);
+            reduceImage(result.data(), c.resultWidth, c.resultHeight, orig.data(),
+                        c.width, c.height, c.bytesPerPixel, rowLength,
+                        skipPixels, skipRows);
+            
+            const double sx = double(c.width) / c.resultWidth;
+            const double sy = double(c.height) / c.resultHeight;
+            
+            for (GLsizei i = 0; i < c.resultHeight; ++i)
+            {
+                for (GLsizei j = 0; j < c.resultWidth; ++j)
+                {
+                    for (GLsizei k = 0; k < c.bytesPerPixel; ++k)
+                    {
+                        double sum = 0;
+                        GLsizei yEnd = std::min(c.height, GLsizei((i + 1) * sy) + 1);
+                        for (GLsizei y = GLsizei(i * sy); y < yEnd; ++y)
+                        {
+                            double wy = std::min(y + 1.0, (i + 1) * sy) -
+                                        std::max(double(y), i * sy);
+                            if (wy <= 0)
+                                continue;
+                            GLsizei xEnd = std::min(c.width, GLsizei((j + 1) * sx) + 1);
+                            for (GLsizei x = GLsizei(j * sx); x < xEnd; ++x)
+                            {
+                                double wx = std::min(x + 1.0, (j + 1) * sx) -
+                                            std::max(double(x), j * sx);
+                                if (wx <= 0)
+                                    continue;
+                                GLsizei p = (y + skipRows) * rowLength + x + skipPixels;
+                                sum += wx * wy * orig[p * c.bytesPerPixel + k];
+                            }
+                        }
+                        double expected = sum / (sx * sy);
+                        GLubyte r = result[(i * c.resultWidth + j) * c.bytesPerPixel + k];
+                        assert (fabs(r - expected) <= 1.0);
+                    }
+                }
+            }
+        }
+        
+        // Reducing by exactly 2 uses equal weights, so the result is the
+        // average of four bytes rounded to nearest.
+        
+        const GLubyte orig [] = { 0, 1, 2, 3, 250, 255, 255, 255 };
+        GLubyte result[2];
+        reduceImage(result, 2, 1, orig, 4, 2, 1);
+        assert (result[0] == (0 + 1 + 250 + 255 + 2) / 4);
+        assert (result[1] == (2 + 3 + 255 + 255 + 2) / 4);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testReduceImageBy2Srgb()
+    {
+        std::cerr << "Starting Agl::testReduceImageBy2Srgb()\n";
+        
+        // Compare against averaging done in double precision.  The 16-bit
+        // linear intensities can make the result differ by at most one from
+        // the correctly rounded value.
+        
+        struct Srgb
+        {
+            static double toLinear(double c)
+            {
+                return (c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+            }
+            static double fromLinear(double v)
+            {
+                return (v <= 0.0031308) ? v * 12.92 : 1.055 * pow(v, 1 / 2.4) - 0.055;
+            }
+        };
+        
+        srand(5);
+        
+        for (GLsizei bytesPerPixel = 1; bytesPerPixel <= 4; ++bytesPerPixel)
+        {
+            const GLsizei width = 34;
+            const GLsizei height = 20;
+            const GLsizei skipPixels = 3;
+            const GLsizei skipRows = 2;
+            const GLsizei rowLength = width + 5;
+            
+            std::vector<GLubyte> orig(rowLength * (height + skipRows) *
+                                      bytesPerPixel);
+            for (GLubyte& b : orig)
+                b = rand() % 256;
+            
+            std::vector<GLubyte> result(width / 2 * height / 2 * bytesPerPixel);
+            reduceImageBy2Srgb(result.data(), orig.data(), width, height,
+                               bytesPerPixel, rowLength, skipPixels, skipRows);
+            
+            const bool hasAlpha = (bytesPerPixel % 2 == 0);
+            for (GLsizei i = 0; i < height / 2; ++i)
+            {
+                for (GLsizei j = 0; j < width / 2; ++j)
+                {
+                    for (GLsizei k = 0; k < bytesPerPixel; ++k)
+                    {
+                        const bool isAlpha = hasAlpha && (k == bytesPerPixel - 1);
+                        double sum = 0;
+                        for (GLsizei y = 2 * i; y < 2 * i + 2; ++y)
+                        {
+                            for (GLsizei x = 2 * j; x < 2 * j + 2; ++x)
+                            {
+                                GLsizei p = (y + skipRows) * rowLength + x + skipPixels;
+                                double b = orig[p * bytesPerPixel + k];
+                                sum += isAlpha ? b : Srgb::toLinear(b / 255);
+                            }
+                        }
+                        double expected = isAlpha ? sum / 4 :
+                                          255 * Srgb::fromLinear(sum / 4);
+                        GLubyte r = result[(i * width / 2 + j) * bytesPerPixel + k];
+                        assert (fabs(r - expected) <= 1.0);
+                    }
+                }
+            }
+        }
+        
+        // Every byte value survives reducing a constant image.
+        
+        for (int b = 0; b < 256; ++b)
+        {
+            const GLubyte orig [] = { GLubyte(b), GLubyte(b), GLubyte(b), GLubyte(b) };
+            GLubyte result;
+            reduceImageBy2Srgb(&result, orig, 2, 2, 1);
+            assert (result == b);
+        }
+        
+        // Averaging black and white gives half the linear intensity, which is
+        // much brighter than the average of the encoded bytes.
+        
+        const GLubyte orig [] = { 0, 255, 255, 0 };
+        GLubyte result;
+        reduceImageBy2Srgb(&result, orig, 2, 2, 1);
+        assert (result == 188);
+        
+        std::cerr << "ok\n";
+    }
+    
+    namespace
+    {
+        
+        // Check an RGBA pixel against a BT.601 video-range conversion in
+        // double precision.  The fixed-point coefficients can make the result
+        // differ by at most one from the correctly rounded value.
+        
+        void checkYuvToRgba(const GLubyte* rgba, double y, double u, double v)
+        {
+            double l = 1.164383 * (y - 16);
+            double rgb [] = { l + 1.596027 * (v - 128),
+                              l - 0.391762 * (u - 128) - 0.812968 * (v - 128),
+                              l + 2.017232 * (u - 128) };
+            for (int k = 0; k < 3; ++k)
+            {
+                double expected = std::min(std::max(rgb[k], 0.0), 255.0);
+                assert (fabs(rgba[k] - expected) <= 1.0);
+            }
+            assert (rgba[3] == 255);
+        }
+        
+    }
+    
+    void testConvertToRgba()
+    {
+        std::cerr << "Starting Agl::testConvertToRgba()\n";
+        
+        const GLsizei width = 37;
+        const GLsizei height = 11;
+        const GLsizei rowLength = 46;
+        const GLsizei skipPixels = 4;
+        const GLsizei skipRows = 2;
+        const GLsizei rows = height + skipRows + 1;
+        
+        srand(6);
+        std::vector<GLubyte> yuyv(rowLength * rows * 2);
+        std::vector<GLubyte> yPlane(rowLength * rows);
+        std::vector<GLubyte> uvPlane(rowLength * rows / 2);
+        std::vector<GLubyte> bgra(rowLength * rows * 4);
+        for (std::vector<GLubyte>* image : { &yuyv, &yPlane, &uvPlane, &bgra })
+        {
+            for (GLubyte& b : *image)
+                b = rand() % 256;
+        }
+        
+        std::vector<GLubyte> result(width * height * 4);
+        std::vector<GLubyte> pixel(2 * 4);
+        
+        // The SIMD paths handle the first pixels of each row, and the scalar
+        // path handles the last few, so also converting each pair of pixels
+        // on its own checks that the paths agree exactly.
+        
+        convertYuyvToRgba(result.data(), yuyv.data(), width, height, rowLength,
+                          skipPixels, skipRows);
+        for (GLsizei i = 0; i < height; ++i)
+        {
+            for (GLsizei j = 0; j < width; ++j)
+            {
+                const GLubyte* p = &yuyv[((i + skipRows) * rowLength + skipPixels + j) * 2];
+                const GLubyte* pair = &yuyv[((i + skipRows) * rowLength + skipPixels + j / 2 * 2) * 2];
+                const GLubyte* rgba = &result[(i * width + j) * 4];
+                checkYuvToRgba(rgba, p[0], pair[1], pair[3]);
+                
+                if (j % 2 == 0)
+                {
+                    convertYuyvToRgba(pixel.data(), yuyv.data(), 1, 1, rowLength,
+                                      skipPixels + j, skipRows + i);
+                    assert (std::equal(rgba, rgba + 4, pixel.data()));
+                }
+            }
+        }
+        
+        convertNv12ToRgba(result.data(), yPlane.data(), uvPlane.data(), width,
+                          height, rowLength, skipPixels, skipRows);
+        for (GLsizei i = 0; i < height; ++i)
+        {
+            for (GLsizei j = 0; j < width; ++j)
+            {
+                GLubyte y = yPlane[(i + skipRows) * rowLength + skipPixels + j];
+                const GLubyte* uv = &uvPlane[(i + skipRows) / 2 * rowLength +
+                                             skipPixels + j / 2 * 2];
+                const GLubyte* rgba = &result[(i * width + j) * 4];
+                checkYuvToRgba(rgba, y, uv[0], uv[1]);
+                
+                if ((i % 2 == 0) && (j % 2 == 0))
+                {
+                    convertNv12ToRgba(pixel.data(), yPlane.data(), uvPlane.data(),
+                                      2, 1, rowLength, skipPixels + j, skipRows + i);
+                    assert (std::equal(rgba, rgba + 4, pixel.data()));
+                }
+            }
+        }
+        
+        convertBgraToRgba(result.data(), bgra.data(), width, height, rowLength,
+                          skipPixels, skipRows);
+        for (GLsizei i = 0; i < height; ++i)
+        {
+            for (GLsizei j = 0; j < width; ++j)
+            {
+                const GLubyte* p = &bgra[((i + skipRows) * rowLength + skipPixels + j) * 4];
+                const GLubyte* rgba = &result[(i * width + j) * 4];
+                assert ((rgba[0] == p[2]) && (rgba[1] == p[1]) &&
+                        (rgba[2] == p[0]) && (rgba[3] == p[3]));
+            }
+        }
+        
+        // Video-range black and white.
+        
+        const GLubyte blackWhite [] = { 16, 128, 235, 128 };
+        convertYuyvToRgba(pixel.data(), blackWhite, 2, 1);
+        const GLubyte expected [] = { 0, 0, 0, 255, 255, 255, 255, 255 };
+        assert (std::equal(pixel.begin(), pixel.end(), expected));
+        
+        // The pool versions should give the same results in pool memory, and
+        // should check the pool's image size.
+        
+        ImagePool pool;
+        pool.setImageSize(width, height, 4);
+        GLubyte* pooled = convertBgraToRgba(pool, bgra.data(), width, height,
+                                            rowLength, skipPixels, skipRows);
+        assert (std::equal(result.begin(), result.end(), pooled));
+        pool.free(pooled);
+        
+        bool threw = false;
+        try
+        {
+            convertYuyvToRgba(pool, yuyv.data(), width + 1, height);
+        }
+        catch (std::invalid_argument&)
+        {
+            threw = true;
+        }
+        assert (threw);
+        
+        threw = false;
+        try
+        {
+            convertNv12ToRgba(pool, yPlane.data(), uvPlane.data(), width, height,
+                              rowLength, skipPixels, 1);
+        }
+        catch (std::invalid_argument&)
+        {
+            threw = true;
+        }
+        assert (threw);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testReduceYuvToRgbaBy2()
+    {
+        std::cerr << "Starting Agl::testReduceYuvToRgbaBy2()\n";
+        
+        const GLsizei width = 43;
+        const GLsizei height = 14;
+        const GLsizei rowLength = 52;
+        const GLsizei skipPixels = 6;
+        const GLsizei skipRows = 2;
+        const GLsizei rows = height + skipRows;
+        const GLsizei resultWidth = width / 2;
+        const GLsizei resultHeight = height / 2;
+        
+        srand(7);
+        std::vector<GLubyte> yuyv(rowLength * rows * 2);
+        std::vector<GLubyte> yPlane(rowLength * rows);
+        std::vector<GLubyte> uvPlane(rowLength * rows / 2);
+        for (std::vector<GLubyte>* image : { &yuyv, &yPlane, &uvPlane })
+        {
+            for (GLubyte& b : *image)
+                b = rand() % 256;
+        }
+        
+        std::vector<GLubyte> result(resultWidth * resultHeight * 4);
+        GLubyte pixel[4];
+        
+        // Each result pixel should be the conversion of the average Y, U and
+        // V, and converting each result pixel on its own (on the scalar path)
+        // should give exactly the same bytes.
+        
+        reduceYuyvToRgbaBy2(result.data(), yuyv.data(), width, height,
+                            rowLength, skipPixels, skipRows);
+        for (GLsizei i = 0; i < resultHeight; ++i)
+        {
+            for (GLsizei j = 0; j < resultWidth; ++j)
+            {
+                const GLubyte* p0 = &yuyv[((2 * i + skipRows) * rowLength +
+                                           skipPixels + 2 * j) * 2];
+                const GLubyte* p1 = p0 + rowLength * 2;
+                const GLubyte* rgba = &result[(i * resultWidth + j) * 4];
+                checkYuvToRgba(rgba, (p0[0] + p0[2] + p1[0] + p1[2]) / 4.0,
+                               (p0[1] + p1[1]) / 2.0, (p0[3] + p1[3]) / 2.0);
+                
+                reduceYuyvToRgbaBy2(pixel, yuyv.data(), 2, 2, rowLength,
+                                    skipPixels + 2 * j, skipRows + 2 * i);
+                assert (std::equal(rgba, rgba + 4, pixel));
+            }
+        }
+        
+        reduceNv12ToRgbaBy2(result.data(), yPlane.data(), uvPlane.data(), width,
+                            height, rowLength, skipPixels, skipRows);
+        for (GLsizei i = 0; i < resultHeight; ++i)
+        {
+            for (GLsizei j = 0; j < resultWidth; ++j)
+            {
+                const GLubyte* y0 = &yPlane[(2 * i + skipRows) * rowLength +
+                                            skipPixels + 2 * j];
+                const GLubyte* y1 = y0 + rowLength;
+                const GLubyte* uv = &uvPlane[(i + skipRows / 2) * rowLength +
+                                             skipPixels + 2 * j];
+                const GLubyte* rgba = &result[(i * resultWidth + j) * 4];
+                checkYuvToRgba(rgba, (y0[0] + y0[1] + y1[0] + y1[1]) / 4.0,
+                               uv[0], uv[1]);
+                
+                reduceNv12ToRgbaBy2(pixel, yPlane.data(), uvPlane.data(), 2, 2,
+                                    rowLength, skipPixels + 2 * j,
+                                    skipRows + 2 * i);
+                assert (std::equal(rgba, rgba + 4, pixel));
+            }
+        }
+        
+        // The pool version should give the same result in pool memory.
+        
+        ImagePool pool;
+        pool.setImageSize(resultWidth, resultHeight, 4);
+        GLubyte* pooled = reduceNv12ToRgbaBy2(pool, yPlane.data(), uvPlane.data(),
+                                              width, height, rowLength,
+                                              skipPixels, skipRows);
+        assert (std::equal(result.begin(), result.end(), pooled));
+        pool.free(pooled);
+        
+        bool threw = false;
+        try
+        {
+            reduceYuyvToRgbaBy2(pool, yuyv.data(), width, height + 2);
+        }
+        catch (std::invalid_argument&)
+        {
+            threw = true;
+        }
+        assert (threw);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testImagePool()
+    {
+        std::cerr << "Starting Agl::testImagePool()\n";
+        
+        ImagePool pool;
+        
+        bool threw = false;
+        try
+        {
+            pool.alloc();
+        }
+        catch (std::runtime_error&)
+        {
+            threw = true;
+        }
+        assert (threw);
+        
+        pool.setImageSize(64, 32, 3);
+        assert ((pool.imageWidth() == 64) && (pool.imageHeight() == 32) &&
+                (pool.bytesPerPixel() == 3));
+        
+        threw = false;
+        try
+        {
+            pool.setImageSize(64, 32, 3);
+        }
+        catch (std::runtime_error&)
+        {
+            threw = true;
+        }
+        assert (threw);
+        
+        // Freed memory is reused before anything new is allocated.
+        
+        GLubyte* a = pool.alloc();
+        GLubyte* b = pool.alloc();
+        assert (a != b);
+        pool.free(a);
+        pool.free(b);
+        GLubyte* c = pool.alloc();
+        GLubyte* d = pool.alloc();
+        assert (((c == a) && (d == b)) || ((c == b) && (d == a)));
+        pool.free(c);
+        pool.free(d);
+        
+        // Several threads allocating and freeing at once should never get the
+        // same memory at the same time.  Each thread fills its memory with its
+        // own value and checks that nothing else changed it before freeing it.
+        
+        const int threadCount = 4;
+        const int iterations = 20000;
+        const size_t size = 64 * 32 * 3;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t)
+        {
+            threads.push_back(std::thread([&pool, t]
+            {
+                GLubyte* held [3];
+                for (int i = 0; i < iterations; ++i)
+                {
+                    int n = 1 + i % 3;
+                    for (int k = 0; k < n; ++k)
+                    {
+                        held[k] = pool.alloc();
+                        std::fill(held[k], held[k] + size, GLubyte(t + 1));
+                    }
+                    for (int k = 0; k < n; ++k)
+                    {
+                        assert (std::count(held[k], held[k] + size,
+                                           GLubyte(t + 1)) == size);
+                        pool.free(held[k]);
+                    }
+                }
+            }));
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testSizedImagePool()
+    {
+        std::cerr << "Starting Agl::testSizedImagePool()\n";
+        
+        const size_t mb = 1024 * 1024;
+        
+        // Sizes round up to powers of two by default, so images of similar
+        // sizes share memory.
+        
+        {
+            SizedImagePool pool;
+            assert (pool.classSize(1) == 4096);
+            assert (pool.classSize(4096) == 4096);
+            assert (pool.classSize(4097) == 8192);
+            assert (pool.classSize(1000 * 1000 * 4) == 4 * mb);
+            
+            GLubyte* a = pool.alloc(1000, 1000, 4);
+            std::fill(a, a + 1000 * 1000 * 4, GLubyte(1));
+            pool.free(a);
+            GLubyte* b = pool.alloc(900, 900, 4);
+            assert (b == a);
+            GLubyte* c = pool.alloc(320, 240, 4);
+            assert (c != a);
+            assert (pool.memoryAllocated() == 4 * mb + 512 * 1024);
+            pool.free(b);
+            pool.free(c);
+        }
+        
+        // With configured classes, a request larger than all of them is an
+        // error.
+        
+        {
+            SizedImagePool pool({ 640 * 480 * 4, 320 * 240 * 4, 160 * 120 * 4 });
+            assert (pool.classSize(1) == 160 * 120 * 4);
+            assert (pool.classSize(320 * 240 * 4) == 320 * 240 * 4);
+            
+            bool threw = false;
+            try
+            {
+                pool.alloc(640 * 480 * 4 + 1);
+            }
+            catch (std::invalid_argument&)
+            {
+                threw = true;
+            }
+            assert (threw);
+        }
+        
+        // Under a memory limit, retained memory of other classes is released
+        // to make room, and if that is not enough, alloc() throws.
+        
+        {
+            SizedImagePool pool(8 * mb);
+            GLubyte* a = pool.alloc(4 * mb);
+            pool.free(a);
+            GLubyte* b = pool.alloc(mb);
+            GLubyte* c = pool.alloc(4 * mb);
+            assert (c == a);
+            assert (pool.memoryAllocated() == 5 * mb);
+            pool.free(b);
+            pool.free(c);
+            
+            GLubyte* d = pool.alloc(8 * mb);
+            assert (pool.memoryAllocated() == 8 * mb);
+            
+            bool threw = false;
+            try
+            {
+                pool.alloc(mb);
+            }
+            catch (std::runtime_error&)
+            {
+                threw = true;
+            }
+            assert (threw);
+            assert (pool.memoryAllocated() == 8 * mb);
+            pool.free(d);
+        }
+        
+        // Several threads using several sizes at once.
+        
+        {
+            SizedImagePool pool(64 * mb);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 4; ++t)
+            {
+                threads.push_back(std::thread([&pool, t]
+                {
+                    for (int i = 0; i < 2000; ++i)
+                    {
+                        size_t size = 1000 + (i * 7919 + t * 104729) % (2 * mb);
+                        GLubyte* image = pool.alloc(size);
+                        image[0] = image[size - 1] = GLubyte(t);
+                        assert ((image[0] == t) && (image[size - 1] == t));
+                        pool.free(image);
+                    }
+                }));
+            }
+            for (std::thread& thread : threads)
+                thread.join();
+            assert (pool.memoryAllocated() <= 64 * mb);
+        }
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testPooledImage()
+    {
+        std::cerr << "Starting Agl::testPooledImage()\n";
+        
+        ImagePool pool;
+        pool.setImageSize(16, 8, 4);
+        
+        // A PooledImage returns its image to the pool when destroyed, but
+        // not when moved from.
+        
+        GLubyte* first;
+        {
+            PooledImage a(pool);
+            first = a.data();
+            assert (a && (a.pool() == &pool));
+            
+            PooledImage b(std::move(a));
+            assert (!a && (a.data() == nullptr));
+            assert (b.data() == first);
+            
+            PooledImage c;
+            c = std::move(b);
+            assert (!b && (c.data() == first));
+        }
+        GLubyte* raw = pool.alloc();
+        assert (raw == first);
+        
+        // A PooledImage can adopt memory from the pool, and release it.
+        
+        {
+            PooledImage a(pool, raw);
+            assert (a.release() == raw);
+            assert (!a);
+        }
+        {
+            PooledImage a(pool, raw);
+        }
+        
+        // A SharedFrame returns its image to the pool when the last copy is
+        // destroyed.
+        
+        {
+            SharedFrame frame = PooledImage(pool);
+            assert (frame.data() == first);
+            assert (frame.useCount() == 1);
+            
+            SharedFrame copy = frame;
+            assert ((copy.data() == first) && (frame.useCount() == 2));
+            {
+                SharedFrame another;
+                another = copy;
+                assert (frame.useCount() == 3);
+                
+                SharedFrame moved(std::move(another));
+                assert (!another && (another.useCount() == 0));
+                assert (frame.useCount() == 3);
+            }
+            assert (frame.useCount() == 2);
+            
+            frame.reset();
+            assert (!frame && (copy.useCount() == 1));
+            
+            // The image is still in use, so the pool gives out other memory.
+            
+            PooledImage other(pool);
+            assert (other.data() != first);
+        }
+        raw = pool.alloc();
+        assert (raw == first);
+        pool.free(raw);
+        
+        // Frames fanned out to several consumer threads return to the pool
+        // after the last consumer finishes with them.
+        
+        for (int i = 0; i < 200; ++i)
+        {
+            PooledImage image(pool);
+            std::fill(image.data(), image.data() + 16 * 8 * 4, GLubyte(i));
+            SharedFrame frame(std::move(image));
+            
+            std::vector<std::thread> consumers;
+            for (int t = 0; t < 3; ++t)
+            {
+                consumers.push_back(std::thread([frame, i]
+                {
+                    assert (std::count(frame.data(), frame.data() + 16 * 8 * 4,
+                                       GLubyte(i)) == 16 * 8 * 4);
+                }));
+            }
+            frame.reset();
+            for (std::thread& consumer : consumers)
+                consumer.join();
+        }
+        raw = pool.alloc();
+        GLubyte* raw2 = pool.alloc();
+        GLubyte* raw3 = pool.alloc();
+        assert ((raw == first) || (raw2 == first) || (raw3 == first));
+        pool.free(raw);
+        pool.free(raw2);
+        pool.free(raw3);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testImageView()
+    {
+        std::cerr << "Starting Agl::testImageView()\n";
+        
+        const GLsizei width = 20;
+        const GLsizei height = 12;
+        const GLsizei bytesPerPixel = 3;
+        
+        srand(11);
+        std::vector<GLubyte> orig(width * height * bytesPerPixel);
+        for (GLubyte& b : orig)
+            b = rand() % 256;
+        
+        ImageView whole(orig.data(), width, height, bytesPerPixel);
+        assert (whole.isPacked());
+        assert (!whole.empty());
+        assert (whole.stride() == size_t(width * bytesPerPixel));
+        assert (whole.pixels() == orig.data());
+        assert (ImageView().empty());
+        
+        // A region of a region accumulates the skips and keeps the row
+        // length, so it addresses the same pixels as the arithmetic on the
+        // original image.
+        
+        ImageView crop = whole.region(3, 2, 14, 9).region(1, 1, 10, 6);
+        assert (!crop.isPacked());
+        assert (crop.rowLength() == width);
+        assert (crop.skipPixels() == 4);
+        assert (crop.skipRows() == 3);
+        assert (crop.row(2) == orig.data() + ((3 + 2) * width + 4) * bytesPerPixel);
+        
+        // The utilities give the same results for a view as for the
+        // equivalent arguments.
+        
+        std::vector<GLubyte> expected(5 * 3 * bytesPerPixel);
+        std::vector<GLubyte> result(expected.size());
+        reduceImageBy2(expected.data(), orig.data(), 10, 6, bytesPerPixel,
+                       width, 4, 3);
+        reduceImageBy2(result.data(), crop);
+        assert (result == expected);
+        
+        // A view of each level of a pyramid matches reducing the view of
+        // the level above.
+        
+        const GLsizei levelCount = 2;
+        std::vector<GLubyte> pyramid(imagePyramidSize(width, height,
+                                                      bytesPerPixel, levelCount));
+        generateImagePyramid(pyramid.data(), levelCount, whole);
+        ImageView level1 = imagePyramidLevel(pyramid.data(), width, height,
+                                             bytesPerPixel, 1);
+        ImageView level2 = imagePyramidLevel(pyramid.data(), width, height,
+                                             bytesPerPixel, 2);
+        assert (level2.width() == width / 4);
+        assert (level2.height() == height / 4);
+        std::vector<GLubyte> reduced(level2.width() * level2.height() *
+                                     bytesPerPixel);
+        reduceImageBy2(reduced.data(), level1);
+        for (GLsizei i = 0; i < level2.height(); ++i)
+        {
+            assert (memcmp(level2.row(i),
+                           &reduced[i * level2.width() * bytesPerPixel],
+                           level2.width() * bytesPerPixel) == 0);
+        }
+        
+        // A mutable view writes through to the memory, and a pooled image's
+        // view covers the pool's image size.
+        
+        ImagePool pool;
+        pool.setImageSize(4, 4, 4);
+        PooledImage image(pool);
+        memset(image.data(), 0, 4 * 4 * 4);
+        MutableImageView mutableView = image.view();
+        assert (mutableView.data() == image.data());
+        assert (mutableView.width() == 4);
+        assert (mutableView.height() == 4);
+        memset(mutableView.region(1, 2, 2, 1).pixels(), 7, 2 * 4);
+        assert (image.data()[(2 * 4 + 1) * 4] == 7);
+        assert (image.data()[(2 * 4 + 2) * 4 + 3] == 7);
+        assert (image.data()[(2 * 4 + 3) * 4] == 0);
+        assert (image.data()[(1 * 4 + 1) * 4] == 0);
+        ImageView constView = mutableView;
+        assert (constView.data() == image.data());
+        assert (!PooledImage().view().data());
+        
+        // Invalid views and regions are rejected when they are made.
+        
+        bool thrown = false;
+        try
+        {
+            ImageView(orig.data(), width, height, bytesPerPixel, width, 1, 0);
+        }
+        catch (const std::invalid_argument&)
+        {
+            thrown = true;
+        }
+        assert (thrown);
+        
+        thrown = false;
+        try
+        {
+            whole.region(15, 0, 6, 1);
+        }
+        catch (const std::out_of_range&)
+        {
+            thrown = true;
+        }
+        assert (thrown);
+        
+        thrown = false;
+        try
+        {
+            std::vector<GLubyte> rgba(width * height * 4);
+            convertYuyvToRgba(rgba.data(), whole);
+        }
+        catch (const std::invalid_argument&)
+        {
+            thrown = true;
+        }
+        assert (thrown);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testTileChangeDetector()
+    {
+        std::cerr << "Starting Agl::testTileChangeDetector()\n";
+        
+        // A frame whose size is not a multiple of the tile size, within a
+        // larger image, so the edge tiles and the view's skips are exercised.
+        
+        const GLsizei width = 70;
+        const GLsizei height = 45;
+        const GLsizei bytesPerPixel = 3;
+        const GLsizei rowLength = width + 3;
+        const GLsizei skipPixels = 2;
+        const GLsizei skipRows = 1;
+        
+        srand(20);
+        std::vector<GLubyte> image(rowLength * (height + skipRows) * bytesPerPixel);
+        for (GLubyte& b : image)
+            b = rand() % 256;
+        MutableImageView frame(image.data(), width, height, bytesPerPixel,
+                               rowLength, skipPixels, skipRows);
+        
+        TileChangeDetector detector(16, 16);
+        assert (detector.tileWidth() == 16);
+        assert (detector.tileHeight() == 16);
+        
+        // The first frame changed entirely.
+        
+        const std::vector<TileChangeDetector::Region>* regions = &detector.update(frame);
+        assert (detector.tileCount() == 5 * 3);
+        assert (detector.changedTileCount() == detector.tileCount());
+        assert (regions->size() == 1);
+        assert ((*regions)[0].width == width);
+        assert ((*regions)[0].height == height);
+        
+        // An unchanged frame has no changes.
+        
+        regions = &detector.update(frame);
+        assert (regions->empty());
+        assert (detector.changedTileCount() == 0);
+        
+        // Changing one byte changes one tile, including a byte in the last
+        // row and the last component of the last pixel.
+        
+        frame.row(20)[33 * bytesPerPixel + 1] ^= 1;
+        regions = &detector.update(frame);
+        assert (detector.changedTileCount() == 1);
+        assert (regions->size() == 1);
+        assert ((*regions)[0].x == 32);
+        assert ((*regions)[0].y == 16);
+        assert ((*regions)[0].width == 16);
+        assert ((*regions)[0].height == 16);
+        
+        frame.row(height - 1)[width * bytesPerPixel - 1] ^= 1;
+        regions = &detector.update(frame);
+        assert (detector.changedTileCount() == 1);
+        assert (regions->size() == 1);
+        assert ((*regions)[0].x == 64);
+        assert ((*regions)[0].y == 32);
+        assert ((*regions)[0].width == 6);
+        assert ((*regions)[0].height == 13);
+        
+        // Adjacent changed tiles in a row of tiles are merged, and separate
+        // ones are not.  Changes outside the view's region are ignored.
+        
+        frame.row(0)[0] ^= 1;
+        frame.row(0)[16 * bytesPerPixel] ^= 1;
+        frame.row(0)[48 * bytesPerPixel] ^= 1;
+        frame.row(40)[0] ^= 1;
+        image[0] ^= 1;
+        image[(skipRows * rowLength + skipPixels + width) * bytesPerPixel] ^= 1;
+        regions = &detector.update(frame);
+        assert (detector.changedTileCount() == 4);
+        assert (regions->size() == 3);
+        assert ((*regions)[0].x == 0);
+        assert ((*regions)[0].width == 32);
+        assert ((*regions)[1].x == 48);
+        assert ((*regions)[1].width == 16);
+        assert ((*regions)[2].y == 32);
+        assert (detector.update(frame).empty());
+        
+        // Randomly changed frames are detected exactly, compared with a
+        // tile-by-tile comparison of copies of the frames.
+        
+        for (int trial = 0; trial < 20; ++trial)
+        {
+            std::vector<GLubyte> before(image);
+            int changeCount = rand() % 4;
+            for (int i = 0; i < changeCount; ++i)
+                image[rand() % image.size()] ^= GLubyte(1 + rand() % 255);
+            
+            regions = &detector.update(frame);
+            size_t expected = 0;
+            for (GLsizei ty = 0; ty < height; ty += 16)
+            {
+                for (GLsizei tx = 0; tx < width; tx += 16)
+                {
+                    bool changed = false;
+                    for (GLsizei y = ty; y < std::min(ty + 16, height); ++y)
+                    {
+                        size_t offset = ((skipRows + y) * rowLength + skipPixels + tx) *
+                                        bytesPerPixel;
+                        size_t size = std::min(16, width - tx) * bytesPerPixel;
+                        if (memcmp(&image[offset], &before[offset], size) != 0)
+                            changed = true;
+                    }
+                    bool reported = false;
+                    for (const TileChangeDetector::Region& r : *regions)
+                    {
+                        if ((tx >= r.x) && (tx < r.x + r.width) &&
+                            (ty >= r.y) && (ty < r.y + r.height))
+                            reported = true;
+                    }
+                    assert (changed == reported);
+                    expected += changed ? 1 : 0;
+                }
+            }
+            assert (detector.changedTileCount() == expected);
+        }
+        
+        // A different size, or a reset, changes the whole frame.
+        
+        regions = &detector.update(frame.region(0, 0, 20, 20));
+        assert (regions->size() == 1);
+        assert (detector.changedTileCount() == 4);
+        detector.reset();
+        regions = &detector.update(frame.region(0, 0, 20, 20));
+        assert (regions->size() == 1);
+        assert (detector.update(frame.region(0, 0, 20, 20)).empty());
+        
+        bool thrown = false;
+        try
+        {
+            TileChangeDetector invalid(0, 16);
+        }
+        catch (const std::invalid_argument&)
+        {
+            thrown = true;
+        }
+        assert (thrown);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testImagePoolOptions()
+    {
+        std::cerr << "Starting Agl::testImagePoolOptions()\n";
+        
+        {
+            ImagePool pool;
+            ImagePool::Options options;
+            options.alignment = 64;
+            pool.setImageSize(33, 7, 3, options);
+            
+            std::vector<GLubyte*> images;
+            for (int i = 0; i < 5; ++i)
+            {
+                images.push_back(pool.alloc());
+                assert (reinterpret_cast<uintptr_t>(images.back()) % 64 == 0);
+            }
+            for (GLubyte* image : images)
+                pool.free(image);
+        }
+        
+        // Preallocated images are reused before any new allocation, and have
+        // been written (with zeros) to fault in their pages.
+        
+        {
+            ImagePool pool;
+            ImagePool::Options options;
+            options.alignment = ImagePool::pageSize();
+            options.preallocateCount = 3;
+            options.lockMemory = true;
+            pool.setImageSize(100, 50, 4, options);
+            
+            std::vector<GLubyte*> images;
+            for (int i = 0; i < 3; ++i)
+            {
+                GLubyte* image = pool.alloc();
+                assert (reinterpret_cast<uintptr_t>(image) % ImagePool::pageSize() == 0);
+                assert (std::count(image, image + 100 * 50 * 4, 0) == 100 * 50 * 4);
+                images.push_back(image);
+            }
+            std::sort(images.begin(), images.end());
+            assert (std::unique(images.begin(), images.end()) == images.end());
+            for (GLubyte* image : images)
+                pool.free(image);
+        }
+        
+        // Images of at least a huge page are aligned to huge pages.
+        
+        {
+            ImagePool pool;
+            ImagePool::Options options;
+            options.hugePages = true;
+            options.preallocateCount = 1;
+            pool.setImageSize(1024, 1024, 4, options);
+            GLubyte* image = pool.alloc();
+            assert (reinterpret_cast<uintptr_t>(image) % (2 * 1024 * 1024) == 0);
+            pool.free(image);
+        }
+        
+        {
+            ImagePool pool;
+            ImagePool::Options options;
+            options.alignment = 48;
+            bool threw = false;
+            try
+            {
+                pool.setImageSize(10, 10, 4, options);
+            }
+            catch (std::invalid_argument&)
+            {
+                threw = true;
+            }
+            assert (threw);
+        }
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testImagePoolStats()
+    {
+        std::cerr << "Starting Agl::testImagePoolStats()\n";
+        
+        {
+            ImagePool pool;
+            pool.setImageSize(8, 8, 4);
+            
+            std::vector<GLubyte*> images;
+            for (int i = 0; i < 5; ++i)
+                images.push_back(pool.alloc());
+            for (GLubyte* image : images)
+                pool.free(image);
+            
+            ImagePool::Stats stats = pool.stats();
+            assert ((stats.allocCount == 5) && (stats.missCount == 5) &&
+                    (stats.hitCount == 0) && (stats.freeCount == 5));
+            assert ((stats.outstandingCount == 0) && (stats.highWaterCount == 5));
+            assert ((stats.pooledCount == 5) && (stats.allocatedCount == 5));
+            
+            // The pool was empty when the images were allocated, so none of
+            // them is idle yet.
+            
+            assert (pool.trim() == 0);
+            
+            // Only two images are needed, so the other three are idle.
+            
+            GLubyte* a = pool.alloc();
+            GLubyte* b = pool.alloc();
+            pool.free(a);
+            pool.free(b);
+            assert (pool.trim() == 3);
+            
+            stats = pool.stats();
+            assert ((stats.allocCount == 7) && (stats.hitCount == 2));
+            assert ((stats.pooledCount == 2) && (stats.allocatedCount == 2));
+            assert (stats.releaseCount == 3);
+            
+            // Nothing was used since the last trim.
+            
+            assert (pool.trim() == 2);
+            assert (pool.stats().allocatedCount == 0);
+            
+            // Released images are replaced by new ones as needed.
+            
+            a = pool.alloc();
+            assert (pool.stats().missCount == 6);
+            pool.free(a);
+        }
+        
+        // A cap on the pooled images releases the surplus when freed.
+        
+        {
+            ImagePool pool;
+            ImagePool::Options options;
+            options.maxPooledCount = 2;
+            pool.setImageSize(8, 8, 4, options);
+            
+            std::vector<GLubyte*> images;
+            for (int i = 0; i < 4; ++i)
+                images.push_back(pool.alloc());
+            for (GLubyte* image : images)
+                pool.free(image);
+            
+            ImagePool::Stats stats = pool.stats();
+            assert ((stats.pooledCount == 2) && (stats.releaseCount == 2));
+            assert (stats.allocatedCount == 2);
+        }
+        
+        // Automatic trimming shrinks the pool to what steady use needs after
+        // a burst.
+        
+        {
+            ImagePool pool;
+            ImagePool::Options options;
+            options.idleTrimInterval = std::chrono::milliseconds(1);
+            pool.setImageSize(8, 8, 4, options);
+            
+            std::vector<GLubyte*> images;
+            for (int i = 0; i < 4; ++i)
+                images.push_back(pool.alloc());
+            for (GLubyte* image : images)
+                pool.free(image);
+            
+            for (int i = 0; i < 5; ++i)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                pool.free(pool.alloc());
+            }
+            assert (pool.stats().allocatedCount == 1);
+        }
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testImagePoolThreadCache()
+    {
+        std::cerr << "Starting Agl::testImagePoolThreadCache()\n";
+        
+        ImagePool::Options options;
+        options.threadCacheSize = 4;
+        
+        // One thread reuses its own freed images, and the counters include
+        // the calls its cache has not yet passed on to the pool.
+        
+        {
+            ImagePool pool;
+            pool.setImageSize(8, 8, 4, options);
+            
+            GLubyte* first = pool.alloc();
+            pool.free(first);
+            for (int i = 0; i < 100; ++i)
+            {
+                GLubyte* image = pool.alloc();
+                assert (image == first);
+                pool.free(image);
+            }
+            
+            std::vector<GLubyte*> images;
+            for (int i = 0; i < 10; ++i)
+                images.push_back(pool.alloc());
+            for (GLubyte* image : images)
+                pool.free(image);
+            
+            ImagePool::Stats stats = pool.stats();
+            assert ((stats.allocCount == 111) && (stats.freeCount == 111));
+            assert ((stats.missCount == 10) && (stats.allocatedCount == 10));
+            assert ((stats.outstandingCount == 0) && (stats.pooledCount == 10));
+            
+            // The images moved out of the cache are reused before any new
+            // allocation.
+            
+            std::vector<GLubyte*> again;
+            for (int i = 0; i < 10; ++i)
+                again.push_back(pool.alloc());
+            assert (pool.stats().missCount == 10);
+            std::sort(images.begin(), images.end());
+            std::sort(again.begin(), again.end());
+            assert (images == again);
+            for (GLubyte* image : again)
+                pool.free(image);
+        }
+        
+        // Images allocated on some threads and freed on others all return to
+        // the pool, including those cached by threads that have exited.
+        
+        {
+            ImagePool pool;
+            pool.setImageSize(8, 8, 4, options);
+            
+            const int threadCount = 8;
+            const int imageCount = 2000;
+            FrameChannel channel(16, false);
+            std::atomic<int> producersDone(0);
+            
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threadCount; ++t)
+            {
+                threads.push_back(std::thread([&, t]
+                {
+                    if (t % 2 == 0)
+                    {
+                        for (int i = 0; i < imageCount; ++i)
+                        {
+                            PooledImage image(pool);
+                            image.data()[0] = GLubyte(i);
+                            while (!channel.push(std::move(image)))
+                                std::this_thread::yield();
+                        }
+                        ++producersDone;
+                    }
+                    else
+                    {
+                        PooledImage image;
+                        while ((producersDone.load() < threadCount / 2) ||
+                               (channel.size() > 0))
+                        {
+                            if (channel.pop(image))
+                                image.reset();
+                            else
+                                std::this_thread::yield();
+                        }
+                    }
+                }));
+            }
+            for (std::thread& thread : threads)
+                thread.join();
+            
+            PooledImage image;
+            while (channel.pop(image))
+                image.reset();
+            
+            ImagePool::Stats stats = pool.stats();
+            assert (stats.allocCount == uint64_t(threadCount / 2 * imageCount));
+            assert (stats.freeCount == stats.allocCount);
+            assert (stats.outstandingCount == 0);
+            assert (stats.pooledCount == stats.allocatedCount);
+            
+            // With no images in use, trimming twice releases them all, except
+            // for any in this thread's cache.
+            
+            pool.trim();
+            pool.trim();
+            assert (pool.stats().allocatedCount <= options.threadCacheSize);
+        }
+        
+        // A thread may outlive a pool it used.
+        
+        {
+            std::atomic<int> step(0);
+            std::thread thread;
+            {
+                ImagePool pool;
+                pool.setImageSize(8, 8, 4, options);
+                thread = std::thread([&]
+                {
+                    pool.free(pool.alloc());
+                    step = 1;
+                    while (step.load() != 2)
+                        std::this_thread::yield();
+                });
+                while (step.load() != 1)
+                    std::this_thread::yield();
+            }
+            step = 2;
+            thread.join();
+        }
+        
+        // The limit on pooled images applies to what the caches pass on.
+        
+        {
+            ImagePool pool;
+            ImagePool::Options limited = options;
+            limited.maxPooledCount = 4;
+            pool.setImageSize(8, 8, 4, limited);
+            
+            std::vector<GLubyte*> images;
+            for (int i = 0; i < 20; ++i)
+                images.push_back(pool.alloc());
+            for (GLubyte* image : images)
+                pool.free(image);
+            assert (pool.stats().allocatedCount < 20);
+            assert (pool.stats().releaseCount > 0);
+        }
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testSharedMemoryImagePool()
+    {
+        std::cerr << "Starting Agl::testSharedMemoryImagePool()\n";
+        
+        const GLsizei width = 64;
+        const GLsizei height = 32;
+        const size_t imageSize = width * height * 4;
+        std::string name = "/agltest-" + std::to_string(getpid());
+        
+        SharedMemoryImagePool pool(name, width, height, 4, 6, 3);
+        assert (pool.isCreator() && (pool.imageCount() == 6));
+        assert (pool.ringDepth() == 3);
+        
+        bool threw = false;
+        try
+        {
+            SharedMemoryImagePool duplicate(name, width, height, 4, 6, 3);
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+        assert (threw);
+        
+        threw = false;
+        try
+        {
+            SharedMemoryImagePool missing(name + "-missing");
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+        assert (threw);
+        
+        // Sizes that are not positive, or whose segment would overflow.
+        
+        const GLsizei badSizes [][3] =
+        {
+            { 0, height, 4 }, { width, -1, 4 }, { width, height, 0 },
+            { 1 << 30, 1 << 30, 1 << 30 }
+        };
+        for (const GLsizei* size : badSizes)
+        {
+            threw = false;
+            try
+            {
+                SharedMemoryImagePool bad(name + "-bad", size[0], size[1],
+                                          size[2], 6, 3);
+            }
+            catch (const std::invalid_argument&)
+            {
+                threw = true;
+            }
+            assert (threw);
+        }
+        
+        // A creator that exits without destroying its pool, as in a crash,
+        // leaves the segment behind, which a new creator replaces.
+        
+        {
+            std::string staleName = name + "-stale";
+            pid_t child = fork();
+            if (child == 0)
+            {
+                new SharedMemoryImagePool(staleName, width, height, 4, 6, 3);
+                _exit(0);
+            }
+            int status = 0;
+            waitpid(child, &status, 0);
+            assert (WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+            
+            SharedMemoryImagePool restarted(staleName, width, height, 4, 6, 3);
+            assert (restarted.isCreator());
+        }
+        
+        // In one process, with another handle on the same segment: frames
+        // published through one handle are received through the other at
+        // the other's address, and a full ring drops the oldest frame.
+        
+        {
+            SharedMemoryImagePool other(name);
+            assert (!other.isCreator());
+            assert ((other.imageWidth() == width) && (other.imageHeight() == height));
+            assert ((other.bytesPerPixel() == 4) && (other.imageCount() == 6));
+            
+            assert (other.receive() == nullptr);
+            for (int i = 0; i < 5; ++i)
+            {
+                GLubyte* image = pool.alloc();
+                assert (image != nullptr);
+                std::fill(image, image + imageSize, GLubyte(i));
+                pool.publish(image);
+            }
+            assert (pool.droppedCount() == 2);
+            
+            GLubyte* frame = other.receive();
+            assert ((frame != nullptr) && (frame[0] == 2));
+            assert (std::count(frame, frame + imageSize, GLubyte(2)) ==
+                    ptrdiff_t(imageSize));
+            other.free(frame);
+            
+            frame = other.receiveLatest();
+            assert ((frame != nullptr) && (frame[imageSize - 1] == 4));
+            assert (other.droppedCount() == 3);
+            assert (other.receive() == nullptr);
+            other.free(frame);
+            
+            // When every image is allocated, alloc() takes the oldest
+            // published frame, and then fails.
+            
+            std::vector<GLubyte*> images;
+            for (int i = 0; i < 6; ++i)
+                images.push_back(pool.alloc());
+            assert (std::find(images.begin(), images.end(), nullptr) == images.end());
+            pool.publish(images.back());
+            images.pop_back();
+            images.push_back(pool.alloc());
+            assert (images.back() != nullptr);
+            assert (pool.alloc() == nullptr);
+            for (GLubyte* image : images)
+                pool.free(image);
+            
+            threw = false;
+            try
+            {
+                pool.free(images[0] + 1);
+            }
+            catch (const std::invalid_argument&)
+            {
+                threw = true;
+            }
+            assert (threw);
+        }
+        
+        // A ring of depth 1 holds the newest frame, and a frame it replaces
+        // goes back to the free list.
+        
+        SharedMemoryImagePool mailbox(name + "-mailbox", width, height, 4, 3, 1);
+        {
+            assert (mailbox.receive() == nullptr);
+            GLubyte* first = mailbox.alloc();
+            GLubyte* second = mailbox.alloc();
+            first[0] = 1;
+            second[0] = 2;
+            mailbox.publish(first);
+            mailbox.publish(second);
+            assert (mailbox.droppedCount() == 1);
+            
+            GLubyte* frame = mailbox.receive();
+            assert ((frame == second) && (frame[0] == 2));
+            assert (mailbox.receive() == nullptr);
+            mailbox.free(frame);
+            
+            std::vector<GLubyte*> images;
+            for (int i = 0; i < 3; ++i)
+                images.push_back(mailbox.alloc());
+            assert (std::find(images.begin(), images.end(), nullptr) == images.end());
+            assert (mailbox.alloc() == nullptr);
+            for (GLubyte* image : images)
+                mailbox.free(image);
+        }
+        
+        // A child process produces frames while this process consumes them,
+        // with no copying, through the ring of depth 3 and the one of depth
+        // 1.  Each frame's bytes all equal its number mod 256, and the frames
+        // arrive in order.
+        
+        for (SharedMemoryImagePool* consumer : { &pool, &mailbox })
+        {
+            const int frameCount = 2000;
+            pid_t child = fork();
+            assert (child != -1);
+            if (child == 0)
+            {
+                SharedMemoryImagePool producer(consumer->name());
+                for (int i = 0; i < frameCount; ++i)
+                {
+                    GLubyte* image;
+                    while ((image = producer.alloc()) == nullptr)
+                        usleep(10);
+                    memset(image, i & 0xff, imageSize);
+                    memcpy(image, &i, sizeof(i));
+                    producer.publish(image);
+                }
+                _exit(0);
+            }
+        
+            int last = -1;
+            int received = 0;
+            int status;
+            bool exited = false;
+            while (last < frameCount - 1)
+            {
+                GLubyte* frame = consumer->receiveLatest();
+                if (frame == nullptr)
+                {
+                    // Stop if the child failed before its last frame.
+                
+                    if (exited)
+                        break;
+                    exited = (waitpid(child, &status, WNOHANG) == child);
+                    usleep(10);
+                    continue;
+                }
+                int i;
+                memcpy(&i, frame, sizeof(i));
+                assert (i > last);
+                assert (std::count(frame + sizeof(i), frame + imageSize,
+                                   GLubyte(i & 0xff)) ==
+                        ptrdiff_t(imageSize - sizeof(i)));
+                last = i;
+                ++received;
+                consumer->free(frame);
+            }
+            if (!exited)
+                waitpid(child, &status, 0);
+            assert (WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+            assert ((last == frameCount - 1) && (received > 0));
+        }
+        
+        std::cerr << "ok\n";
+    }
+    
+    namespace
+    {
+        
+        // The value of a byte in the test video frames.
+        
+        GLubyte rawVideoByte(size_t frame, GLsizei x, GLsizei y, GLsizei c)
+        {
+            return GLubyte(frame * 7 + x * 3 + y * 5 + c);
+        }
+        
+        // Write a raw video file with frames 10 ms apart, returning its path.
+        
+        std::string writeRawVideo(GLsizei width, GLsizei height,
+                                  GLsizei bytesPerPixel, size_t frameCount)
+        {
+            char path[] = "/tmp/agltest-XXXXXX";
+            int fd = mkstemp(path);
+            assert (fd != -1);
+            FILE* file = fdopen(fd, "wb");
+            
+            RawVideoFileHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, RawVideoMagic, sizeof(header.magic));
+            header.version = RawVideoVersion;
+            header.width = width;
+            header.height = height;
+            header.bytesPerPixel = bytesPerPixel;
+            header.headerSize = sizeof(header);
+            header.frameStride = rawVideoFrameStride(width, height, bytesPerPixel);
+            fwrite(&header, sizeof(header), 1, file);
+            
+            std::vector<GLubyte> record(header.frameStride, 0);
+            for (size_t f = 0; f < frameCount; ++f)
+            {
+                RawVideoFrameHeader frameHeader;
+                memset(&frameHeader, 0, sizeof(frameHeader));
+                frameHeader.timestamp = 1000000000 + int64_t(f) * 10000000;
+                frameHeader.sequence = 100 + f;
+                memcpy(&record[0], &frameHeader, sizeof(frameHeader));
+                
+                GLubyte* p = &record[sizeof(frameHeader)];
+                for (GLsizei y = 0; y < height; ++y)
+                    for (GLsizei x = 0; x < width; ++x)
+                        for (GLsizei c = 0; c < bytesPerPixel; ++c)
+                            *p++ = rawVideoByte(f, x, y, c);
+                fwrite(&record[0], record.size(), 1, file);
+            }
+            
+            // A partial record at the end is ignored.
+            
+            fwrite(&record[0], record.size() / 2, 1, file);
+            fclose(file);
+            return path;
+        }
+        
+    }
+    
+    void testRawVideoSource()
+    {
+        std::cerr << "Starting Agl::testRawVideoSource()\n";
+        
+        const GLsizei width = 20;
+        const GLsizei height = 12;
+        const size_t frameCount = 6;
+        std::string path = writeRawVideo(width, height, 4, frameCount);
+        
+        {
+            RawVideoSource source(path);
+            assert ((source.width() == width) && (source.height() == height));
+            assert ((source.bytesPerPixel() == 4) &&
+                    (source.frameCount() == frameCount));
+            
+            // Whole frames are served in order, as fast as possible.
+            
+            RawVideoFrame frame;
+            for (size_t f = 0; f < frameCount; ++f)
+            {
+                assert (source.next(frame));
+                assert ((frame.index == f) && (frame.sequence == 100 + f));
+                assert (frame.timestamp == 1000000000 + int64_t(f) * 10000000);
+                assert ((frame.width == width) && (frame.rowLength == 0));
+                assert (frame.data[(3 * width + 2) * 4 + 1] ==
+                        rawVideoByte(f, 2, 3, 1));
+            }
+            assert (!source.next(frame));
+            
+            // A region view gives the same reduction as the region of a copy
+            // of the frame.
+            
+            source.setRegion(4, 2, 10, 8);
+            frame = source.frame(3);
+            assert ((frame.width == 10) && (frame.height == 8));
+            assert ((frame.rowLength == width) && (frame.skipPixels == 4) &&
+                    (frame.skipRows == 2));
+            
+            std::vector<GLubyte> whole(width * height * 4);
+            memcpy(&whole[0], frame.data, whole.size());
+            std::vector<GLubyte> expected(5 * 4 * 4), reduced(5 * 4 * 4);
+            reduceImageBy2(&expected[0], &whole[0], 10, 8, 4, width, 4, 2);
+            reduceImageBy2(&reduced[0], frame.data, frame.width, frame.height,
+                           frame.bytesPerPixel, frame.rowLength,
+                           frame.skipPixels, frame.skipRows);
+            assert (reduced == expected);
+            
+            // The region can be copied into memory from a pool.
+            
+            ImagePool pool;
+            pool.setImageSize(10, 8, 4);
+            GLubyte* copy = source.copyFrame(pool, frame);
+            for (GLsizei y = 0; y < 8; ++y)
+                for (GLsizei x = 0; x < 10; ++x)
+                    assert (copy[(y * 10 + x) * 4 + 2] ==
+                            rawVideoByte(3, x + 4, y + 2, 2));
+            pool.free(copy);
+            
+            bool threw = false;
+            try
+            {
+                source.setRegion(12, 0, 10, 8);
+            }
+            catch (const std::invalid_argument&)
+            {
+                threw = true;
+            }
+            assert (threw);
+            
+            threw = false;
+            try
+            {
+                source.frame(frameCount);
+            }
+            catch (const std::out_of_range&)
+            {
+                threw = true;
+            }
+            assert (threw);
+            
+            // Looping playback starts over, and real-time playback takes as
+            // long as the timestamps span.
+            
+            source.setRegion(0, 0, width, height);
+            source.setLooping(true);
+            source.seek(frameCount - 1);
+            assert (source.next(frame) && (frame.index == frameCount - 1));
+            assert (source.next(frame) && (frame.index == 0));
+            
+            source.setLooping(false);
+            source.setPacing(RawVideoSource::RealTime);
+            source.seek(0);
+            auto start = std::chrono::steady_clock::now();
+            while (source.next(frame))
+            {
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            assert (elapsed >= std::chrono::milliseconds(10 * (frameCount - 1)));
+        }
+        
+        unlink(path.c_str());
+        
+        bool threw = false;
+        try
+        {
+            RawVideoSource missing(path);
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+        assert (threw);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testRawVideoRecorder()
+    {
+        std::cerr << "Starting Agl::testRawVideoRecorder()\n";
+        
+        const GLsizei width = 24;
+        const GLsizei height = 10;
+        char path[] = "/tmp/agltest-XXXXXX";
+        int fd = mkstemp(path);
+        assert (fd != -1);
+        close(fd);
+        
+        ImagePool pool;
+        pool.setImageSize(width, height, 3);
+        auto makeFrame = [&](size_t f)
+        {
+            PooledImage image(pool);
+            GLubyte* p = image.data();
+            for (GLsizei y = 0; y < height; ++y)
+                for (GLsizei x = 0; x < width; ++x)
+                    for (GLsizei c = 0; c < 3; ++c)
+                        *p++ = rawVideoByte(f, x, y, c);
+            return image;
+        };
+        auto checkRecording = [&](size_t frameCount)
+        {
+            RawVideoSource source(path);
+            assert ((source.width() == width) && (source.height() == height));
+            assert ((source.bytesPerPixel() == 3) &&
+                    (source.frameCount() == frameCount));
+            RawVideoFrame frame;
+            for (size_t f = 0; f < frameCount; ++f)
+            {
+                assert (source.next(frame));
+                assert (frame.sequence == f);
+                assert (frame.timestamp == int64_t(f) * 1000000);
+                assert (frame.data[(5 * width + 7) * 3 + 2] ==
+                        rawVideoByte(f, 7, 5, 2));
+            }
+        };
+        
+        // Waiting for room, every frame is written, and the images go back to
+        // the pool.
+        
+        {
+            RawVideoRecorder::Options options;
+            options.queueDepth = 4;
+            options.blockWhenFull = true;
+            RawVideoRecorder recorder(path, width, height, 3, options);
+            for (size_t f = 0; f < 40; ++f)
+                assert (recorder.submit(makeFrame(f), int64_t(f) * 1000000));
+            recorder.flush();
+            assert (pool.stats().outstandingCount == 0);
+            recorder.close();
+            
+            RawVideoRecorder::Stats stats = recorder.stats();
+            assert ((stats.submittedCount == 40) && (stats.writtenCount == 40));
+            assert ((stats.droppedCount == 0) && (stats.queuedCount == 0));
+            assert ((stats.highWaterQueuedCount >= 1) &&
+                    (stats.highWaterQueuedCount <= 4));
+            assert ((stats.writeCount > 0) && (stats.writeCount <= 40));
+        }
+        checkRecording(40);
+        
+        // With direct I/O (where supported) and preallocation, the file ends
+        // up the right size.
+        
+        {
+            RawVideoRecorder::Options options;
+            options.blockWhenFull = true;
+            options.directIo = true;
+            options.preallocateFrameCount = 100;
+            RawVideoRecorder recorder(path, width, height, 3, options);
+            for (size_t f = 0; f < 10; ++f)
+                recorder.submit(makeFrame(f), int64_t(f) * 1000000);
+        }
+        checkRecording(10);
+        struct stat status;
+        stat(path, &status);
+        assert (size_t(status.st_size) == sizeof(RawVideoFileHeader) +
+                10 * rawVideoFrameStride(width, height, 3));
+        
+        // Without waiting, frames may be refused, leaving the image with the
+        // caller, and the recording has gaps in its sequence numbers.
+        
+        {
+            RawVideoRecorder::Options options;
+            options.queueDepth = 1;
+            RawVideoRecorder recorder(path, width, height, 3, options);
+            for (size_t f = 0; f < 200; ++f)
+            {
+                PooledImage image = makeFrame(f);
+                if (!recorder.submit(std::move(image), int64_t(f) * 1000000))
+                    assert (image);
+            }
+            recorder.close();
+            RawVideoRecorder::Stats stats = recorder.stats();
+            assert (stats.submittedCount == 200);
+            assert (stats.writtenCount + stats.droppedCount == 200);
+            
+            RawVideoSource source(path);
+            assert (source.frameCount() == stats.writtenCount);
+            RawVideoFrame frame;
+            int64_t last = -1;
+            while (source.next(frame))
+            {
+                assert (int64_t(frame.sequence) > last);
+                assert (frame.data[0] == rawVideoByte(frame.sequence, 0, 0, 0));
+                last = int64_t(frame.sequence);
+            }
+            
+            bool threw = false;
+            try
+            {
+                recorder.submit(makeFrame(0));
+            }
+            catch (const std::runtime_error&)
+            {
+                threw = true;
+            }
+            assert (threw);
+        }
+        assert (pool.stats().outstandingCount == 0);
+        
+        {
+            RawVideoRecorder recorder(path, width, height, 4);
+            bool threw = false;
+            try
+            {
+                recorder.submit(makeFrame(0));
+            }
+            catch (const std::invalid_argument&)
+            {
+                threw = true;
+            }
+            assert (threw);
+        }
+        unlink(path);
+        
+        bool threw = false;
+        try
+        {
+            RawVideoRecorder recorder("/nonexistent/agltest.raw", width, height, 3);
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+        assert (threw);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testFrameChannel()
+    {
+        std::cerr << "Starting Agl::testFrameChannel()\n";
+        
+        ImagePool pool;
+        pool.setImageSize(4, 4, 4);
+        
+        auto makeFrame = [&pool](int i)
+        {
+            PooledImage image(pool);
+            std::fill(image.data(), image.data() + 4 * 4 * 4, GLubyte(i));
+            return image;
+        };
+        
+        // Without dropping, a full channel refuses a new image and leaves it
+        // with the caller.
+        
+        {
+            FrameChannel channel(2, false);
+            assert ((channel.depth() == 2) && !channel.dropsOldest());
+            
+            PooledImage image;
+            assert (!channel.pop(image));
+            assert (channel.push(makeFrame(1)) && channel.push(makeFrame(2)));
+            assert (channel.size() == 2);
+            
+            PooledImage third = makeFrame(3);
+            assert (!channel.push(std::move(third)));
+            assert (third && (third.data()[0] == 3));
+            
+            assert (channel.pop(image) && (image.data()[0] == 1));
+            assert (channel.push(std::move(third)) && !third);
+            assert (channel.pop(image) && (image.data()[0] == 2));
+            assert (channel.pop(image) && (image.data()[0] == 3));
+            assert (!channel.pop(image) && (image.data()[0] == 3));
+            assert (channel.droppedCount() == 0);
+        }
+        
+        // With dropping, the newest images are delivered, and the dropped
+        // ones go back to the pool.
+        
+        {
+            FrameChannel channel(3);
+            for (int i = 0; i < 10; ++i)
+                assert (channel.push(makeFrame(i)));
+            assert ((channel.size() == 3) && (channel.droppedCount() == 7));
+            assert (pool.stats().outstandingCount == 3);
+            
+            PooledImage image;
+            assert (channel.pop(image) && (image.data()[0] == 7));
+            assert (channel.popLatest(image) && (image.data()[0] == 9));
+            assert ((channel.size() == 0) && (channel.droppedCount() == 8));
+            assert (pool.stats().outstandingCount == 1);
+            
+            // Images left in a channel go back to the pool when it is
+            // destroyed.
+            
+            channel.push(std::move(image));
+            channel.push(makeFrame(10));
+        }
+        assert (pool.stats().outstandingCount == 0);
+        
+        // A depth of 1 is a mailbox: a full cell must not be taken as empty
+        // by the next push, in either mode.
+        
+        {
+            FrameChannel channel(1, false);
+            PooledImage image;
+            assert (!channel.pop(image));
+            assert (channel.push(makeFrame(1)));
+            PooledImage second = makeFrame(2);
+            assert (!channel.push(std::move(second)) && second);
+            assert (channel.size() == 1);
+            assert (channel.pop(image) && (image.data()[0] == 1));
+            assert (!channel.pop(image));
+            assert (channel.push(std::move(second)));
+            assert (channel.pop(image) && (image.data()[0] == 2));
+            assert (!channel.pop(image) && (channel.droppedCount() == 0));
+        }
+        assert (pool.stats().outstandingCount == 0);
+        {
+            FrameChannel channel(1);
+            for (int i = 0; i < 5; ++i)
+                assert (channel.push(makeFrame(i)));
+            assert ((channel.size() == 1) && (channel.droppedCount() == 4));
+            assert (pool.stats().outstandingCount == 1);
+            
+            PooledImage image;
+            assert (channel.pop(image) && (image.data()[0] == 4));
+            assert (!channel.pop(image));
+            assert (channel.push(makeFrame(5)) && channel.push(makeFrame(6)));
+            assert (channel.popLatest(image) && (image.data()[0] == 6));
+            assert (!channel.popLatest(image));
+            assert (channel.droppedCount() == 5);
+            image.reset();
+            assert (pool.stats().outstandingCount == 0);
+            channel.push(makeFrame(7));
+        }
+        assert (pool.stats().outstandingCount == 0);
+        
+        bool threw = false;
+        try
+        {
+            FrameChannel channel(0);
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        assert (threw);
+        
+        // Several producers and consumers on small channels: every image is
+        // either received or dropped, each producer's images arrive in order,
+        // and none stay outstanding.
+        
+        for (size_t depth = 1; depth <= 2; ++depth)
+        {
+            const int producerCount = 2;
+            const int consumerCount = 2;
+            const int frameCount = 5000;
+            FrameChannel channel(depth);
+            std::atomic<int> producersDone(0);
+            std::atomic<int> receivedCount(0);
+            
+            std::vector<std::thread> threads;
+            for (int p = 0; p < producerCount; ++p)
+            {
+                threads.push_back(std::thread([&, p]
+                {
+                    for (int i = 0; i < frameCount; ++i)
+                    {
+                        PooledImage image(pool);
+                        uint32_t tag = uint32_t(p << 24 | i);
+                        memcpy(image.data(), &tag, sizeof(tag));
+                        channel.push(std::move(image));
+                    }
+                    ++producersDone;
+                }));
+            }
+            for (int c = 0; c < consumerCount; ++c)
+            {
+                threads.push_back(std::thread([&]
+                {
+                    std::vector<int> last(producerCount, -1);
+                    PooledImage image;
+                    while ((producersDone.load() < producerCount) ||
+                           (channel.size() > 0))
+                    {
+                        if (!channel.pop(image))
+                            continue;
+                        uint32_t tag;
+                        memcpy(&tag, image.data(), sizeof(tag));
+                        int p = int(tag >> 24);
+                        int i = int(tag & 0xffffff);
+                        assert ((p < producerCount) && (i > last[p]));
+                        last[p] = i;
+                        image.reset();
+                        ++receivedCount;
+                    }
+                }));
+            }
+            for (std::thread& thread : threads)
+                thread.join();
+            
+            PooledImage image;
+            while (channel.pop(image))
+                ++receivedCount;
+            image.reset();
+            assert (uint64_t(receivedCount.load()) + channel.droppedCount() ==
+                    uint64_t(producerCount * frameCount));
+            assert (pool.stats().outstandingCount == 0);
+        }
+        
+        std::cerr << "ok\n";
+    }
+    
+    namespace
+    {
+        
+        // Read back a level of a 2D texture with rows packed tightly,
+        // restoring the binding of the active texture unit so the
+        // bookkeeping of Agl::Texture stays correct.
+        
+        std::vector<GLubyte> readTexture(const Texture& texture, GLint level,
+                                         GLenum format, GLenum type,
+                                         GLsizei bytesPerPixel)
+        {
+            GLint previous = 0;
+            glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+            glBindTexture(GL_TEXTURE_2D, texture.id());
+            
+            GLint width = 0;
+            GLint height = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH,
+                                     &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT,
+                                     &height);
+            std::vector<GLubyte> result(size_t(width) * height * bytesPerPixel);
+            
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glGetTexImage(GL_TEXTURE_2D, level, format, type, result.data());
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            
+            glBindTexture(GL_TEXTURE_2D, GLuint(previous));
+            return result;
+        }
+        
+        // Whether the texels read back match the pixels of the view.
+        
+        bool matches(const std::vector<GLubyte>& texels, const ImageView& view)
+        {
+            const size_t rowSize = size_t(view.width()) * view.bytesPerPixel();
+            if (texels.size() != rowSize * view.height())
+                return false;
+            for (GLsizei y = 0; y < view.height(); ++y)
+            {
+                if (memcmp(&texels[y * rowSize], view.row(y), rowSize) != 0)
+                    return false;
+            }
+            return true;
+        }
+        
+        void fillRandom(std::vector<GLubyte>& data)
+        {
+            for (GLubyte& b : data)
+                b = rand() % 256;
+        }
+        
+    }
+    
+    void testTextureUbyteSetData()
+    {
+        std::cerr << "Starting Agl::testTextureUbyteSetData()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        
+        srand(2);
+        
+        // Views whose rows are not a multiple of 4 bytes, which OpenGL reads
+        // with the wrong stride unless the unpack alignment is 1: odd widths
+        // of RGB and single-component images, and regions of them with row
+        // lengths that are not multiples of 4 either.
+        
+        struct Case
+        {
+            GLenum  format;
+            GLsizei bytesPerPixel;
+            GLsizei width;
+            GLsizei height;
+            GLsizei rowLength;
+            GLsizei skipPixels;
+            GLsizei skipRows;
+        };
+        const Case cases [] =
+        {
+            { GL_RGB, 3, 257, 67, 0, 0, 0 },
+            { GL_RGB, 3, 257, 67, 262, 3, 2 },
+            { GL_RGB, 3, 31, 5, 33, 1, 1 },
+            { GL_RED, 1, 99, 13, 0, 0, 0 },
+            { GL_RED, 1, 99, 13, 101, 1, 3 },
+            { GL_RGBA, 4, 33, 17, 35, 2, 1 }
+        };
+        
+        TextureUbyte texture(GL_TEXTURE_2D);
+        texture.build();
+        for (const Case& c : cases)
+        {
+            GLsizei rowLength = (c.rowLength != 0) ? c.rowLength : c.width;
+            std::vector<GLubyte> data(size_t(rowLength) *
+                                      (c.height + c.skipRows) * c.bytesPerPixel);
+            fillRandom(data);
+            ImageView view(data.data(), c.width, c.height, c.bytesPerPixel,
+                           c.rowLength, c.skipPixels, c.skipRows);
+            
+            texture.setData(view, c.format, c.format);
+            assert (matches(readTexture(texture, 0, c.format, GL_UNSIGNED_BYTE,
+                                        c.bytesPerPixel), view));
+            
+            texture.setData(data.data(), c.width, c.height, c.format, c.format,
+                            c.rowLength, c.skipPixels, c.skipRows);
+            assert (matches(readTexture(texture, 0, c.format, GL_UNSIGNED_BYTE,
+                                        c.bytesPerPixel), view));
+        }
+        assert (glGetError() == GL_NO_ERROR);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testTextureUbyteUpdateData()
+    {
+        std::cerr << "Starting Agl::testTextureUbyteUpdateData()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        
+        srand(3);
+        
+        // An RGB region of odd width in a larger image, so the uploads of the
+        // changed tiles need the row length, skips and an unpack alignment
+        // of 1 to match the rows the detector compared.
+        
+        const GLsizei width = 157;
+        const GLsizei height = 131;
+        const GLsizei rowLength = 163;
+        const GLsizei skipPixels = 5;
+        const GLsizei skipRows = 3;
+        std::vector<GLubyte> data(size_t(rowLength) * (height + skipRows) * 3);
+        fillRandom(data);
+        ImageView view(data.data(), width, height, 3, rowLength, skipPixels,
+                       skipRows);
+        
+        TextureUbyte texture(GL_TEXTURE_2D);
+        texture.build();
+        assert (texture.updateData(view, GL_RGB, GL_RGB) == 9);
+        assert (matches(readTexture(texture, 0, GL_RGB, GL_UNSIGNED_BYTE, 3),
+                        view));
+        
+        // Change pixels in a few tiles, including the partial tiles at the
+        // right and bottom edges.
+        
+        const GLsizei changes [][2] = { { 10, 10 }, { 70, 100 }, { 156, 130 } };
+        for (const GLsizei* change : changes)
+        {
+            GLubyte* pixel = &data[(size_t(skipRows + change[1]) * rowLength +
+                                    skipPixels + change[0]) * 3];
+            pixel[0] ^= 0xff;
+            pixel[2] ^= 0x0f;
+        }
+        assert (texture.updateData(view, GL_RGB, GL_RGB) == 3);
+        assert (matches(readTexture(texture, 0, GL_RGB, GL_UNSIGNED_BYTE, 3),
+                        view));
+        assert (texture.updateData(view, GL_RGB, GL_RGB) == 0);
+        
+        // The same pixels in a different order of components must be
+        // uploaded entirely, even though no bytes changed.
+        
+        std::vector<GLubyte> rgba(64 * 64 * 4);
+        fillRandom(rgba);
+        ImageView rgbaView(rgba.data(), 64, 64, 4);
+        texture.updateData(rgbaView, GL_RGBA, GL_RGBA);
+        assert (texture.updateData(rgbaView, GL_RGBA, GL_BGRA) == 1);
+        assert (matches(readTexture(texture, 0, GL_BGRA, GL_UNSIGNED_BYTE, 4),
+                        rgbaView));
+        assert (glGetError() == GL_NO_ERROR);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testTextureResize()
+    {
+        std::cerr << "Starting Agl::testTextureResize()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        
+        srand(4);
+        
+        TextureUbyte texture(GL_TEXTURE_2D);
+        texture.build();
+        
+        std::vector<GLubyte> data(32 * 16 * 4);
+        fillRandom(data);
+        texture.setData(ImageView(data.data(), 32, 16, 4), GL_RGBA, GL_RGBA,
+                        GL_UNSIGNED_BYTE);
+        
+        const GLenum names [] = { GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER,
+                                  GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T };
+        const GLint values [] = { GL_NEAREST, GL_NEAREST, GL_CLAMP_TO_EDGE,
+                                  GL_MIRRORED_REPEAT };
+        const GLfloat borderColor [] = { 0.25f, 0.5f, 0.75f, 1.0f };
+        glBindTexture(GL_TEXTURE_2D, texture.id());
+        for (size_t i = 0; i < 4; ++i)
+            glTexParameteri(GL_TEXTURE_2D, names[i], values[i]);
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+        Texture::resetBindingCache();
+        
+        // Each new size must keep the parameters, and at most the first one
+        // may replace the texture object.
+        
+        const GLsizei sizes [][2] = { { 47, 23 }, { 20, 9 }, { 33, 65 } };
+        GLuint id = 0;
+        for (const GLsizei* size : sizes)
+        {
+            data.resize(size_t(size[0]) * size[1] * 4);
+            fillRandom(data);
+            ImageView view(data.data(), size[0], size[1], 4);
+            texture.setData(view, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE);
+            
+            if (id != 0)
+                assert (texture.id() == id);
+            id = texture.id();
+            assert (matches(readTexture(texture, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                                        4), view));
+            
+            glBindTexture(GL_TEXTURE_2D, texture.id());
+            for (size_t i = 0; i < 4; ++i)
+            {
+                GLint value = 0;
+                glGetTexParameteriv(GL_TEXTURE_2D, names[i], &value);
+                assert (value == values[i]);
+            }
+            GLfloat color[4];
+            glGetTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, color);
+            assert (std::equal(color, color + 4, borderColor));
+            Texture::resetBindingCache();
+        }
+        assert (glGetError() == GL_NO_ERROR);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testTextureStream()
+    {
+        std::cerr << "Starting Agl::testTextureStream()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        
+        srand(5);
+        
+        // RGBA frames written directly into the buffers, through more frames
+        // than buffers so each buffer is reused.
+        
+        {
+            TextureUbyte texture(GL_TEXTURE_2D);
+            texture.build();
+            TextureStream stream(texture, 33, 17, 4, 2, GL_RGBA, GL_RGBA,
+                                 GL_UNSIGNED_BYTE);
+            assert ((stream.width() == 33) && (stream.height() == 17));
+            assert (stream.bytesPerPixel() == 4);
+            assert (stream.bufferCount() == 2);
+            
+            std::vector<GLubyte> data(33 * 17 * 4);
+            for (int i = 0; i < 5; ++i)
+            {
+                fillRandom(data);
+                MutableImageView buffer = stream.acquire();
+                assert (buffer.isPacked());
+                
+                bool threw = false;
+                try
+                {
+                    stream.acquire();
+                }
+                catch (const std::runtime_error&)
+                {
+                    threw = true;
+                }
+                assert (threw);
+                
+                memcpy(buffer.data(), data.data(), data.size());
+                stream.submit();
+                assert (matches(readTexture(texture, 0, GL_RGBA,
+                                            GL_UNSIGNED_BYTE, 4),
+                                ImageView(data.data(), 33, 17, 4)));
+            }
+            
+            bool threw = false;
+            try
+            {
+                stream.submit();
+            }
+            catch (const std::runtime_error&)
+            {
+                threw = true;
+            }
+            assert (threw);
+        }
+        
+        // RGB frames of odd width, whose packed rows are not a multiple of 4
+        // bytes, copied by upload() from views with and without padding and
+        // from pooled images.
+        
+        {
+            TextureUbyte texture(GL_TEXTURE_2D);
+            texture.build();
+            TextureStream stream(texture, 7, 5, 3, 3, GL_RGB, GL_RGB,
+                                 GL_UNSIGNED_BYTE);
+            
+            std::vector<GLubyte> data(7 * 5 * 3);
+            fillRandom(data);
+            ImageView packed(data.data(), 7, 5, 3);
+            stream.upload(packed);
+            assert (matches(readTexture(texture, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                                        3),
+                            packed));
+            
+            std::vector<GLubyte> padded(11 * 8 * 3);
+            fillRandom(padded);
+            ImageView view(padded.data(), 7, 5, 3, 11, 2, 3);
+            stream.upload(view);
+            assert (matches(readTexture(texture, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                                        3),
+                            view));
+            
+            ImagePool pool;
+            pool.setImageSize(7, 5, 3);
+            PooledImage image(pool);
+            GLubyte* memory = image.data();
+            std::vector<GLubyte> copy(7 * 5 * 3);
+            fillRandom(copy);
+            memcpy(memory, copy.data(), copy.size());
+            stream.upload(std::move(image));
+            assert (!image);
+            assert (matches(readTexture(texture, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                                        3),
+                            ImageView(copy.data(), 7, 5, 3)));
+            
+            // The image was returned to the pool by upload().
+            
+            GLubyte* raw = pool.alloc();
+            assert (raw == memory);
+            pool.free(raw);
+            
+            bool threw = false;
+            try
+            {
+                stream.upload(ImageView(data.data(), 5, 7, 3));
+            }
+            catch (const std::invalid_argument&)
+            {
+                threw = true;
+            }
+            assert (threw);
+        }
+        assert (glGetError() == GL_NO_ERROR);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testPreferredUploadType()
+    {
+        std::cerr << "Starting Agl::testPreferredUploadType()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        
+        // The measured choice is remembered, and shared by the unsized and
+        // sized internal formats.
+        
+        GLenum type = preferredUploadType(GL_BGRA, GL_RGBA);
+        assert ((type == GL_UNSIGNED_BYTE) ||
+                (type == GL_UNSIGNED_INT_8_8_8_8_REV));
+        assert (preferredUploadType(GL_BGRA, GL_RGBA8) == type);
+        assert (preferredUploadType(GL_RGB, GL_RGB8) == GL_UNSIGNED_BYTE);
+        
+        GLenum format = preferredUploadFormat(GL_SRGB8_ALPHA8);
+        assert ((format == GL_RGBA) || (format == GL_BGRA));
+        
+        // A type of 0 asks TextureUbyte for the preferred type, which uploads
+        // the same bytes.
+        
+        srand(6);
+        std::vector<GLubyte> data(19 * 7 * 4);
+        fillRandom(data);
+        ImageView view(data.data(), 19, 7, 4);
+        TextureUbyte texture(GL_TEXTURE_2D);
+        texture.build();
+        texture.setData(view, GL_RGBA, GL_BGRA, 0);
+        assert (matches(readTexture(texture, 0, GL_BGRA, GL_UNSIGNED_BYTE, 4),
+                        view));
+        assert (glGetError() == GL_NO_ERROR);
+        
+        std::cerr << "ok\n";
+    }
+    
+    void testTextureMipmapPyramid()
+    {
+        std::cerr << "Starting Agl::testTextureMipmapPyramid()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        
+        srand(7);
+        
+        // Odd sizes, whose reductions drop a row or column at some levels,
+        // and a view with padding.
+        
+        struct Case
+        {
+            GLsizei width;
+            GLsizei height;
+            GLsizei bytesPerPixel;
+            GLenum  format;
+            GLsizei rowLength;
+            GLsizei skipPixels;
+            GLsizei skipRows;
+        };
+        const Case cases [] =
+        {
+            { 150, 97, 4, GL_RGBA, 0, 0, 0 },
+            { 151, 99, 3, GL_RGB, 0, 0, 0 },
+            { 77, 45, 1, GL_RED, 83, 5, 2 }
+        };
+        
+        for (const Case& c : cases)
+        {
+            const GLsizei rowLength = (c.rowLength != 0) ? c.rowLength :
+                                                            c.width;
+            std::vector<GLubyte> data(size_t(rowLength) *
+                                      (c.height + c.skipRows) *
+                                      c.bytesPerPixel);
+            fillRandom(data);
+            ImageView view(data.data(), c.width, c.height, c.bytesPerPixel,
+                           c.rowLength, c.skipPixels, c.skipRows);
+            
+            TextureUbyte texture(GL_TEXTURE_2D);
+            texture.build();
+            texture.setMipmapPolicy(TextureUbyte::MipmapPyramid);
+            texture.updateData(view, c.format, c.format);
+            const GLsizei levelCount = texture.levelCount();
+            GLsizei expectedCount = 1;
+            while (((c.width >> expectedCount) > 0) &&
+                   ((c.height >> expectedCount) > 0))
+                ++expectedCount;
+            assert (levelCount == expectedCount);
+            
+            std::vector<GLubyte> pyramid(imagePyramidSize(c.width, c.height,
+                                                          c.bytesPerPixel,
+                                                          levelCount - 1));
+            
+            // Change a few pixels each time, in tiles at the edges as well as
+            // inside, and check every level against the pyramid of the whole
+            // frame.
+            
+            for (int i = 0; i < 4; ++i)
+            {
+                if (i > 0)
+                {
+                    for (int j = 0; j < i; ++j)
+                    {
+                        GLsizei x = (j == 0) ? c.width - 1 : rand() % c.width;
+                        GLsizei y = (j == 1) ? c.height - 1 : rand() % c.height;
+                        GLubyte* pixel =
+                            &data[(size_t(c.skipRows + y) * rowLength +
+                                   c.skipPixels + x) * c.bytesPerPixel];
+                        for (GLsizei k = 0; k < c.bytesPerPixel; ++k)
+                            pixel[k] = GLubyte(rand());
+                    }
+                    assert (texture.updateData(view, c.format, c.format) > 0);
+                }
+                
+                generateImagePyramid(pyramid.data(), levelCount - 1, view);
+                assert (matches(readTexture(texture, 0, c.format,
+                                            GL_UNSIGNED_BYTE, c.bytesPerPixel),
+                                view));
+                for (GLsizei level = 1; level < levelCount; ++level)
+                {
+                    ImageView expected =
+                        imagePyramidLevel(pyramid.data(), c.width, c.height,
+                                          c.bytesPerPixel, level);
+                    assert (matches(readTexture(texture, level, c.format,
+                                                GL_UNSIGNED_BYTE,
+                                                c.bytesPerPixel),
+                                    expected));
+                }
+            }
+        }
+        assert (glGetError() == GL_NO_ERROR);
+        
+        std::cerr << "ok\n";
+    }
+    
+    namespace
+    {
+        
+        // The texture bound to GL_TEXTURE_2D on a unit, restoring the active
+        // unit afterwards.
+        
+        GLuint boundTexture(GLenum unit)
+        {
+            GLint active = 0;
+            glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+            glActiveTexture(unit);
+            GLint bound = 0;
+            glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+            glActiveTexture(GLenum(active));
+            return GLuint(bound);
+        }
+        
+        // Whether isBound() is true only where OpenGL has the texture bound,
+        // on the first unitCount units.
+        
+        bool cacheIsConsistent(Texture& texture, GLsizei unitCount)
+        {
+            for (GLsizei i = 0; i < unitCount; ++i)
+            {
+                GLenum unit = GL_TEXTURE0 + i;
+                if (texture.isBound(unit) &&
+                    (boundTexture(unit) != texture.id()))
+                    return false;
+            }
+            return true;
+        }
+        
+        GLenum activeTexture()
+        {
+            GLint active = 0;
+            glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+            return GLenum(active);
+        }
+        
+    }
+    
+    void testTextureBindingCache()
+    {
+        std::cerr << "Starting Agl::testTextureBindingCache()\n";
+        
+        if (!makeOffscreenContextCurrent())
+        {
+            std::cerr << "skipped, no OpenGL context\n";
+            return;
+        }
+        
+        const GLsizei unitCount = std::min(Texture::maxTextureUnits(), 8);
+        assert (unitCount >= 4);
+        
+        std::vector<GLubyte> data(16 * 8 * 4, 0x80);
+        ImageView view(data.data(), 16, 8, 4);
+        TextureUbyte a(GL_TEXTURE_2D);
+        TextureUbyte b(GL_TEXTURE_2D);
+        a.build();
+        b.build();
+        a.setData(view);
+        b.setData(view);
+        
+        glActiveTexture(GL_TEXTURE0);
+        Texture::resetBindingCache();
+        
+        // Each bind() changes the active unit as needed and binds on it.
+        
+        a.bind(GL_TEXTURE0);
+        assert (activeTexture() == GL_TEXTURE0);
+        assert (boundTexture(GL_TEXTURE0) == a.id());
+        assert (a.isBound(GL_TEXTURE0) && !b.isBound(GL_TEXTURE0));
+        
+        b.bind(GL_TEXTURE3);
+        assert (activeTexture() == GL_TEXTURE3);
+        assert (boundTexture(GL_TEXTURE3) == b.id());
+        assert (b.isBound(GL_TEXTURE3) && a.isBound(GL_TEXTURE0));
+        
+        a.bind(GL_TEXTURE3);
+        assert (activeTexture() == GL_TEXTURE3);
+        assert (boundTexture(GL_TEXTURE3) == a.id());
+        assert (!b.isBound(GL_TEXTURE3));
+        assert (cacheIsConsistent(a, unitCount));
+        assert (cacheIsConsistent(b, unitCount));
+        
+        // Setting the data binds the texture on the active unit, which must
+        // not leave another texture recorded there.
+        
+        b.setData(view);
+        assert (cacheIsConsistent(a, unitCount));
+        assert (cacheIsConsistent(b, unitCount));
+        a.bind(GL_TEXTURE3);
+        assert (boundTexture(GL_TEXTURE3) == a.id());
+        
+        // After direct calls and resetBindingCache(), bind() rebinds and sets
+        // the active unit again.
+        
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        Texture::resetBindingCache();
+        assert (!a.isBound(GL_TEXTURE3) && !a.isBound(GL_TEXTURE0));
+        b.bind(GL_TEXTURE1);
+        assert (activeTexture() == GL_TEXTURE1);
+        assert (boundTexture(GL_TEXTURE1) == b.id());
+        a.bind(GL_TEXTURE3);
+        assert (activeTexture() == GL_TEXTURE3);
+        assert (boundTexture(GL_TEXTURE3) == a.id());
+        
+        // A destroyed texture is no longer bound, and a texture made in its
+        // place is not taken to be.
+        
+        {
+            TextureUbyte c(GL_TEXTURE_2D);
+            c.build();
+            c.setData(view);
+            c.bind(GL_TEXTURE2);
+            assert (boundTexture(GL_TEXTURE2) == c.id());
+        }
+        assert (boundTexture(GL_TEXTURE2) == 0);
+        {
+            TextureUbyte d(GL_TEXTURE_2D);
+            d.build();
+            assert (!d.isBound(GL_TEXTURE2));
+            d.setData(view);
+            assert (cacheIsConsistent(d, unitCount));
+            d.bind(GL_TEXTURE2);
+            assert (boundTexture(GL_TEXTURE2) == d.id());
+        }
+        
+        // A new size may replace the texture object, which must then be
+        // bound again by bind().
+        
+        b.bind(GL_TEXTURE1);
+        std::vector<GLubyte> larger(33 * 9 * 4, 0x40);
+        b.setData(ImageView(larger.data(), 33, 9, 4));
+        assert (cacheIsConsistent(a, unitCount));
+        assert (cacheIsConsistent(b, unitCount));
+        b.bind(GL_TEXTURE1);
+        assert (activeTexture() == GL_TEXTURE1);
+        assert (boundTexture(GL_TEXTURE1) == b.id());
+        assert (b.isBound(GL_TEXTURE1));
+        a.bind(GL_TEXTURE3);
+        assert (boundTexture(GL_TEXTURE3) == a.id());
+        
+        assert (glGetError() == GL_NO_ERROR);
+        glActiveTexture(GL_TEXTURE0);
+        Texture::resetBindingCache();
+        
+        std::cerr << "ok\n";
+    }
+    
 }
-
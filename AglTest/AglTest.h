@@ -33,6 +33,34 @@ namespace Agl
 {
     
     void testReduceImageBy2();
+    void testReduceImageBy2Sizes();
+    void testReduceImageBy2Typed();
+    void testReduceImageBy2Parallel();
+    void testThreadPool();
+    void testGenerateImagePyramid();
+    void testReduceImage();
+    void testReduceImageBy2Srgb();
+    void testConvertToRgba();
+    void testReduceYuvToRgbaBy2();
+    void testImagePool();
+    void testImagePoolOptions();
+    void testImagePoolStats();
+    void testImagePoolThreadCache();
+    void testSizedImagePool();
+    void testPooledImage();
+    void testImageView();
+    void testTileChangeDetector();
+    void testFrameChannel();
+    void testSharedMemoryImagePool();
+    void testRawVideoSource();
+    void testRawVideoRecorder();
+    void testTextureUbyteSetData();
+    void testTextureUbyteUpdateData();
+    void testTextureResize();
+    void testTextureStream();
+    void testPreferredUploadType();
+    void testTextureMipmapPyramid();
+    void testTextureBindingCache();
     
 }
 
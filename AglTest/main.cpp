@@ -26,14 +26,61 @@
 // An simple application to run confidence test for (parts of) the Agl library.
 //
 
+#include "AglBenchmark.h"
 #include "AglTest.h"
 #include <iostream>
+#include <string>
+
+// Passing the "-b" argument also runs the benchmarks, after the tests.
 
 int main(int argc, const char * argv[])
 {
     std::cerr << "Starting AglTest\n";
     
     Agl::testReduceImageBy2();
+    Agl::testReduceImageBy2Sizes();
+    Agl::testReduceImageBy2Typed();
+    Agl::testReduceImageBy2Parallel();
+    Agl::testThreadPool();
+    Agl::testGenerateImagePyramid();
+    Agl::testReduceImage();
+    Agl::testReduceImageBy2Srgb();
+    Agl::testConvertToRgba();
+    Agl::testReduceYuvToRgbaBy2();
+    Agl::testImagePool();
+    Agl::testImagePoolOptions();
+    Agl::testImagePoolStats();
+    Agl::testImagePoolThreadCache();
+    Agl::testSizedImagePool();
+    Agl::testPooledImage();
+    Agl::testImageView();
+    Agl::testTileChangeDetector();
+    Agl::testFrameChannel();
+    Agl::testSharedMemoryImagePool();
+    Agl::testRawVideoSource();
+    Agl::testRawVideoRecorder();
+    Agl::testTextureUbyteSetData();
+    Agl::testTextureUbyteUpdateData();
+    Agl::testTextureResize();
+    Agl::testTextureStream();
+    Agl::testPreferredUploadType();
+    Agl::testTextureMipmapPyramid();
+    Agl::testTextureBindingCache();
+    
+    if ((argc > 1) && (std::string(argv[1]) == "-b"))
+    {
+        Agl::benchmarkReduceImageBy2Parallel();
+        Agl::benchmarkReduceImageBy2Srgb();
+        Agl::benchmarkConvertToRgba();
+        Agl::benchmarkReduceYuvToRgbaBy2();
+        Agl::benchmarkImagePoolContention();
+        Agl::benchmarkRawVideoRecorder();
+        Agl::benchmarkTextureUpload();
+        Agl::benchmarkTextureStream();
+        Agl::benchmarkUploadFormats();
+        Agl::benchmarkMipmapUpload();
+        Agl::benchmarkTextureBind();
+    }
     
     std::cerr << "Finished AglTest\n";
     
@@ -0,0 +1,274 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglFrameChannel.cpp
+//
+
+#include "AglFrameChannel.h"
+#include "AglImagePool.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+namespace Agl
+{
+    
+    // The channel is a ring of cells, each with a sequence number saying
+    // whether the cell is ready for the producer or the consumer at a given
+    // position (as in Dmitry Vyukov's bounded MPMC queue).  A producer or
+    // consumer claims a position with a CAS on the shared position counter,
+    // then publishes the cell by advancing its sequence number.  The
+    // sequence is twice the position when the cell is empty for a push at
+    // that position, and one more when it is full for a pop at it.  Vyukov's
+    // queue uses the position itself, which with a depth of 1 makes a full
+    // cell look empty for the next push.
+    
+    class FrameChannel::Imp
+    {
+    public:
+        Imp(size_t depth, bool dropOldest);
+        
+        // The outcomes of tryPush().  Busy means the cell for the next push
+        // has been claimed by a consumer that has not yet published it as
+        // empty, so there will be room momentarily.
+        
+        enum PushResult { Pushed, Full, Busy };
+        
+        PushResult              tryPush(ImagePool* pool, GLubyte* image);
+        bool                    tryPop(ImagePool*& pool, GLubyte*& image);
+        
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            ImagePool*          pool;
+            GLubyte*            image;
+        };
+        
+        size_t                  depth;
+        bool                    dropOldest;
+        std::unique_ptr<Cell[]> cells;
+        
+        // The producer and consumer positions are padded onto separate cache
+        // lines, so producers and consumers do not slow each other down.
+        
+        char                    padding0[64];
+        std::atomic<size_t>     pushPosition;
+        char                    padding1[64];
+        std::atomic<size_t>     popPosition;
+        char                    padding2[64];
+        std::atomic<uint64_t>   droppedCount;
+    };
+    
+    FrameChannel::Imp::Imp(size_t d, bool drop) :
+        depth(d), dropOldest(drop), cells(new Cell[d]), pushPosition(0),
+        popPosition(0), droppedCount(0)
+    {
+        for (size_t i = 0; i < depth; ++i)
+        {
+            cells[i].sequence.store(2 * i, std::memory_order_relaxed);
+            cells[i].pool = nullptr;
+            cells[i].image = nullptr;
+        }
+    }
+    
+    FrameChannel::Imp::PushResult FrameChannel::Imp::tryPush(ImagePool* pool,
+                                                             GLubyte* image)
+    {
+        size_t position = pushPosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells[position % depth];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = intptr_t(sequence) - intptr_t(2 * position);
+            if (difference == 0)
+            {
+                if (pushPosition.compare_exchange_weak(position, position + 1,
+                                                       std::memory_order_relaxed))
+                {
+                    cell.pool = pool;
+                    cell.image = image;
+                    cell.sequence.store(2 * position + 1,
+                                        std::memory_order_release);
+                    return Pushed;
+                }
+            }
+            else if (difference < 0)
+            {
+                // The cell still holds the image from one lap ago, so the
+                // channel is full, unless a consumer has already claimed that
+                // image and is about to publish the cell as empty.
+                
+                size_t popped = popPosition.load(std::memory_order_relaxed);
+                return (popped > position - depth) ? Busy : Full;
+            }
+            else
+            {
+                position = pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    bool FrameChannel::Imp::tryPop(ImagePool*& pool, GLubyte*& image)
+    {
+        size_t position = popPosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells[position % depth];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = intptr_t(sequence) -
+                                  intptr_t(2 * position + 1);
+            if (difference == 0)
+            {
+                if (popPosition.compare_exchange_weak(position, position + 1,
+                                                      std::memory_order_relaxed))
+                {
+                    pool = cell.pool;
+                    image = cell.image;
+                    cell.sequence.store(2 * (position + depth),
+                                        std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                // The cell has not been filled yet, so the channel is empty.
+                
+                return false;
+            }
+            else
+            {
+                position = popPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    FrameChannel::FrameChannel(size_t depth, bool dropOldest)
+    {
+        if (depth == 0)
+            throw std::invalid_argument("Agl::FrameChannel(): depth must be "
+                                        "greater than 0");
+        _m = std::unique_ptr<Imp>(new Imp(depth, dropOldest));
+    }
+    
+    FrameChannel::~FrameChannel()
+    {
+        ImagePool* pool;
+        GLubyte* image;
+        while (_m->tryPop(pool, image))
+            pool->free(image);
+    }
+    
+    size_t FrameChannel::depth() const
+    {
+        return _m->depth;
+    }
+    
+    bool FrameChannel::dropsOldest() const
+    {
+        return _m->dropOldest;
+    }
+    
+    bool FrameChannel::push(PooledImage&& image)
+    {
+        if (!image)
+            return true;
+        
+        ImagePool* pool = image.pool();
+        for (;;)
+        {
+            Imp::PushResult result = _m->tryPush(pool, image.data());
+            if (result == Imp::Pushed)
+                break;
+            
+            // Wait for the consumer to finish with the cell, rather than
+            // dropping another image (or, with a depth of 1, spinning on an
+            // empty channel).
+            
+            if (result == Imp::Busy)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            
+            if (!_m->dropOldest)
+                return false;
+            
+            // Make room by recycling the oldest image.  A consumer may take
+            // it first, in which case there is room anyway.
+            
+            ImagePool* oldestPool;
+            GLubyte* oldest;
+            if (_m->tryPop(oldestPool, oldest))
+            {
+                oldestPool->free(oldest);
+                _m->droppedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        image.release();
+        return true;
+    }
+    
+    bool FrameChannel::pop(PooledImage& image)
+    {
+        ImagePool* pool;
+        GLubyte* data;
+        if (!_m->tryPop(pool, data))
+            return false;
+        image = PooledImage(*pool, data);
+        return true;
+    }
+    
+    bool FrameChannel::popLatest(PooledImage& image)
+    {
+        ImagePool* pool;
+        GLubyte* data;
+        if (!_m->tryPop(pool, data))
+            return false;
+        
+        ImagePool* newerPool;
+        GLubyte* newer;
+        while (_m->tryPop(newerPool, newer))
+        {
+            pool->free(data);
+            _m->droppedCount.fetch_add(1, std::memory_order_relaxed);
+            pool = newerPool;
+            data = newer;
+        }
+        image = PooledImage(*pool, data);
+        return true;
+    }
+    
+    size_t FrameChannel::size() const
+    {
+        size_t popped = _m->popPosition.load(std::memory_order_relaxed);
+        size_t pushed = _m->pushPosition.load(std::memory_order_relaxed);
+        return (pushed > popped) ? std::min(pushed - popped, _m->depth) : 0;
+    }
+    
+    uint64_t FrameChannel::droppedCount() const
+    {
+        return _m->droppedCount.load(std::memory_order_relaxed);
+    }
+    
+}
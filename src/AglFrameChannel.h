@@ -0,0 +1,101 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglFrameChannel.h
+//
+// A bounded queue to hand images from Agl::ImagePool between threads (e.g.,
+// from a camera thread to a rendering thread).  The queue has a fixed depth
+// and is lock free, with any number of producer and consumer threads.  When
+// the queue is full, it can drop the oldest queued image to make room for the
+// newest, returning the dropped image to its pool, so a consumer that falls
+// behind sees the latest frame rather than a backlog of stale ones.  A
+// consumer can also take only the newest queued image, recycling the rest.
+//
+
+#ifndef __AglFrameChannel__
+#define __AglFrameChannel__
+
+#include "AglPooledImage.h"
+#include <memory>
+#include <stdint.h>
+
+namespace Agl
+{
+    class FrameChannel
+    {
+    public:
+        
+        // Create a channel that holds up to depth images.  If dropOldest is
+        // true, push() always succeeds, dropping the oldest queued image when
+        // the channel is full; otherwise push() fails when the channel is
+        // full.  A depth of 1 with dropOldest makes a mailbox that always
+        // holds the newest image.  A depth of 0 causes a
+        // std::invalid_argument exception to be thrown.
+        
+        FrameChannel(size_t depth, bool dropOldest = true);
+        
+        // Return any queued images to their pools.
+        
+        ~FrameChannel();
+        
+        size_t          depth() const;
+        bool            dropsOldest() const;
+        
+        // Queue an image, taking it from the handle.  Returns false, leaving
+        // the image in the handle, if the channel is full and does not drop
+        // the oldest image.  An empty handle is ignored.
+        
+        bool            push(PooledImage&& image);
+        
+        // Take the oldest queued image, if any.  Returns false, leaving
+        // the handle unchanged, if the channel is empty.
+        
+        bool            pop(PooledImage& image);
+        
+        // Take the newest queued image, if any, returning all the older
+        // queued images to their pools.  Returns false, leaving the handle
+        // unchanged, if the channel is empty.
+        
+        bool            popLatest(PooledImage& image);
+        
+        // The number of queued images, which may be out of date as soon as it
+        // is returned if other threads are using the channel.
+        
+        size_t          size() const;
+        
+        // The number of images dropped, by push() to make room or by
+        // popLatest() to skip to the newest.
+        
+        uint64_t        droppedCount() const;
+        
+    private:
+        
+        FrameChannel(const FrameChannel&) = delete;
+        FrameChannel&   operator=(const FrameChannel&) = delete;
+        
+        class Imp;
+        std::unique_ptr<Imp> _m;
+    };
+}
+
+#endif
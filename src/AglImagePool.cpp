@@ -25,23 +25,748 @@
 //
 
 #include "AglImagePool.h"
-#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <vector>
+#if defined(__linux__)
+#include <sched.h>
+#endif
 
 namespace Agl
 {
 
+    namespace
+    {
+        
+        // Each image allocation has a header after the image bytes, so the
+        // image itself keeps the alignment of the allocation.  The header
+        // records the image's slot, and while the image is held by
+        // Agl::SharedFrame instances, it counts them.
+        
+        struct Header
+        {
+            uint32_t                index;
+            std::atomic<uint32_t>   referenceCount;
+        };
+        
+        // Every image has a slot in a directory.  The directory is a fixed
+        // array of chunks that are allocated as needed and never move or get
+        // deleted (until the pool is), so slots can be read without locking,
+        // even after their images have been released by trimming.  A slot
+        // also records the NUMA node of the image's memory, and while the
+        // slot is in a batch (see below), the next slot in the batch and, for
+        // the first slot, the batch's size.
+        
+        struct Slot
+        {
+            std::atomic<GLubyte*>   image;
+            std::atomic<uint32_t>   next;
+            uint32_t                node;
+            uint32_t                batchNext;
+            uint32_t                batchCount;
+        };
+        
+        const uint32_t SlotsPerChunk = 256;
+        const uint32_t MaxChunks = 4096;
+        
+        // The pooled images, and the slots whose images have been released,
+        // are kept on lock-free stacks linked through the slots' next fields.
+        // A stack's head holds a tag in the high 32 bits and, in the low 32
+        // bits, one plus the index of the top slot, or 0 if empty.  The tag
+        // changes with every push and pop, which prevents the ABA problem: a
+        // pop whose head was popped and pushed back by other threads in the
+        // meantime fails its compare-and-swap and retries.
+        
+        const uint64_t IndexMask = 0xffffffff;
+        const uint64_t TagIncrement = uint64_t(1) << 32;
+        
+        // The size of the huge pages for the hugePages option.  Transparent
+        // huge pages on x86-64 and ARM64 Linux are 2 MB.
+        
+        const size_t HugePageSize = 2 * 1024 * 1024;
+        
+        // The most NUMA nodes with separate stacks.  Nodes beyond this share
+        // stacks, which is correct but loses some locality.
+        
+        const uint32_t MaxNodes = 8;
+        
+        int64_t milliseconds()
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+        
+        // The NUMA node of each CPU, read once from sysfs on Linux.  Other
+        // systems are treated as having one node.
+        
+        const std::vector<uint32_t>& cpuNodes()
+        {
+            static const std::vector<uint32_t> nodes = []
+            {
+                std::vector<uint32_t> result;
+#if defined(__linux__)
+                for (uint32_t node = 0; node < 1024; ++node)
+                {
+                    char path[64];
+                    snprintf(path, sizeof(path),
+                             "/sys/devices/system/node/node%u/cpulist", node);
+                    FILE* file = fopen(path, "r");
+                    if (file == nullptr)
+                        continue;
+                    
+                    // The list is ranges like "0-3,8-11".
+                    
+                    unsigned int first, last;
+                    while (fscanf(file, "%u", &first) == 1)
+                    {
+                        last = first;
+                        int c = fgetc(file);
+                        if (c == '-')
+                        {
+                            if (fscanf(file, "%u", &last) != 1)
+                                break;
+                            c = fgetc(file);
+                        }
+                        if (result.size() <= last)
+                            result.resize(last + 1, 0);
+                        for (unsigned int cpu = first; cpu <= last; ++cpu)
+                            result[cpu] = node % MaxNodes;
+                        if (c != ',')
+                            break;
+                    }
+                    fclose(file);
+                }
+#endif
+                return result;
+            }();
+            return nodes;
+        }
+        
+        uint32_t nodeCount()
+        {
+            const std::vector<uint32_t>& nodes = cpuNodes();
+            uint32_t result = 1;
+            for (uint32_t node : nodes)
+                result = std::max(result, node + 1);
+            return result;
+        }
+        
+        uint32_t currentNode()
+        {
+#if defined(__linux__)
+            const std::vector<uint32_t>& nodes = cpuNodes();
+            int cpu = sched_getcpu();
+            if ((cpu >= 0) && (size_t(cpu) < nodes.size()))
+                return nodes[cpu];
+#endif
+            return 0;
+        }
+        
+        // Registering and unregistering thread caches is rare, so a single
+        // mutex for all pools suffices.  It is never destroyed, since threads
+        // may exit after static destruction begins.
+        
+        std::mutex& registryMutex()
+        {
+            static std::mutex* mutex = new std::mutex;
+            return *mutex;
+        }
+        
+        std::atomic<uint64_t> nextPoolId(1);
+        
+    }
+
     class ImagePool::Imp
     {
     public:
-        Imp() : width(0), height(0), bytesPerPixel(0) {}
-        GLsizei                 width;
-        GLsizei                 height;
-        GLsizei                 bytesPerPixel;
-        std::mutex              mutex;
-        std::vector<GLubyte*>   pool;
+        Imp();
+        ~Imp();
+        
+        // A thread cache (magazine) holds images freed by one thread for
+        // reuse by the same thread, without touching any shared cache line.
+        // Only the owning thread uses its images and counters, except that
+        // the pool takes back the images (with the registry mutex locked)
+        // when the pool or the thread goes away.
+        
+        struct Magazine
+        {
+            Magazine(Imp* pool, size_t capacity);
+            
+            Imp*                    pool;
+            uint64_t                poolId;
+            uint32_t                node;
+            size_t                  count;
+            size_t                  capacity;
+            std::unique_ptr<uint32_t[]> indices;
+            
+            // The alloc() and free() calls not yet added to the pool's
+            // counters, which is done when the cache exchanges images with
+            // the pool.
+            
+            std::atomic<uint64_t>   pendingAllocCount;
+            std::atomic<uint64_t>   pendingFreeCount;
+        };
+        
+        // Each thread's caches, one per pool the thread has used.
+        
+        struct ThreadCaches
+        {
+            ThreadCaches();
+            ~ThreadCaches();
+            
+            std::vector<std::shared_ptr<Magazine>> magazines;
+            Magazine*               last;
+        };
+        
+        Header*                 header(GLubyte* image) const;
+        Slot&                   slot(uint32_t index) const;
+        void                    push(std::atomic<uint64_t>& stack, uint32_t index);
+        bool                    pop(std::atomic<uint64_t>& stack, uint32_t& index);
+        void                    pushPooled(uint32_t index);
+        bool                    popPooled(uint32_t node, uint32_t& index);
+        uint32_t                newSlot();
+        GLubyte*                allocNew(uint32_t node);
+        void                    releaseImage(GLubyte* image);
+        size_t                  outstandingCount() const;
+        size_t                  pooledCount() const;
+        void                    noteAlloc(bool hit);
+        void                    noteFree();
+        size_t                  trim();
+        
+        Magazine&               magazine();
+        GLubyte*                allocCached(Magazine& m);
+        void                    freeCached(Magazine& m, GLubyte* image);
+        void                    flushCounts(Magazine& m);
+        void                    drain(Magazine& m);
+        
+        // The image size is set once, before imageSize is set (with release
+        // semantics) to allow allocation.
+        
+        std::atomic<GLsizei>    width;
+        std::atomic<GLsizei>    height;
+        std::atomic<GLsizei>    bytesPerPixel;
+        std::atomic<bool>       sizeSet;
+        std::atomic<size_t>     imageSize;
+        size_t                  headerOffset;
+        Options                 options;
+        size_t                  allocSize;
+        size_t                  allocAlignment;
+        
+        // Each NUMA node has a stack of single pooled images, and a stack of
+        // batches of images moved at once from a full thread cache, each on
+        // its own cache line.
+        
+        struct Node
+        {
+            std::atomic<uint64_t>   pooled;
+            std::atomic<uint64_t>   batches;
+            char                    padding[64 - 2 * sizeof(uint64_t)];
+        };
+        
+        Node                    nodes[MaxNodes];
+        uint32_t                nodeCount;
+        std::atomic<uint64_t>   freeSlots;
+        
+        std::atomic<uint32_t>   slotCount;
+        std::atomic<Slot*>      chunks[MaxChunks];
+        
+        // The thread caches of this pool, guarded by registryMutex().
+        
+        uint64_t                id;
+        std::vector<std::shared_ptr<Magazine>> magazines;
+        
+        // The counters for stats(), and the fewest images in the pool since
+        // the last trim, which is how many trim() can release.  To keep the
+        // common operations cheap, each updates only one counter, and the
+        // outstanding and pooled counts are derived from the others.
+        
+        std::atomic<uint64_t>   allocCount;
+        std::atomic<uint64_t>   missCount;
+        std::atomic<uint64_t>   freeCount;
+        std::atomic<uint64_t>   releaseCount;
+        std::atomic<uint64_t>   retryCount;
+        std::atomic<size_t>     highWaterCount;
+        std::atomic<size_t>     allocatedCount;
+        std::atomic<size_t>     idleCount;
+        std::atomic<int64_t>    nextTrimTime;
     };
     
+    ImagePool::Imp::Imp() :
+        width(0), height(0), bytesPerPixel(0), sizeSet(false), imageSize(0),
+        headerOffset(0), allocSize(0), allocAlignment(0),
+        nodeCount(Agl::nodeCount()), freeSlots(0), slotCount(0),
+        id(nextPoolId.fetch_add(1)), allocCount(0), missCount(0),
+        freeCount(0), releaseCount(0), retryCount(0), highWaterCount(0),
+        allocatedCount(0), idleCount(0), nextTrimTime(0)
+    {
+        for (Node& node : nodes)
+        {
+            node.pooled.store(0, std::memory_order_relaxed);
+            node.batches.store(0, std::memory_order_relaxed);
+        }
+        for (std::atomic<Slot*>& chunk : chunks)
+            chunk.store(nullptr, std::memory_order_relaxed);
+    }
+    
+    ImagePool::Imp::~Imp()
+    {
+        // Only the images in the pool (and thread caches) are deleted.  As
+        // before, an image that was not returned with free() belongs to
+        // whoever allocated it.
+        
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            for (std::shared_ptr<Magazine>& m : magazines)
+            {
+                for (size_t i = 0; i < m->count; ++i)
+                    releaseImage(slot(m->indices[i]).image.load(std::memory_order_relaxed));
+                m->count = 0;
+                m->pool = nullptr;
+            }
+        }
+        
+        uint32_t index;
+        while (popPooled(0, index))
+            releaseImage(slot(index).image.load(std::memory_order_relaxed));
+        
+        for (std::atomic<Slot*>& chunk : chunks)
+            delete [] chunk.load();
+    }
+    
+    Header* ImagePool::Imp::header(GLubyte* image) const
+    {
+        return reinterpret_cast<Header*>(image + headerOffset);
+    }
+    
+    Slot& ImagePool::Imp::slot(uint32_t index) const
+    {
+        Slot* chunk = chunks[index / SlotsPerChunk].load(std::memory_order_acquire);
+        return chunk[index % SlotsPerChunk];
+    }
+    
+    void ImagePool::Imp::push(std::atomic<uint64_t>& stack, uint32_t index)
+    {
+        Slot& s = slot(index);
+        uint64_t head = stack.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            s.next.store(uint32_t(head & IndexMask), std::memory_order_relaxed);
+            uint64_t newHead = ((head & ~IndexMask) + TagIncrement) | (index + 1);
+            if (stack.compare_exchange_weak(head, newHead,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed))
+                return;
+            retryCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    
+    bool ImagePool::Imp::pop(std::atomic<uint64_t>& stack, uint32_t& index)
+    {
+        uint64_t head = stack.load(std::memory_order_acquire);
+        for (;;)
+        {
+            uint32_t top = uint32_t(head & IndexMask);
+            if (top == 0)
+                return false;
+            
+            // The slot may be popped by another thread after head was read,
+            // in which case next may be stale, but then the tag will have
+            // changed and the compare-and-swap will fail.
+            
+            uint32_t next = slot(top - 1).next.load(std::memory_order_relaxed);
+            uint64_t newHead = ((head & ~IndexMask) + TagIncrement) | next;
+            if (stack.compare_exchange_weak(head, newHead,
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire))
+            {
+                index = top - 1;
+                return true;
+            }
+            retryCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    
+    void ImagePool::Imp::pushPooled(uint32_t index)
+    {
+        push(nodes[slot(index).node].pooled, index);
+    }
+    
+    bool ImagePool::Imp::popPooled(uint32_t node, uint32_t& index)
+    {
+        // Prefer images on the specified node, then the other nodes.  An image
+        // taken from a batch leaves the rest of the batch as a smaller batch.
+        
+        for (uint32_t i = 0; i < nodeCount; ++i)
+        {
+            Node& n = nodes[(node + i) % nodeCount];
+            if (pop(n.pooled, index))
+                return true;
+            if (pop(n.batches, index))
+            {
+                Slot& first = slot(index);
+                if (first.batchCount > 1)
+                {
+                    slot(first.batchNext).batchCount = first.batchCount - 1;
+                    push(n.batches, first.batchNext);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    uint32_t ImagePool::Imp::newSlot()
+    {
+        uint32_t index;
+        if (pop(freeSlots, index))
+            return index;
+        
+        index = slotCount.fetch_add(1, std::memory_order_relaxed);
+        if (index >= SlotsPerChunk * MaxChunks)
+        {
+            slotCount.fetch_sub(1, std::memory_order_relaxed);
+            throw std::runtime_error("Agl::ImagePool::alloc() has too many "
+                                     "images outstanding");
+        }
+        
+        // The first thread to need a chunk installs it.
+        
+        std::atomic<Slot*>& chunk = chunks[index / SlotsPerChunk];
+        Slot* slots = chunk.load(std::memory_order_acquire);
+        if (slots == nullptr)
+        {
+            Slot* newSlots = new Slot [SlotsPerChunk];
+            if (!chunk.compare_exchange_strong(slots, newSlots,
+                                               std::memory_order_acq_rel))
+                delete [] newSlots;
+        }
+        return index;
+    }
+    
+    GLubyte* ImagePool::Imp::allocNew(uint32_t node)
+    {
+        uint32_t index = newSlot();
+        
+        void* memory = nullptr;
+        if (posix_memalign(&memory, allocAlignment, allocSize) != 0)
+        {
+            push(freeSlots, index);
+            throw std::bad_alloc();
+        }
+        GLubyte* result = static_cast<GLubyte*>(memory);
+        
+#if defined(MADV_HUGEPAGE)
+        if (options.hugePages && (allocSize >= HugePageSize))
+            madvise(result, allocSize / HugePageSize * HugePageSize, MADV_HUGEPAGE);
+#endif
+        if (options.lockMemory)
+            mlock(result, allocSize);
+        
+        Header* h = new (result + headerOffset) Header;
+        h->index = index;
+        h->referenceCount.store(0, std::memory_order_relaxed);
+        
+        // The slot is published by the release in push() when the image is
+        // freed, before any other thread can find the slot on the stack.  The
+        // memory's pages will be on the node of the thread that first touches
+        // them, which is normally the allocating thread.
+        
+        Slot& s = slot(index);
+        s.image.store(result, std::memory_order_relaxed);
+        s.node = node;
+        allocatedCount.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+    
+    // The counts derived from the counters, which may be briefly off (but
+    // never negative) while other threads are between updates.
+    
+    size_t ImagePool::Imp::outstandingCount() const
+    {
+        int64_t count = int64_t(allocCount.load(std::memory_order_relaxed) -
+                                freeCount.load(std::memory_order_relaxed));
+        return size_t(std::max(count, int64_t(0)));
+    }
+    
+    size_t ImagePool::Imp::pooledCount() const
+    {
+        int64_t count = int64_t(allocatedCount.load(std::memory_order_relaxed)) -
+                        int64_t(outstandingCount());
+        return size_t(std::max(count, int64_t(0)));
+    }
+    
+    void ImagePool::Imp::releaseImage(GLubyte* image)
+    {
+        uint32_t index = header(image)->index;
+        header(image)->~Header();
+        if (options.lockMemory)
+            munlock(image, allocSize);
+        ::free(image);
+        
+        slot(index).image.store(nullptr, std::memory_order_relaxed);
+        push(freeSlots, index);
+        allocatedCount.fetch_sub(1, std::memory_order_relaxed);
+        releaseCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    void ImagePool::Imp::noteAlloc(bool hit)
+    {
+        size_t outstanding = outstandingCount();
+        size_t highWater = highWaterCount.load(std::memory_order_relaxed);
+        while ((outstanding > highWater) &&
+               !highWaterCount.compare_exchange_weak(highWater, outstanding,
+                                                     std::memory_order_relaxed))
+        {
+        }
+        
+        // Track the fewest images in the pool since the last trim, which is
+        // zero if the pool had none.
+        
+        size_t pooled = hit ? pooledCount() : 0;
+        size_t idle = idleCount.load(std::memory_order_relaxed);
+        while ((pooled < idle) &&
+               !idleCount.compare_exchange_weak(idle, pooled,
+                                                std::memory_order_relaxed))
+        {
+        }
+    }
+    
+    void ImagePool::Imp::noteFree()
+    {
+        // Only one thread does each automatic trim, the one that advances the
+        // time for the next.
+        
+        int64_t interval = options.idleTrimInterval.count();
+        if (interval > 0)
+        {
+            int64_t now = milliseconds();
+            int64_t next = nextTrimTime.load(std::memory_order_relaxed);
+            if ((now >= next) &&
+                nextTrimTime.compare_exchange_strong(next, now + interval,
+                                                     std::memory_order_relaxed))
+                trim();
+        }
+    }
+    
+    size_t ImagePool::Imp::trim()
+    {
+        // Images that stayed in the pool since the last trim were not needed,
+        // so release that many.  The count starts over from what remains.
+        
+        size_t idle = idleCount.exchange(SIZE_MAX, std::memory_order_relaxed);
+        idle = std::min(idle, pooledCount());
+        
+        size_t released = 0;
+        uint32_t index;
+        while ((released < idle) && popPooled(0, index))
+        {
+            releaseImage(slot(index).image.load(std::memory_order_relaxed));
+            ++released;
+        }
+        
+        size_t current = SIZE_MAX;
+        idleCount.compare_exchange_strong(current, pooledCount(),
+                                          std::memory_order_relaxed);
+        return released;
+    }
+    
+    ImagePool::Imp::Magazine::Magazine(Imp* p, size_t c) :
+        pool(p), poolId(p->id), node(currentNode()), count(0), capacity(c),
+        indices(new uint32_t[c]), pendingAllocCount(0), pendingFreeCount(0)
+    {
+    }
+    
+    ImagePool::Imp::ThreadCaches::ThreadCaches() :
+        last(nullptr)
+    {
+    }
+    
+    ImagePool::Imp::ThreadCaches::~ThreadCaches()
+    {
+        // The thread is exiting, so return its cached images to the pools
+        // that still exist.
+        
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (std::shared_ptr<Magazine>& m : magazines)
+        {
+            Imp* pool = m->pool;
+            if (pool == nullptr)
+                continue;
+            pool->drain(*m);
+            m->pool = nullptr;
+            std::vector<std::shared_ptr<Magazine>>& all = pool->magazines;
+            all.erase(std::find(all.begin(), all.end(), m));
+        }
+    }
+    
+    ImagePool::Imp::Magazine& ImagePool::Imp::magazine()
+    {
+        static thread_local ThreadCaches caches;
+        if ((caches.last != nullptr) && (caches.last->poolId == id))
+            return *caches.last;
+        
+        for (std::shared_ptr<Magazine>& m : caches.magazines)
+        {
+            if (m->poolId == id)
+            {
+                caches.last = m.get();
+                return *m;
+            }
+        }
+        
+        // The first use of this pool by this thread registers a new cache,
+        // and forgets the caches of pools that no longer exist.
+        
+        std::shared_ptr<Magazine> m(new Magazine(this, options.threadCacheSize));
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            std::vector<std::shared_ptr<Magazine>>& mine = caches.magazines;
+            mine.erase(std::remove_if(mine.begin(), mine.end(),
+                                      [](const std::shared_ptr<Magazine>& old)
+                                      {
+                                          return old->pool == nullptr;
+                                      }), mine.end());
+            mine.push_back(m);
+            magazines.push_back(m);
+        }
+        caches.last = m.get();
+        return *m;
+    }
+    
+    GLubyte* ImagePool::Imp::allocCached(Magazine& m)
+    {
+        if (m.count > 0)
+        {
+            m.pendingAllocCount.store(m.pendingAllocCount.load(std::memory_order_relaxed) + 1,
+                                      std::memory_order_relaxed);
+            return slot(m.indices[--m.count]).image.load(std::memory_order_relaxed);
+        }
+        
+        // The cache is empty, so refill it with a batch from the thread's node
+        // if possible, with one CAS for the whole batch.  Otherwise take a
+        // single image, preferably from the same node, or allocate one.
+        
+        flushCounts(m);
+        m.node = currentNode();
+        
+        uint32_t index;
+        bool hit = true;
+        if (pop(nodes[m.node].batches, index))
+        {
+            Slot& first = slot(index);
+            uint32_t next = first.batchNext;
+            for (uint32_t i = 1; i < first.batchCount; ++i)
+            {
+                m.indices[m.count++] = next;
+                next = slot(next).batchNext;
+            }
+        }
+        else if (!popPooled(m.node, index))
+        {
+            hit = false;
+        }
+        
+        GLubyte* result;
+        if (hit)
+        {
+            result = slot(index).image.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            result = allocNew(m.node);
+            missCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        allocCount.fetch_add(1, std::memory_order_relaxed);
+        noteAlloc(hit);
+        return result;
+    }
+    
+    void ImagePool::Imp::freeCached(Magazine& m, GLubyte* image)
+    {
+        m.pendingFreeCount.store(m.pendingFreeCount.load(std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+        
+        // An image from another node goes back to that node.
+        
+        uint32_t index = header(image)->index;
+        if (slot(index).node != m.node)
+        {
+            pushPooled(index);
+            return;
+        }
+        
+        if (m.count == m.capacity)
+        {
+            // The cache is full, so move its older half to the node's batches,
+            // keeping the recently used images, whose memory is more likely to
+            // be in the CPU cache.  The batch is released instead if the pool
+            // is over its limit.
+            
+            flushCounts(m);
+            size_t batchCount = (m.capacity + 1) / 2;
+            size_t maxPooled = options.maxPooledCount;
+            if ((maxPooled != 0) && (pooledCount() > maxPooled))
+            {
+                for (size_t i = 0; i < batchCount; ++i)
+                    releaseImage(slot(m.indices[i]).image.load(std::memory_order_relaxed));
+            }
+            else
+            {
+                for (size_t i = 0; i + 1 < batchCount; ++i)
+                    slot(m.indices[i]).batchNext = m.indices[i + 1];
+                slot(m.indices[0]).batchCount = uint32_t(batchCount);
+                push(nodes[m.node].batches, m.indices[0]);
+            }
+            m.count -= batchCount;
+            std::copy(m.indices.get() + batchCount,
+                      m.indices.get() + batchCount + m.count, m.indices.get());
+            noteFree();
+        }
+        m.indices[m.count++] = index;
+    }
+    
+    void ImagePool::Imp::flushCounts(Magazine& m)
+    {
+        uint64_t allocs = m.pendingAllocCount.load(std::memory_order_relaxed);
+        uint64_t frees = m.pendingFreeCount.load(std::memory_order_relaxed);
+        if (allocs != 0)
+            allocCount.fetch_add(allocs, std::memory_order_relaxed);
+        if (frees != 0)
+            freeCount.fetch_add(frees, std::memory_order_relaxed);
+        m.pendingAllocCount.store(0, std::memory_order_relaxed);
+        m.pendingFreeCount.store(0, std::memory_order_relaxed);
+    }
+    
+    void ImagePool::Imp::drain(Magazine& m)
+    {
+        flushCounts(m);
+        for (size_t i = 0; i < m.count; ++i)
+            pushPooled(m.indices[i]);
+        m.count = 0;
+    }
+    
+    ImagePool::Options::Options() :
+        alignment(0), hugePages(false), preallocateCount(0), lockMemory(false),
+        maxPooledCount(0), idleTrimInterval(0), threadCacheSize(0)
+    {
+    }
+    
+    ImagePool::Stats::Stats() :
+        allocCount(0), hitCount(0), missCount(0), freeCount(0),
+        releaseCount(0), retryCount(0), outstandingCount(0),
+        highWaterCount(0), pooledCount(0), allocatedCount(0)
+    {
+    }
+    
     ImagePool::ImagePool() :
         _m(new Imp)
     {
@@ -49,74 +774,181 @@ namespace Agl
     
     ImagePool::~ImagePool()
     {
-        while (!_m->pool.empty())
-        {
-            delete [] _m->pool.back();
-            _m->pool.pop_back();
-        }
     }
     
     void ImagePool::setImageSize(GLsizei width, GLsizei height,
-                                 GLsizei bytesPerPixel)
+                                 GLsizei bytesPerPixel, const Options& options)
     {
-        std::lock_guard<std::mutex> lock(_m->mutex);
+        if ((options.alignment & (options.alignment - 1)) != 0)
+        {
+            throw std::invalid_argument("Agl::ImagePool::setImageSize() needs "
+                                        "an alignment that is a power of two");
+        }
+        
+        // A size of zero leaves the size unset, as it was originally.
         
-        if ((_m->width != 0) || (_m->height != 0) || (_m->bytesPerPixel != 0))
+        bool expected = false;
+        if (!_m->sizeSet.compare_exchange_strong(expected, true))
         {
             throw std::runtime_error("Agl::ImagePool::setImageSize() "
                                      "can be called only once");
         }
         
-        _m->width = width;
-        _m->height = height;
-        _m->bytesPerPixel = bytesPerPixel;
+        _m->width.store(width, std::memory_order_relaxed);
+        _m->height.store(height, std::memory_order_relaxed);
+        _m->bytesPerPixel.store(bytesPerPixel, std::memory_order_relaxed);
+        
+        if ((width == 0) && (height == 0) && (bytesPerPixel == 0))
+        {
+            _m->sizeSet.store(false);
+            return;
+        }
+        
+        size_t size = size_t(width) * height * bytesPerPixel;
+        const size_t headerAlignment = alignof(Header);
+        _m->headerOffset = (size + headerAlignment - 1) / headerAlignment *
+                           headerAlignment;
+        _m->allocSize = _m->headerOffset + sizeof(Header);
+        _m->options = options;
+        _m->nextTrimTime.store(milliseconds() + options.idleTrimInterval.count(),
+                               std::memory_order_relaxed);
+        
+        // posix_memalign() needs at least the alignment of a pointer.
+        
+        _m->allocAlignment = std::max(options.alignment, sizeof(void*));
+        _m->allocAlignment = std::max(_m->allocAlignment, size_t(16));
+        if (options.hugePages && (_m->allocSize >= HugePageSize))
+            _m->allocAlignment = std::max(_m->allocAlignment, HugePageSize);
+        
+        if ((width != 0) && (height != 0) && (bytesPerPixel != 0))
+        {
+            // Writing the images faults in every page now, rather than when
+            // the first frames are produced.  Preallocated images are not
+            // misses, which only alloc() counts.  The size is published last,
+            // so no alloc() runs concurrently with the preallocation.
+            
+            uint32_t node = currentNode();
+            for (size_t i = 0; i < options.preallocateCount; ++i)
+            {
+                GLubyte* image = _m->allocNew(node);
+                memset(image, 0, size);
+                _m->pushPooled(_m->header(image)->index);
+            }
+            _m->idleCount.store(options.preallocateCount, std::memory_order_relaxed);
+            
+            _m->imageSize.store(size, std::memory_order_release);
+        }
     }
 
     GLsizei ImagePool::imageWidth() const
     {
-        std::lock_guard<std::mutex> lock(_m->mutex);
-        return _m->width;
+        return _m->width.load(std::memory_order_relaxed);
     }
     
     GLsizei ImagePool::imageHeight() const
     {
-        std::lock_guard<std::mutex> lock(_m->mutex);
-        return _m->height;
+        return _m->height.load(std::memory_order_relaxed);
     }
     
     GLsizei ImagePool::bytesPerPixel() const
     {
-        std::lock_guard<std::mutex> lock(_m->mutex);
-        return _m->bytesPerPixel;
+        return _m->bytesPerPixel.load(std::memory_order_relaxed);
     }
     
     GLubyte* ImagePool::alloc()
     {
-        std::lock_guard<std::mutex> lock(_m->mutex);
-        
-        if ((_m->width == 0) || (_m->height == 0) || (_m->bytesPerPixel == 0))
+        if (_m->imageSize.load(std::memory_order_acquire) == 0)
         {
             throw std::runtime_error("Agl::ImagePool::setImageSize() "
                                      "must be called (once) to set a non-zero "
                                      "image size");
         }
         
-        if (_m->pool.empty())
+        if (_m->options.threadCacheSize != 0)
+            return _m->allocCached(_m->magazine());
+        
+        uint32_t node = (_m->nodeCount > 1) ? currentNode() : 0;
+        uint32_t index;
+        bool hit = _m->popPooled(node, index);
+        GLubyte* result;
+        if (hit)
         {
-            return new GLubyte [_m->width * _m->height * _m->bytesPerPixel];
+            result = _m->slot(index).image.load(std::memory_order_relaxed);
         }
         else
         {
-            GLubyte* result = _m->pool.back();
-            _m->pool.pop_back();
-            return result;
+            result = _m->allocNew(node);
+            _m->missCount.fetch_add(1, std::memory_order_relaxed);
         }
+        _m->allocCount.fetch_add(1, std::memory_order_relaxed);
+        _m->noteAlloc(hit);
+        return result;
     }
     
     void ImagePool::free(GLubyte* image)
     {
-        std::lock_guard<std::mutex> lock(_m->mutex);
+        if (_m->options.threadCacheSize != 0)
+        {
+            _m->freeCached(_m->magazine(), image);
+            return;
+        }
+        
+        _m->freeCount.fetch_add(1, std::memory_order_relaxed);
         
-        _m->pool.push_back(image);
+        size_t maxPooled = _m->options.maxPooledCount;
+        if ((maxPooled != 0) && (_m->pooledCount() > maxPooled))
+            _m->releaseImage(image);
+        else
+            _m->pushPooled(_m->header(image)->index);
+        
+        _m->noteFree();
+    }
+    
+    size_t ImagePool::trim()
+    {
+        return _m->trim();
+    }
+    
+    ImagePool::Stats ImagePool::stats() const
+    {
+        Stats result;
+        result.allocCount = _m->allocCount.load(std::memory_order_relaxed);
+        result.missCount = _m->missCount.load(std::memory_order_relaxed);
+        result.freeCount = _m->freeCount.load(std::memory_order_relaxed);
+        result.releaseCount = _m->releaseCount.load(std::memory_order_relaxed);
+        result.retryCount = _m->retryCount.load(std::memory_order_relaxed);
+        result.highWaterCount = _m->highWaterCount.load(std::memory_order_relaxed);
+        result.allocatedCount = _m->allocatedCount.load(std::memory_order_relaxed);
+        
+        // Include the calls not yet counted by the thread caches.
+        
+        if (_m->options.threadCacheSize != 0)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            for (std::shared_ptr<Imp::Magazine>& m : _m->magazines)
+            {
+                result.allocCount += m->pendingAllocCount.load(std::memory_order_relaxed);
+                result.freeCount += m->pendingFreeCount.load(std::memory_order_relaxed);
+            }
+        }
+        
+        result.hitCount = result.allocCount - std::min(result.allocCount,
+                                                       result.missCount);
+        result.outstandingCount = size_t(result.allocCount -
+                                         std::min(result.allocCount, result.freeCount));
+        result.pooledCount = result.allocatedCount -
+                             std::min(result.allocatedCount, result.outstandingCount);
+        return result;
+    }
+    
+    size_t ImagePool::pageSize()
+    {
+        static const size_t size = size_t(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+    
+    std::atomic<uint32_t>& ImagePool::referenceCount(GLubyte* image)
+    {
+        return _m->header(image)->referenceCount;
     }
-}
\ No newline at end of file
+}
@@ -29,14 +29,21 @@
 // retained in a pool, so actual allocations are necessary only if the producer
 // gets ahead of the consumer.  Since the class is designed to support the
 // producer and consumer being in separate threads, the operations of this class
-// are thread safe.
+// are thread safe.  They are also lock free: the retained memory is kept on a
+// lock-free stack, and the image size is published once and then read without
+// locking, so several producer and consumer threads do not contend on a mutex.
+// Optional per-thread caches avoid even the shared stack when many threads
+// allocate and free at high rates.
 //
 
 #ifndef __AglImagePool__
 #define __AglImagePool__
 
 #include <OpenGL/gl3.h>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <stdint.h>
 
 namespace Agl
 {
@@ -47,12 +54,72 @@ namespace Agl
         ImagePool();
         ~ImagePool();
         
-        // Set the size of images that will be managed by this class.  If this
-        // routine is called to set the image size to be non-zero more than once,
-        // a std::runtime_error exception is thrown.
+        // Options for how the image memory is allocated.
+        
+        struct Options
+        {
+            Options();
+            
+            // The alignment in bytes of each image, a power of two, such as
+            // 64 for the widest SIMD loads or pageSize() for page alignment.
+            // The default of 0 means the alignment of operator new.
+            
+            size_t  alignment;
+            
+            // Whether to advise the operating system to back the images with
+            // huge pages, to reduce TLB misses when large images are processed.
+            // Images of at least one huge page are then aligned to huge pages.
+            // This option has no effect where the advice is not supported.
+            
+            bool    hugePages;
+            
+            // The number of images to allocate when setImageSize() is called,
+            // with every page touched so no page faults occur when the first
+            // images are used.
+            
+            size_t  preallocateCount;
+            
+            // Whether to lock the images in physical memory with mlock(), so
+            // they are never paged out.  If the system refuses (e.g., beyond
+            // the limit on locked memory), the images are used unlocked.
+            
+            bool    lockMemory;
+            
+            // The most images to keep in the pool.  An image freed when the
+            // pool already has this many is released instead.  The default of
+            // 0 means no limit.
+            
+            size_t  maxPooledCount;
+            
+            // If non-zero, trim() is called automatically by free() when at
+            // least this long has passed since the previous trim, so images
+            // retained after a burst of allocations are released once the
+            // burst is over.
+            
+            std::chrono::milliseconds   idleTrimInterval;
+            
+            // If non-zero, each thread keeps up to this many freed images in
+            // a cache of its own, and reuses them without touching memory
+            // shared with other threads.  A thread's cache exchanges half its
+            // capacity at a time with the pool, and an image freed on another
+            // NUMA node than where it was allocated returns to its own node.
+            // This helps when many threads allocate and free images at high
+            // rates.  The stats and trimming then see the cached images only
+            // when the caches exchange images with the pool, and a thread's
+            // cached images go back to the pool when the thread exits.
+            
+            size_t  threadCacheSize;
+        };
+        
+        // Set the size of images that will be managed by this class, and
+        // the options for allocating them.  If this routine is called to set
+        // the image size to be non-zero more than once, a std::runtime_error
+        // exception is thrown.  If options.alignment is not a power of two, a
+        // std::invalid_argument exception is thrown.
         
         void        setImageSize (GLsizei width, GLsizei height,
-                                  GLsizei bytesPerPixel);
+                                  GLsizei bytesPerPixel,
+                                  const Options& options = Options());
         
         // Access the size of the images managed by this class.
         
@@ -66,11 +133,71 @@ namespace Agl
         
         GLubyte*    alloc();
         
-        // Return image memory to the pool for reuse.
+        // Return image memory to the pool for reuse.  The memory must have
+        // been obtained from alloc() on this pool.
         
         void        free(GLubyte*);
         
+        // Release the images that have stayed in the pool, unused, since the
+        // previous call (or since setImageSize() for the first call), and
+        // return how many were released.  The pool keeps the images that
+        // were needed, so calling this routine periodically lets the pool
+        // shrink to what recent use requires.
+        
+        size_t      trim();
+        
+        // Counters describing the use of the pool.
+        
+        struct Stats
+        {
+            Stats();
+            
+            // The calls to alloc(), and how many were served from the pool
+            // (hits) or needed new allocations (misses).
+            
+            uint64_t    allocCount;
+            uint64_t    hitCount;
+            uint64_t    missCount;
+            
+            // The calls to free(), and the images released by trim() or
+            // because of maxPooledCount.
+            
+            uint64_t    freeCount;
+            uint64_t    releaseCount;
+            
+            // The times an operation had to retry because another thread
+            // changed the pool at the same moment, a measure of contention.
+            
+            uint64_t    retryCount;
+            
+            // The images currently allocated and not freed, the most that
+            // have been at once, the images currently in the pool, and the
+            // total images currently allocated by the pool (i.e., outstanding
+            // and pooled).
+            
+            size_t      outstandingCount;
+            size_t      highWaterCount;
+            size_t      pooledCount;
+            size_t      allocatedCount;
+        };
+        
+        // Get the current values of the counters.  Since other threads may be
+        // using the pool, the values are not necessarily consistent with each
+        // other.
+        
+        Stats       stats() const;
+        
+        // The size of a virtual memory page, in bytes.
+        
+        static size_t   pageSize();
+        
     private:
+        
+        // Agl::SharedFrame keeps its reference count in memory the pool
+        // reserves with each image, so sharing an image allocates nothing.
+        
+        friend class SharedFrame;
+        std::atomic<uint32_t>&  referenceCount(GLubyte* image);
 
         // Details of the class' data are hidden in the .cpp file.
         
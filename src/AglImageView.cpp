@@ -0,0 +1,230 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglImageView.cpp
+//
+
+#include "AglImageView.h"
+#include <stdexcept>
+
+namespace Agl
+{
+    
+    ImageView::ImageView() :
+        _data(nullptr), _width(0), _height(0), _bytesPerPixel(0),
+        _rowLength(0), _skipPixels(0), _skipRows(0)
+    {
+    }
+    
+    ImageView::ImageView(const GLubyte* data, GLsizei width, GLsizei height,
+                         GLsizei bytesPerPixel, GLsizei rowLength,
+                         GLsizei skipPixels, GLsizei skipRows) :
+        _data(data), _width(width), _height(height),
+        _bytesPerPixel(bytesPerPixel), _rowLength(rowLength),
+        _skipPixels(skipPixels), _skipRows(skipRows)
+    {
+        if ((width < 0) || (height < 0) || (bytesPerPixel < 0) ||
+            (rowLength < 0) || (skipPixels < 0) || (skipRows < 0))
+        {
+            throw std::invalid_argument("Agl::ImageView(): the dimensions "
+                                        "must not be negative");
+        }
+        if ((rowLength != 0) && (skipPixels + width > rowLength))
+        {
+            throw std::invalid_argument("Agl::ImageView(): the region extends "
+                                        "past the row length");
+        }
+    }
+    
+    const GLubyte* ImageView::data() const
+    {
+        return _data;
+    }
+    
+    GLsizei ImageView::width() const
+    {
+        return _width;
+    }
+    
+    GLsizei ImageView::height() const
+    {
+        return _height;
+    }
+    
+    GLsizei ImageView::bytesPerPixel() const
+    {
+        return _bytesPerPixel;
+    }
+    
+    GLsizei ImageView::rowLength() const
+    {
+        return _rowLength;
+    }
+    
+    GLsizei ImageView::skipPixels() const
+    {
+        return _skipPixels;
+    }
+    
+    GLsizei ImageView::skipRows() const
+    {
+        return _skipRows;
+    }
+    
+    size_t ImageView::stride() const
+    {
+        GLsizei rowPixels = (_rowLength != 0) ? _rowLength : _width;
+        return size_t(rowPixels) * _bytesPerPixel;
+    }
+    
+    const GLubyte* ImageView::pixels() const
+    {
+        return _data + _skipRows * stride() + size_t(_skipPixels) * _bytesPerPixel;
+    }
+    
+    const GLubyte* ImageView::row(GLsizei y) const
+    {
+        return pixels() + y * stride();
+    }
+    
+    bool ImageView::empty() const
+    {
+        return (_width == 0) || (_height == 0);
+    }
+    
+    bool ImageView::isPacked() const
+    {
+        return ((_rowLength == 0) || (_rowLength == _width)) &&
+               (_skipPixels == 0) && (_skipRows == 0);
+    }
+    
+    ImageView ImageView::region(GLsizei x, GLsizei y, GLsizei width,
+                                GLsizei height) const
+    {
+        if ((x < 0) || (y < 0) || (width < 0) || (height < 0) ||
+            (x + width > _width) || (y + height > _height))
+        {
+            throw std::out_of_range("Agl::ImageView::region(): the region is "
+                                    "not within the view");
+        }
+        
+        // The sub-region keeps the same memory and row length, so it can
+        // still be described by the OpenGL unpack parameters.
+        
+        GLsizei rowPixels = (_rowLength != 0) ? _rowLength : _width;
+        return ImageView(_data, width, height, _bytesPerPixel, rowPixels,
+                         _skipPixels + x, _skipRows + y);
+    }
+    
+    MutableImageView::MutableImageView()
+    {
+    }
+    
+    MutableImageView::MutableImageView(GLubyte* data, GLsizei width,
+                                       GLsizei height, GLsizei bytesPerPixel,
+                                       GLsizei rowLength, GLsizei skipPixels,
+                                       GLsizei skipRows) :
+        _view(data, width, height, bytesPerPixel, rowLength, skipPixels,
+              skipRows)
+    {
+    }
+    
+    MutableImageView::operator ImageView() const
+    {
+        return _view;
+    }
+    
+    // The memory was writable when the view was made, so casting away the
+    // constness of the read-only view's pointers is safe.
+    
+    GLubyte* MutableImageView::data() const
+    {
+        return const_cast<GLubyte*>(_view.data());
+    }
+    
+    GLsizei MutableImageView::width() const
+    {
+        return _view.width();
+    }
+    
+    GLsizei MutableImageView::height() const
+    {
+        return _view.height();
+    }
+    
+    GLsizei MutableImageView::bytesPerPixel() const
+    {
+        return _view.bytesPerPixel();
+    }
+    
+    GLsizei MutableImageView::rowLength() const
+    {
+        return _view.rowLength();
+    }
+    
+    GLsizei MutableImageView::skipPixels() const
+    {
+        return _view.skipPixels();
+    }
+    
+    GLsizei MutableImageView::skipRows() const
+    {
+        return _view.skipRows();
+    }
+    
+    size_t MutableImageView::stride() const
+    {
+        return _view.stride();
+    }
+    
+    GLubyte* MutableImageView::pixels() const
+    {
+        return const_cast<GLubyte*>(_view.pixels());
+    }
+    
+    GLubyte* MutableImageView::row(GLsizei y) const
+    {
+        return const_cast<GLubyte*>(_view.row(y));
+    }
+    
+    bool MutableImageView::empty() const
+    {
+        return _view.empty();
+    }
+    
+    bool MutableImageView::isPacked() const
+    {
+        return _view.isPacked();
+    }
+    
+    MutableImageView MutableImageView::region(GLsizei x, GLsizei y,
+                                              GLsizei width,
+                                              GLsizei height) const
+    {
+        ImageView view = _view.region(x, y, width, height);
+        return MutableImageView(data(), view.width(), view.height(),
+                                view.bytesPerPixel(), view.rowLength(),
+                                view.skipPixels(), view.skipRows());
+    }
+    
+}
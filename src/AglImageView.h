@@ -0,0 +1,147 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglImageView.h
+//
+// Lightweight values describing a region of an image in memory, so a crop,
+// a subregion or a level of an image pyramid can be passed to the image
+// utilities and texture uploads without copying the pixels or threading six
+// integers through every layer.  A view has the same parameters as the
+// original image arguments of Agl::reduceImageBy2() and
+// Agl::TextureUbyte::setData(): the memory, the width and height of the
+// region, the bytes per pixel, and the row length (in pixels, 0 meaning the
+// width), skip pixels and skip rows locating the region (as for the OpenGL
+// GL_UNPACK_ROW_LENGTH, GL_UNPACK_SKIP_PIXELS and GL_UNPACK_SKIP_ROWS
+// parameters).  The parameters are checked once, when the view is made,
+// rather than by each routine it is passed to.  A view does not own the
+// memory.  An Agl::ImageView is read only, and an Agl::MutableImageView
+// allows writing and converts to an ImageView.
+//
+
+#ifndef __AglImageView__
+#define __AglImageView__
+
+#include <OpenGL/gl3.h>
+#include <stddef.h>
+
+namespace Agl
+{
+    
+    class ImageView
+    {
+    public:
+        
+        // Create an empty view.
+        
+        ImageView();
+        
+        // Create a view of a region of an image.  If the width, height or
+        // bytesPerPixel is negative, or the region extends past the row
+        // length, a std::invalid_argument exception is thrown.
+        
+        ImageView(const GLubyte* data, GLsizei width, GLsizei height,
+                  GLsizei bytesPerPixel, GLsizei rowLength = 0,
+                  GLsizei skipPixels = 0, GLsizei skipRows = 0);
+        
+        // Access the parameters of the view, as passed to the constructor.
+        
+        const GLubyte*  data() const;
+        GLsizei         width() const;
+        GLsizei         height() const;
+        GLsizei         bytesPerPixel() const;
+        GLsizei         rowLength() const;
+        GLsizei         skipPixels() const;
+        GLsizei         skipRows() const;
+        
+        // The bytes from one row to the next, the first byte of the region,
+        // and the first byte of a row of the region.
+        
+        size_t          stride() const;
+        const GLubyte*  pixels() const;
+        const GLubyte*  row(GLsizei y) const;
+        
+        // Whether the view has no pixels, and whether its rows are
+        // contiguous, with no region skipped at all.
+        
+        bool            empty() const;
+        bool            isPacked() const;
+        
+        // A view of a region of this view, with x and y relative to this
+        // view's region.  If the region is not within this view, a
+        // std::out_of_range exception is thrown.
+        
+        ImageView       region(GLsizei x, GLsizei y, GLsizei width,
+                               GLsizei height) const;
+        
+    private:
+        
+        const GLubyte*  _data;
+        GLsizei         _width;
+        GLsizei         _height;
+        GLsizei         _bytesPerPixel;
+        GLsizei         _rowLength;
+        GLsizei         _skipPixels;
+        GLsizei         _skipRows;
+    };
+    
+    class MutableImageView
+    {
+    public:
+        
+        MutableImageView();
+        MutableImageView(GLubyte* data, GLsizei width, GLsizei height,
+                         GLsizei bytesPerPixel, GLsizei rowLength = 0,
+                         GLsizei skipPixels = 0, GLsizei skipRows = 0);
+        
+        // A read-only view of the same region.
+        
+        operator        ImageView() const;
+        
+        GLubyte*        data() const;
+        GLsizei         width() const;
+        GLsizei         height() const;
+        GLsizei         bytesPerPixel() const;
+        GLsizei         rowLength() const;
+        GLsizei         skipPixels() const;
+        GLsizei         skipRows() const;
+        
+        size_t          stride() const;
+        GLubyte*        pixels() const;
+        GLubyte*        row(GLsizei y) const;
+        
+        bool            empty() const;
+        bool            isPacked() const;
+        
+        MutableImageView    region(GLsizei x, GLsizei y, GLsizei width,
+                                   GLsizei height) const;
+        
+    private:
+        
+        // The parameters are kept, and checked, by a read-only view.
+        
+        ImageView       _view;
+    };
+    
+}
+
+#endif
@@ -0,0 +1,201 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglPooledImage.cpp
+//
+
+#include "AglPooledImage.h"
+#include "AglImagePool.h"
+#include <utility>
+
+namespace Agl
+{
+    
+    PooledImage::PooledImage() :
+        _pool(nullptr), _image(nullptr)
+    {
+    }
+    
+    PooledImage::PooledImage(ImagePool& pool) :
+        _pool(&pool), _image(pool.alloc())
+    {
+    }
+    
+    PooledImage::PooledImage(ImagePool& pool, GLubyte* image) :
+        _pool(&pool), _image(image)
+    {
+    }
+    
+    PooledImage::PooledImage(PooledImage&& other) :
+        _pool(other._pool), _image(other.release())
+    {
+    }
+    
+    PooledImage& PooledImage::operator=(PooledImage&& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            _pool = other._pool;
+            _image = other.release();
+        }
+        return *this;
+    }
+    
+    PooledImage::~PooledImage()
+    {
+        reset();
+    }
+    
+    GLubyte* PooledImage::data() const
+    {
+        return _image;
+    }
+    
+    MutableImageView PooledImage::view() const
+    {
+        if (!_image)
+            return MutableImageView();
+        return MutableImageView(_image, _pool->imageWidth(),
+                                _pool->imageHeight(), _pool->bytesPerPixel());
+    }
+    
+    ImagePool* PooledImage::pool() const
+    {
+        return _pool;
+    }
+    
+    PooledImage::operator bool() const
+    {
+        return _image != nullptr;
+    }
+    
+    GLubyte* PooledImage::release()
+    {
+        GLubyte* result = _image;
+        _image = nullptr;
+        _pool = nullptr;
+        return result;
+    }
+    
+    void PooledImage::reset()
+    {
+        if (_image != nullptr)
+            _pool->free(_image);
+        _image = nullptr;
+        _pool = nullptr;
+    }
+    
+    SharedFrame::SharedFrame() :
+        _pool(nullptr), _image(nullptr)
+    {
+    }
+    
+    SharedFrame::SharedFrame(PooledImage&& image) :
+        _pool(image.pool()), _image(image.release())
+    {
+        if (_image != nullptr)
+            _pool->referenceCount(_image).store(1, std::memory_order_relaxed);
+    }
+    
+    SharedFrame::SharedFrame(const SharedFrame& other) :
+        _pool(other._pool), _image(other._image)
+    {
+        if (_image != nullptr)
+            _pool->referenceCount(_image).fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    SharedFrame::SharedFrame(SharedFrame&& other) :
+        _pool(other._pool), _image(other._image)
+    {
+        other._pool = nullptr;
+        other._image = nullptr;
+    }
+    
+    SharedFrame& SharedFrame::operator=(const SharedFrame& other)
+    {
+        SharedFrame copy(other);
+        std::swap(_pool, copy._pool);
+        std::swap(_image, copy._image);
+        return *this;
+    }
+    
+    SharedFrame& SharedFrame::operator=(SharedFrame&& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            std::swap(_pool, other._pool);
+            std::swap(_image, other._image);
+        }
+        return *this;
+    }
+    
+    SharedFrame::~SharedFrame()
+    {
+        reset();
+    }
+    
+    const GLubyte* SharedFrame::data() const
+    {
+        return _image;
+    }
+    
+    ImageView SharedFrame::view() const
+    {
+        if (!_image)
+            return ImageView();
+        return ImageView(_image, _pool->imageWidth(), _pool->imageHeight(),
+                         _pool->bytesPerPixel());
+    }
+    
+    ImagePool* SharedFrame::pool() const
+    {
+        return _pool;
+    }
+    
+    SharedFrame::operator bool() const
+    {
+        return _image != nullptr;
+    }
+    
+    size_t SharedFrame::useCount() const
+    {
+        if (_image == nullptr)
+            return 0;
+        return _pool->referenceCount(_image).load(std::memory_order_relaxed);
+    }
+    
+    void SharedFrame::reset()
+    {
+        // The last release must see every other handle's use of the image
+        // before the image can be reused, hence the acquire and release.
+        
+        if ((_image != nullptr) &&
+            (_pool->referenceCount(_image).fetch_sub(1, std::memory_order_acq_rel) == 1))
+            _pool->free(_image);
+        _image = nullptr;
+        _pool = nullptr;
+    }
+    
+}
@@ -0,0 +1,152 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglPooledImage.h
+//
+// Handles that return image memory to an Agl::ImagePool automatically.  An
+// Agl::PooledImage is the sole owner of an image, and can be moved but not
+// copied, so ownership is always clear as the image passes between threads.
+// An Agl::SharedFrame is made from a PooledImage when the image must go to
+// several consumers (e.g., a processing thread and a texture upload thread).
+// Copies of a SharedFrame refer to the same read-only image, without copying
+// its bytes, and the image returns to the pool when the last copy is
+// destroyed.  The reference count is kept in memory the pool reserves with the
+// image, so sharing allocates nothing.  Different handles may be used on
+// different threads at once.
+//
+
+#ifndef __AglPooledImage__
+#define __AglPooledImage__
+
+#include "AglImageView.h"
+#include <OpenGL/gl3.h>
+#include <stddef.h>
+
+namespace Agl
+{
+    class ImagePool;
+    
+    class PooledImage
+    {
+    public:
+        
+        // Create an empty handle.
+        
+        PooledImage();
+        
+        // Obtain image memory from the pool, as by ImagePool::alloc().
+        
+        explicit PooledImage(ImagePool& pool);
+        
+        // Take ownership of image memory already obtained from the pool (e.g.,
+        // returned by Agl::convertYuyvToRgba()).
+        
+        PooledImage(ImagePool& pool, GLubyte* image);
+        
+        PooledImage(PooledImage&& other);
+        PooledImage&    operator=(PooledImage&& other);
+        
+        // Return the image to the pool, if the handle is not empty.
+        
+        ~PooledImage();
+        
+        // Access the image memory and the pool it came from, which are null
+        // for an empty handle.
+        
+        GLubyte*        data() const;
+        ImagePool*      pool() const;
+        explicit        operator bool() const;
+        
+        // A view of the whole image, with the pool's dimensions, or an empty
+        // view for an empty handle.
+        
+        MutableImageView    view() const;
+        
+        // Give up ownership of the image without returning it to the pool,
+        // leaving the handle empty.
+        
+        GLubyte*        release();
+        
+        // Return the image to the pool now, leaving the handle empty.
+        
+        void            reset();
+        
+    private:
+        
+        PooledImage(const PooledImage&) = delete;
+        PooledImage&    operator=(const PooledImage&) = delete;
+        
+        ImagePool*      _pool;
+        GLubyte*        _image;
+    };
+    
+    class SharedFrame
+    {
+    public:
+        
+        // Create an empty handle.
+        
+        SharedFrame();
+        
+        // Take over the image of a PooledImage, leaving it empty.
+        
+        SharedFrame(PooledImage&& image);
+        
+        SharedFrame(const SharedFrame& other);
+        SharedFrame(SharedFrame&& other);
+        SharedFrame&    operator=(const SharedFrame& other);
+        SharedFrame&    operator=(SharedFrame&& other);
+        
+        // Return the image to the pool if this is the last handle to it.
+        
+        ~SharedFrame();
+        
+        // Access the image memory, which is read-only since others may be
+        // reading it, and the pool it came from.  Both are null for an empty
+        // handle.
+        
+        const GLubyte*  data() const;
+        ImagePool*      pool() const;
+        explicit        operator bool() const;
+        
+        // A read-only view of the whole image, or an empty view for an empty
+        // handle.
+        
+        ImageView       view() const;
+        
+        // The number of handles sharing the image, or 0 for an empty handle.
+        
+        size_t          useCount() const;
+        
+        // Release this handle's reference, leaving the handle empty.
+        
+        void            reset();
+        
+    private:
+        
+        ImagePool*      _pool;
+        GLubyte*        _image;
+    };
+}
+
+#endif
@@ -0,0 +1,97 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglRawVideoFormat.h
+//
+// The layout of the raw video files read by Agl::RawVideoSource.  A file has
+// a 64-byte file header, then a sequence of frame records, each a 64-byte
+// frame header followed by the image, padded to a multiple of 64 bytes.  All
+// the records have the same size, so frame n is at a fixed offset, and a
+// file can be written one frame at a time without knowing the number of
+// frames in advance.  The number of frames is implied by the file size (a
+// partial record at the end, e.g., from an interrupted recording, is
+// ignored).  The images are stored tightly packed (without row padding), and
+// the integers are little endian.
+//
+
+#ifndef __AglRawVideoFormat__
+#define __AglRawVideoFormat__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Agl
+{
+    
+    const char RawVideoMagic[8] = {'A', 'g', 'l', 'R', 'a', 'w', 'V', 'd'};
+    const uint32_t RawVideoVersion = 1;
+    const size_t RawVideoAlignment = 64;
+    
+    struct RawVideoFileHeader
+    {
+        char        magic[8];
+        uint32_t    version;
+        uint32_t    width;
+        uint32_t    height;
+        uint32_t    bytesPerPixel;
+        
+        // The size of this header (and thus the offset of the first frame
+        // record), and the size of each frame record, in bytes.
+        
+        uint64_t    headerSize;
+        uint64_t    frameStride;
+        uint8_t     reserved[24];
+    };
+    
+    struct RawVideoFrameHeader
+    {
+        // The capture time of the frame in nanoseconds, relative to any fixed
+        // point (e.g., the start of the recording).
+        
+        int64_t     timestamp;
+        
+        // The frame's number in the original sequence, which may skip values
+        // if frames were dropped while recording.
+        
+        uint64_t    sequence;
+        uint8_t     reserved[48];
+    };
+    
+    static_assert(sizeof(RawVideoFileHeader) == RawVideoAlignment,
+                  "raw video file header must be 64 bytes");
+    static_assert(sizeof(RawVideoFrameHeader) == RawVideoAlignment,
+                  "raw video frame header must be 64 bytes");
+    
+    // The size of a frame record for images of the specified size.
+    
+    inline uint64_t rawVideoFrameStride(uint32_t width, uint32_t height,
+                                        uint32_t bytesPerPixel)
+    {
+        uint64_t imageSize = uint64_t(width) * height * bytesPerPixel;
+        return sizeof(RawVideoFrameHeader) +
+               (imageSize + RawVideoAlignment - 1) / RawVideoAlignment * RawVideoAlignment;
+    }
+    
+}
+
+#endif
@@ -0,0 +1,548 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglRawVideoRecorder.cpp
+//
+
+#include "AglRawVideoRecorder.h"
+#include "AglImagePool.h"
+#include "AglRawVideoFormat.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace Agl
+{
+    
+    namespace
+    {
+        
+        // With O_DIRECT, writes must be aligned to (and multiples of) the
+        // file system's block size, which this covers for common file
+        // systems.
+        
+        const size_t DirectBlockSize = 4096;
+        const size_t StagingSize = 4 * 1024 * 1024;
+        
+        const GLubyte Padding[RawVideoAlignment] = {};
+        
+        double millisecondsSince(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+        
+    }
+    
+    class RawVideoRecorder::Imp
+    {
+    public:
+        Imp(const std::string& path, const Options& options);
+        ~Imp();
+        
+        struct Frame
+        {
+            PooledImage             image;
+            RawVideoFrameHeader     header;
+        };
+        
+        void                    writerLoop();
+        void                    writeFrames(std::vector<Frame>& frames);
+        void                    writeVectors(iovec* vectors, size_t count);
+        void                    appendStaging(const GLubyte* data, size_t size);
+        void                    writeStaging(size_t size);
+        void                    fail(const char* function);
+        void                    finish();
+        
+        std::string             path;
+        Options                 options;
+        RawVideoFileHeader      header;
+        size_t                  imageSize;
+        int                     fd;
+        
+        // With direct I/O, the frames are copied into an aligned staging
+        // buffer and written through a second descriptor at explicit offsets.
+        
+        int                     directFd;
+        GLubyte*                staging;
+        size_t                  stagingUsed;
+        uint64_t                directOffset;
+        
+        std::thread             writer;
+        
+        // Protects the remaining members.
+        
+        mutable std::mutex      mutex;
+        std::condition_variable queueChanged;
+        std::condition_variable spaceAvailable;
+        std::condition_variable written;
+        std::deque<Frame>       queue;
+        size_t                  writingCount;
+        uint64_t                nextSequence;
+        bool                    stopping;
+        bool                    closed;
+        std::string             error;
+        Stats                   stats;
+    };
+    
+    RawVideoRecorder::Imp::Imp(const std::string& p, const Options& o) :
+        path(p), options(o), imageSize(0), fd(-1), directFd(-1),
+        staging(nullptr), stagingUsed(0), directOffset(0), writingCount(0),
+        nextSequence(0), stopping(false), closed(false)
+    {
+    }
+    
+    RawVideoRecorder::Imp::~Imp()
+    {
+        if (fd != -1)
+            ::close(fd);
+        if (directFd != -1)
+            ::close(directFd);
+        ::free(staging);
+    }
+    
+    void RawVideoRecorder::Imp::fail(const char* function)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error.empty())
+        {
+            error = std::string("Agl::RawVideoRecorder: ") + function +
+                    "(\"" + path + "\") failed: " + strerror(errno);
+        }
+        spaceAvailable.notify_all();
+    }
+    
+    void RawVideoRecorder::Imp::writerLoop()
+    {
+        std::vector<Frame> frames;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queueChanged.wait(lock, [&]{ return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                
+                // Take everything queued, to write it all at once.
+                
+                while (!queue.empty())
+                {
+                    frames.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+                writingCount = frames.size();
+                spaceAvailable.notify_all();
+            }
+            
+            writeFrames(frames);
+            
+            // The images go back to their pool before the frames are counted
+            // as written, so a flush() leaves none outstanding.
+            
+            size_t count = frames.size();
+            frames.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                writingCount = 0;
+                if (error.empty())
+                    stats.writtenCount += count;
+                written.notify_all();
+            }
+        }
+    }
+    
+    void RawVideoRecorder::Imp::writeFrames(std::vector<Frame>& frames)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error.empty())
+                return;
+        }
+        
+        size_t paddingSize = header.frameStride - sizeof(RawVideoFrameHeader) -
+                             imageSize;
+        if (staging != nullptr)
+        {
+            for (Frame& frame : frames)
+            {
+                appendStaging(reinterpret_cast<const GLubyte*>(&frame.header),
+                              sizeof(frame.header));
+                appendStaging(frame.image.data(), imageSize);
+                appendStaging(Padding, paddingSize);
+            }
+            
+            // Write the whole blocks now, keeping the rest for next time.
+            
+            writeStaging(stagingUsed / DirectBlockSize * DirectBlockSize);
+            return;
+        }
+        
+        // Each frame's header, image and padding go straight from where they
+        // are, with one system call for all the frames.
+        
+        std::vector<iovec> vectors;
+        for (Frame& frame : frames)
+        {
+            vectors.push_back({&frame.header, sizeof(frame.header)});
+            vectors.push_back({frame.image.data(), imageSize});
+            if (paddingSize > 0)
+                vectors.push_back({const_cast<GLubyte*>(Padding), paddingSize});
+        }
+        
+        // Systems limit the vectors per call (to at least 16).
+        
+        const size_t maxVectors = 1020;
+        for (size_t i = 0; i < vectors.size(); i += maxVectors)
+            writeVectors(&vectors[i], std::min(maxVectors, vectors.size() - i));
+    }
+    
+    void RawVideoRecorder::Imp::writeVectors(iovec* vectors, size_t count)
+    {
+        while (count > 0)
+        {
+            auto start = std::chrono::steady_clock::now();
+            ssize_t result = writev(fd, vectors, int(count));
+            double milliseconds = millisecondsSince(start);
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                fail("writev");
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stats.bytesWritten += uint64_t(result);
+                ++stats.writeCount;
+                stats.writeMilliseconds += milliseconds;
+            }
+            
+            // Skip what was written, which may end within a vector.
+            
+            size_t remaining = size_t(result);
+            while ((count > 0) && (remaining >= vectors->iov_len))
+            {
+                remaining -= vectors->iov_len;
+                ++vectors;
+                --count;
+            }
+            if (count > 0)
+            {
+                vectors->iov_base = static_cast<char*>(vectors->iov_base) + remaining;
+                vectors->iov_len -= remaining;
+            }
+        }
+    }
+    
+    void RawVideoRecorder::Imp::appendStaging(const GLubyte* data, size_t size)
+    {
+        while (size > 0)
+        {
+            size_t n = std::min(size, StagingSize - stagingUsed);
+            memcpy(staging + stagingUsed, data, n);
+            stagingUsed += n;
+            data += n;
+            size -= n;
+            if (stagingUsed == StagingSize)
+                writeStaging(StagingSize);
+        }
+    }
+    
+    void RawVideoRecorder::Imp::writeStaging(size_t size)
+    {
+        size_t done = 0;
+        while (done < size)
+        {
+            auto start = std::chrono::steady_clock::now();
+            ssize_t result = pwrite(directFd, staging + done, size - done,
+                                    off_t(directOffset + done));
+            double milliseconds = millisecondsSince(start);
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                fail("pwrite");
+                break;
+            }
+            done += size_t(result);
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.bytesWritten += uint64_t(result);
+            ++stats.writeCount;
+            stats.writeMilliseconds += milliseconds;
+        }
+        
+        // The unwritten part moves to the start, still block aligned in the
+        // file since size is a multiple of the block size.
+        
+        directOffset += size;
+        stagingUsed -= size;
+        memmove(staging, staging + size, stagingUsed);
+    }
+    
+    void RawVideoRecorder::Imp::finish()
+    {
+        // The last partial block of a direct recording is written through
+        // the ordinary descriptor, which has no alignment requirements.
+        
+        if ((staging != nullptr) && (stagingUsed > 0))
+        {
+            if (pwrite(fd, staging, stagingUsed, off_t(directOffset)) !=
+                ssize_t(stagingUsed))
+            {
+                fail("pwrite");
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stats.bytesWritten += stagingUsed;
+            }
+            directOffset += stagingUsed;
+            stagingUsed = 0;
+        }
+        
+        // Remove any preallocated space beyond the frames written.
+        
+        uint64_t writtenCount;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            writtenCount = stats.writtenCount;
+        }
+        uint64_t size = header.headerSize + writtenCount * header.frameStride;
+        if (ftruncate(fd, off_t(size)) != 0)
+            fail("ftruncate");
+    }
+    
+    RawVideoRecorder::Options::Options() :
+        queueDepth(8), blockWhenFull(false), preallocateFrameCount(0),
+        directIo(false)
+    {
+    }
+    
+    RawVideoRecorder::Stats::Stats() :
+        submittedCount(0), writtenCount(0), droppedCount(0), blockedCount(0),
+        blockedMilliseconds(0), queuedCount(0), highWaterQueuedCount(0),
+        bytesWritten(0), writeCount(0), writeMilliseconds(0)
+    {
+    }
+    
+    RawVideoRecorder::RawVideoRecorder(const std::string& path, GLsizei width,
+                                       GLsizei height, GLsizei bytesPerPixel,
+                                       const Options& options) :
+        _m(new Imp(path, options))
+    {
+        if ((width <= 0) || (height <= 0) || (bytesPerPixel <= 0) ||
+            (options.queueDepth == 0))
+        {
+            throw std::invalid_argument("Agl::RawVideoRecorder(): the frame "
+                                        "size and queue depth must be positive");
+        }
+        
+        RawVideoFileHeader& h = _m->header;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, RawVideoMagic, sizeof(h.magic));
+        h.version = RawVideoVersion;
+        h.width = uint32_t(width);
+        h.height = uint32_t(height);
+        h.bytesPerPixel = uint32_t(bytesPerPixel);
+        h.headerSize = sizeof(h);
+        h.frameStride = rawVideoFrameStride(h.width, h.height, h.bytesPerPixel);
+        _m->imageSize = size_t(width) * height * bytesPerPixel;
+        
+        _m->fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (_m->fd == -1)
+        {
+            throw std::runtime_error("Agl::RawVideoRecorder(): cannot create \"" +
+                                     path + "\": " + strerror(errno));
+        }
+        
+        if (options.preallocateFrameCount > 0)
+        {
+            off_t size = off_t(h.headerSize +
+                               options.preallocateFrameCount * h.frameStride);
+#if defined(__APPLE__)
+            fstore_t store = {F_ALLOCATEALL, F_PEOFPOSMODE, 0, size, 0};
+            fcntl(_m->fd, F_PREALLOCATE, &store);
+#else
+            posix_fallocate(_m->fd, 0, size);
+#endif
+        }
+        
+        if (options.directIo)
+        {
+#if defined(O_DIRECT)
+            _m->directFd = open(path.c_str(), O_WRONLY | O_DIRECT);
+            void* memory = nullptr;
+            if ((_m->directFd != -1) &&
+                (posix_memalign(&memory, DirectBlockSize, StagingSize) == 0))
+            {
+                _m->staging = static_cast<GLubyte*>(memory);
+            }
+            else if (_m->directFd != -1)
+            {
+                ::close(_m->directFd);
+                _m->directFd = -1;
+            }
+#elif defined(F_NOCACHE)
+            fcntl(_m->fd, F_NOCACHE, 1);
+#endif
+        }
+        
+        if (_m->staging != nullptr)
+        {
+            _m->appendStaging(reinterpret_cast<const GLubyte*>(&h), sizeof(h));
+        }
+        else if (write(_m->fd, &h, sizeof(h)) != ssize_t(sizeof(h)))
+        {
+            throw std::runtime_error("Agl::RawVideoRecorder(): cannot write \"" +
+                                     path + "\": " + strerror(errno));
+        }
+        
+        _m->writer = std::thread(&Imp::writerLoop, _m.get());
+    }
+    
+    RawVideoRecorder::~RawVideoRecorder()
+    {
+        try
+        {
+            close();
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
+    
+    bool RawVideoRecorder::submit(PooledImage&& image, int64_t timestamp)
+    {
+        ImagePool* pool = image.pool();
+        if ((pool == nullptr) ||
+            (size_t(pool->imageWidth()) != _m->header.width) ||
+            (size_t(pool->imageHeight()) != _m->header.height) ||
+            (size_t(pool->bytesPerPixel()) != _m->header.bytesPerPixel))
+        {
+            throw std::invalid_argument("Agl::RawVideoRecorder::submit(): the "
+                                        "image size does not match");
+        }
+        
+        std::unique_lock<std::mutex> lock(_m->mutex);
+        if (!_m->error.empty())
+            throw std::runtime_error(_m->error);
+        if (_m->stopping)
+        {
+            throw std::runtime_error("Agl::RawVideoRecorder::submit(): the "
+                                     "recorder is closed");
+        }
+        
+        Stats& stats = _m->stats;
+        ++stats.submittedCount;
+        uint64_t sequence = _m->nextSequence++;
+        
+        if (_m->queue.size() >= _m->options.queueDepth)
+        {
+            if (!_m->options.blockWhenFull)
+            {
+                ++stats.droppedCount;
+                return false;
+            }
+            
+            auto start = std::chrono::steady_clock::now();
+            _m->spaceAvailable.wait(lock, [&]
+            {
+                return (_m->queue.size() < _m->options.queueDepth) ||
+                       !_m->error.empty();
+            });
+            ++stats.blockedCount;
+            stats.blockedMilliseconds += millisecondsSince(start);
+            if (!_m->error.empty())
+                throw std::runtime_error(_m->error);
+        }
+        
+        Imp::Frame frame;
+        memset(&frame.header, 0, sizeof(frame.header));
+        frame.header.timestamp = timestamp;
+        frame.header.sequence = sequence;
+        frame.image = std::move(image);
+        _m->queue.push_back(std::move(frame));
+        stats.highWaterQueuedCount = std::max(stats.highWaterQueuedCount,
+                                              _m->queue.size());
+        _m->queueChanged.notify_one();
+        return true;
+    }
+    
+    bool RawVideoRecorder::submit(PooledImage&& image)
+    {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        return submit(std::move(image), now);
+    }
+    
+    void RawVideoRecorder::flush()
+    {
+        std::unique_lock<std::mutex> lock(_m->mutex);
+        _m->written.wait(lock, [&]
+        {
+            return _m->queue.empty() && (_m->writingCount == 0);
+        });
+    }
+    
+    void RawVideoRecorder::close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_m->mutex);
+            if (_m->closed)
+                return;
+            _m->closed = true;
+            _m->stopping = true;
+            _m->queueChanged.notify_all();
+        }
+        _m->writer.join();
+        _m->finish();
+        
+        ::close(_m->fd);
+        _m->fd = -1;
+        
+        std::lock_guard<std::mutex> lock(_m->mutex);
+        if (!_m->error.empty())
+            throw std::runtime_error(_m->error);
+    }
+    
+    RawVideoRecorder::Stats RawVideoRecorder::stats() const
+    {
+        std::lock_guard<std::mutex> lock(_m->mutex);
+        Stats result = _m->stats;
+        result.queuedCount = _m->queue.size();
+        return result;
+    }
+    
+}
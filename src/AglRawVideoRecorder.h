@@ -0,0 +1,160 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglRawVideoRecorder.h
+//
+// A class to record frames to a file (in the format described in
+// AglRawVideoFormat.h, so Agl::RawVideoSource can replay it) without slowing
+// down the thread producing or consuming the frames.  Frames are handed over
+// as Agl::PooledImage instances and queued for a background writer thread,
+// which writes several queued frames with each system call, straight from
+// the images, and then returns the images to their pool.  If the writer
+// falls behind and the queue is full, new frames are either refused (the
+// default, so the caller never waits) or the caller waits for room.
+// Statistics report how often that happens.
+//
+
+#ifndef __AglRawVideoRecorder__
+#define __AglRawVideoRecorder__
+
+#include "AglPooledImage.h"
+#include <OpenGL/gl3.h>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+namespace Agl
+{
+    class RawVideoRecorder
+    {
+    public:
+        
+        struct Options
+        {
+            Options();
+            
+            // The most frames waiting to be written (default 8).
+            
+            size_t  queueDepth;
+            
+            // Whether submit() waits for room when the queue is full, rather
+            // than refusing the frame (the default).
+            
+            bool    blockWhenFull;
+            
+            // The number of frames for which to reserve disk space when the
+            // file is created, so the file system need not extend the file as
+            // it grows.  Any unused space is removed by close().
+            
+            size_t  preallocateFrameCount;
+            
+            // Whether to bypass the operating system's file cache (O_DIRECT
+            // on Linux, F_NOCACHE on OS X), so recording does not evict other
+            // data from memory.  The writer then copies frames into an
+            // aligned buffer and writes in multiples of the block size.  If
+            // the file system does not support it, the file cache is used.
+            
+            bool    directIo;
+        };
+        
+        // Create (or replace) the file and start the writer thread.  The
+        // frames must have the specified size.  If the file cannot be
+        // created, a std::runtime_error exception is thrown.
+        
+        RawVideoRecorder(const std::string& path, GLsizei width,
+                         GLsizei height, GLsizei bytesPerPixel,
+                         const Options& options = Options());
+        
+        // Close the recording, as by close(), but without throwing.
+        
+        ~RawVideoRecorder();
+        
+        // Queue a frame to be written, with a timestamp in nanoseconds (or
+        // the current time of std::chrono::steady_clock).  Returns true if
+        // the frame was queued, taking the image from the handle, or false if
+        // the queue was full, leaving the image in the handle.  Each frame
+        // gets the next sequence number, whether it is queued or not, so
+        // refused frames show as gaps in the recording.  If the image is not
+        // of the recorder's size, a std::invalid_argument exception is thrown,
+        // and if an earlier write failed, a std::runtime_error exception is
+        // thrown.
+        
+        bool    submit(PooledImage&& image, int64_t timestamp);
+        bool    submit(PooledImage&& image);
+        
+        // Wait until every queued frame has been written (except that with
+        // direct I/O, the last partial block is written by close()).
+        
+        void    flush();
+        
+        // Write the remaining frames, stop the writer thread and close the
+        // file.  If any write failed, a std::runtime_error exception is
+        // thrown.  Calling this routine again has no effect.
+        
+        void    close();
+        
+        struct Stats
+        {
+            Stats();
+            
+            // The frames passed to submit(), written, and refused because
+            // the queue was full.
+            
+            uint64_t    submittedCount;
+            uint64_t    writtenCount;
+            uint64_t    droppedCount;
+            
+            // The calls to submit() that waited for room (with blockWhenFull)
+            // and the total time they waited.
+            
+            uint64_t    blockedCount;
+            double      blockedMilliseconds;
+            
+            // The frames now queued, and the most that have been queued.
+            
+            size_t      queuedCount;
+            size_t      highWaterQueuedCount;
+            
+            // The bytes written, the write system calls, and the total time
+            // spent in them.
+            
+            uint64_t    bytesWritten;
+            uint64_t    writeCount;
+            double      writeMilliseconds;
+        };
+        
+        Stats   stats() const;
+        
+    private:
+        
+        RawVideoRecorder(const RawVideoRecorder&) = delete;
+        RawVideoRecorder&   operator=(const RawVideoRecorder&) = delete;
+        
+        // Details of the class' data are hidden in the .cpp file.
+        
+        class Imp;
+        std::unique_ptr<Imp> _m;
+    };
+}
+
+#endif
@@ -0,0 +1,347 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglRawVideoSource.cpp
+//
+
+#include "AglRawVideoSource.h"
+#include "AglImagePool.h"
+#include "AglRawVideoFormat.h"
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace Agl
+{
+    
+    class RawVideoSource::Imp
+    {
+    public:
+        Imp();
+        ~Imp();
+        
+        void                    advise(size_t firstFrame, size_t frameCount,
+                                       int advice) const;
+        
+        std::string             path;
+        int                     fd;
+        void*                   memory;
+        size_t                  size;
+        
+        RawVideoFileHeader      header;
+        size_t                  frameCount;
+        
+        GLsizei                 regionX;
+        GLsizei                 regionY;
+        GLsizei                 regionWidth;
+        GLsizei                 regionHeight;
+        
+        Pacing                  pacing;
+        bool                    looping;
+        size_t                  readahead;
+        size_t                  position;
+        
+        // For real-time pacing, the time at which playback started and the
+        // timestamp of the first frame served.  The clock is not running
+        // until the first call to next() after opening or seeking.
+        
+        bool                    clockRunning;
+        std::chrono::steady_clock::time_point   startTime;
+        int64_t                 startTimestamp;
+    };
+    
+    RawVideoSource::Imp::Imp() :
+        fd(-1), memory(MAP_FAILED), size(0), frameCount(0), regionX(0),
+        regionY(0), regionWidth(0), regionHeight(0), pacing(AsFastAsPossible),
+        looping(false), readahead(4), position(0), clockRunning(false),
+        startTimestamp(0)
+    {
+    }
+    
+    RawVideoSource::Imp::~Imp()
+    {
+        if (memory != MAP_FAILED)
+            munmap(memory, size);
+        if (fd != -1)
+            close(fd);
+    }
+    
+    void RawVideoSource::Imp::advise(size_t firstFrame, size_t count,
+                                     int advice) const
+    {
+        if (firstFrame >= frameCount)
+            return;
+        count = std::min(count, frameCount - firstFrame);
+        
+        // The range must start on a page boundary.
+        
+        size_t begin = header.headerSize + firstFrame * header.frameStride;
+        size_t end = begin + count * header.frameStride;
+        size_t pageBegin = begin / ImagePool::pageSize() * ImagePool::pageSize();
+        madvise(static_cast<char*>(memory) + pageBegin, end - pageBegin, advice);
+    }
+    
+    RawVideoFrame::RawVideoFrame() :
+        data(nullptr), width(0), height(0), bytesPerPixel(0), rowLength(0),
+        skipPixels(0), skipRows(0), index(0), sequence(0), timestamp(0)
+    {
+    }
+    
+    MutableImageView RawVideoFrame::view() const
+    {
+        return MutableImageView(data, width, height, bytesPerPixel, rowLength,
+                                skipPixels, skipRows);
+    }
+    
+    RawVideoSource::RawVideoSource(const std::string& path) :
+        _m(new Imp)
+    {
+        _m->path = path;
+        _m->fd = open(path.c_str(), O_RDONLY);
+        if (_m->fd == -1)
+        {
+            throw std::runtime_error("Agl::RawVideoSource(): cannot open \"" +
+                                     path + "\": " + strerror(errno));
+        }
+        
+        struct stat status;
+        if ((fstat(_m->fd, &status) != 0) ||
+            (size_t(status.st_size) < sizeof(RawVideoFileHeader)))
+        {
+            throw std::runtime_error("Agl::RawVideoSource(): \"" + path +
+                                     "\" is not a raw video file");
+        }
+        _m->size = size_t(status.st_size);
+        
+        // A private, writable mapping lets the frames be used where non-const
+        // data is expected, without any risk of changing the file.
+        
+        _m->memory = mmap(nullptr, _m->size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE, _m->fd, 0);
+        if (_m->memory == MAP_FAILED)
+        {
+            throw std::runtime_error("Agl::RawVideoSource(): cannot map \"" +
+                                     path + "\": " + strerror(errno));
+        }
+        
+        memcpy(&_m->header, _m->memory, sizeof(RawVideoFileHeader));
+        const RawVideoFileHeader& h = _m->header;
+        if ((memcmp(h.magic, RawVideoMagic, sizeof(RawVideoMagic)) != 0) ||
+            (h.version != RawVideoVersion) ||
+            (h.headerSize < sizeof(RawVideoFileHeader)) ||
+            (h.headerSize > _m->size) || (h.width == 0) || (h.height == 0) ||
+            (h.bytesPerPixel == 0) ||
+            (h.frameStride < rawVideoFrameStride(h.width, h.height, h.bytesPerPixel)))
+        {
+            throw std::runtime_error("Agl::RawVideoSource(): \"" + path +
+                                     "\" is not a raw video file");
+        }
+        
+        _m->frameCount = (_m->size - h.headerSize) / h.frameStride;
+        _m->regionWidth = GLsizei(h.width);
+        _m->regionHeight = GLsizei(h.height);
+        
+#if defined(MADV_SEQUENTIAL)
+        madvise(_m->memory, _m->size, MADV_SEQUENTIAL);
+#endif
+    }
+    
+    RawVideoSource::~RawVideoSource()
+    {
+    }
+    
+    GLsizei RawVideoSource::width() const
+    {
+        return GLsizei(_m->header.width);
+    }
+    
+    GLsizei RawVideoSource::height() const
+    {
+        return GLsizei(_m->header.height);
+    }
+    
+    GLsizei RawVideoSource::bytesPerPixel() const
+    {
+        return GLsizei(_m->header.bytesPerPixel);
+    }
+    
+    size_t RawVideoSource::frameCount() const
+    {
+        return _m->frameCount;
+    }
+    
+    void RawVideoSource::setRegion(GLsizei x, GLsizei y, GLsizei width,
+                                   GLsizei height)
+    {
+        if ((x < 0) || (y < 0) || (width <= 0) || (height <= 0) ||
+            (x + width > this->width()) || (y + height > this->height()))
+        {
+            throw std::invalid_argument("Agl::RawVideoSource::setRegion(): the "
+                                        "region is not within the frames");
+        }
+        _m->regionX = x;
+        _m->regionY = y;
+        _m->regionWidth = width;
+        _m->regionHeight = height;
+    }
+    
+    void RawVideoSource::setPacing(Pacing pacing)
+    {
+        _m->pacing = pacing;
+        _m->clockRunning = false;
+    }
+    
+    RawVideoSource::Pacing RawVideoSource::pacing() const
+    {
+        return _m->pacing;
+    }
+    
+    void RawVideoSource::setLooping(bool looping)
+    {
+        _m->looping = looping;
+    }
+    
+    bool RawVideoSource::looping() const
+    {
+        return _m->looping;
+    }
+    
+    void RawVideoSource::setReadahead(size_t frameCount)
+    {
+        _m->readahead = frameCount;
+    }
+    
+    RawVideoFrame RawVideoSource::frame(size_t index) const
+    {
+        if (index >= _m->frameCount)
+        {
+            throw std::out_of_range("Agl::RawVideoSource::frame(): the index "
+                                    "is not less than frameCount()");
+        }
+        
+        GLubyte* record = static_cast<GLubyte*>(_m->memory) +
+                          _m->header.headerSize + index * _m->header.frameStride;
+        RawVideoFrameHeader frameHeader;
+        memcpy(&frameHeader, record, sizeof(frameHeader));
+        
+        RawVideoFrame result;
+        result.data = record + sizeof(RawVideoFrameHeader);
+        result.width = _m->regionWidth;
+        result.height = _m->regionHeight;
+        result.bytesPerPixel = bytesPerPixel();
+        
+        // Like the GL unpack parameters, a row length of 0 means the width,
+        // which is the case when the region is the whole frame.
+        
+        bool whole = (_m->regionWidth == width()) && (_m->regionHeight == height());
+        result.rowLength = whole ? 0 : width();
+        result.skipPixels = _m->regionX;
+        result.skipRows = _m->regionY;
+        result.index = index;
+        result.sequence = frameHeader.sequence;
+        result.timestamp = frameHeader.timestamp;
+        return result;
+    }
+    
+    bool RawVideoSource::next(RawVideoFrame& frame)
+    {
+        if (_m->position >= _m->frameCount)
+        {
+            if (!_m->looping || (_m->frameCount == 0))
+                return false;
+            seek(0);
+        }
+        
+        frame = this->frame(_m->position);
+        
+        // Only the frame at the far end of the readahead window is new to
+        // the advice, except at the start.
+        
+#if defined(MADV_WILLNEED)
+        if (_m->readahead > 0)
+        {
+            if (!_m->clockRunning || (_m->position == 0))
+                _m->advise(_m->position, _m->readahead + 1, MADV_WILLNEED);
+            else
+                _m->advise(_m->position + _m->readahead, 1, MADV_WILLNEED);
+        }
+#endif
+        
+        if (_m->pacing == RealTime)
+        {
+            if (!_m->clockRunning)
+            {
+                _m->startTime = std::chrono::steady_clock::now();
+                _m->startTimestamp = frame.timestamp;
+            }
+            else
+            {
+                std::chrono::nanoseconds offset(frame.timestamp - _m->startTimestamp);
+                std::this_thread::sleep_until(_m->startTime + offset);
+            }
+        }
+        _m->clockRunning = true;
+        
+        ++_m->position;
+        return true;
+    }
+    
+    void RawVideoSource::seek(size_t index)
+    {
+        _m->position = index;
+        _m->clockRunning = false;
+    }
+    
+    GLubyte* RawVideoSource::copyFrame(ImagePool& pool,
+                                       const RawVideoFrame& frame) const
+    {
+        if ((pool.imageWidth() != frame.width) ||
+            (pool.imageHeight() != frame.height) ||
+            (pool.bytesPerPixel() != frame.bytesPerPixel))
+        {
+            throw std::invalid_argument("Agl::RawVideoSource::copyFrame(): the "
+                                        "pool's image size does not match");
+        }
+        
+        GLubyte* result = pool.alloc();
+        size_t rowLength = (frame.rowLength != 0) ? frame.rowLength : frame.width;
+        size_t rowBytes = size_t(frame.width) * frame.bytesPerPixel;
+        const GLubyte* src = frame.data +
+                             (frame.skipRows * rowLength + frame.skipPixels) *
+                             frame.bytesPerPixel;
+        for (GLsizei y = 0; y < frame.height; ++y)
+        {
+            memcpy(result + y * rowBytes, src, rowBytes);
+            src += rowLength * frame.bytesPerPixel;
+        }
+        return result;
+    }
+    
+}
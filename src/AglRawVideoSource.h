@@ -0,0 +1,159 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglRawVideoSource.h
+//
+// A class to replay a recorded sequence of frames (in the format described in
+// AglRawVideoFormat.h), for benchmarking and testing an image pipeline
+// without a camera.  The file is memory mapped, so frames are served without
+// copying, as views that can be passed directly to Agl::reduceImageBy2() and
+// Agl::TextureUbyte::setData(), optionally restricted to a region of each
+// frame.  The operating system is advised to read ahead of the frame being
+// served.  Playback can run as fast as possible, or paced by the frames'
+// timestamps to mimic a live camera.
+//
+
+#ifndef __AglRawVideoSource__
+#define __AglRawVideoSource__
+
+#include "AglImageView.h"
+#include <OpenGL/gl3.h>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+namespace Agl
+{
+    class ImagePool;
+    
+    // A view of one frame.  The width, height, rowLength, skipPixels and
+    // skipRows have the same meanings as the arguments of reduceImageBy2()
+    // and TextureUbyte::setData(), describing the region of the frame to use.
+    // The data remains valid as long as the RawVideoSource exists.  Writing
+    // to the data changes only this process's copy of the page, not the file.
+    
+    struct RawVideoFrame
+    {
+        RawVideoFrame();
+        
+        // The region of the frame as a view, for passing to the image
+        // utilities.
+        
+        MutableImageView    view() const;
+        
+        GLubyte*    data;
+        GLsizei     width;
+        GLsizei     height;
+        GLsizei     bytesPerPixel;
+        GLsizei     rowLength;
+        GLsizei     skipPixels;
+        GLsizei     skipRows;
+        
+        // The frame's position in the file, its recorded sequence number,
+        // and its timestamp in nanoseconds.
+        
+        size_t      index;
+        uint64_t    sequence;
+        int64_t     timestamp;
+    };
+    
+    class RawVideoSource
+    {
+    public:
+        
+        // Open and map the file.  If the file cannot be opened, or is not a
+        // raw video file, a std::runtime_error exception is thrown.
+        
+        explicit RawVideoSource(const std::string& path);
+        ~RawVideoSource();
+        
+        // The dimensions of the frames in the file, and the number of frames.
+        
+        GLsizei     width() const;
+        GLsizei     height() const;
+        GLsizei     bytesPerPixel() const;
+        size_t      frameCount() const;
+        
+        // Restrict the frames served to a region, or pass the full width and
+        // height to serve the whole frames (the default).  If the region is
+        // not within the frames, a std::invalid_argument exception is thrown.
+        
+        void        setRegion(GLsizei x, GLsizei y, GLsizei width, GLsizei height);
+        
+        // How next() paces the frames: as fast as possible (the default), or
+        // in real time, waiting until each frame's timestamp (relative to the
+        // first frame served) has elapsed since playback started.
+        
+        enum Pacing
+        {
+            AsFastAsPossible,
+            RealTime
+        };
+        
+        void        setPacing(Pacing pacing);
+        Pacing      pacing() const;
+        
+        // Whether next() starts over at the first frame after the last one.
+        
+        void        setLooping(bool looping);
+        bool        looping() const;
+        
+        // How many frames ahead of the one served next() advises the
+        // operating system to read (default 4).
+        
+        void        setReadahead(size_t frameCount);
+        
+        // Get the view of a frame, without affecting playback.  If index is
+        // not less than frameCount(), a std::out_of_range exception is thrown.
+        
+        RawVideoFrame   frame(size_t index) const;
+        
+        // Get the next frame of playback, waiting first if the pacing is real
+        // time.  Returns false at the end, if not looping.
+        
+        bool        next(RawVideoFrame& frame);
+        
+        // Restart playback at the specified frame.  The clock for real-time
+        // pacing restarts at the next call to next().
+        
+        void        seek(size_t index);
+        
+        // Copy a frame's region into memory from the pool, whose images must
+        // have the size of the region, and return the copy.  If the size does
+        // not match, a std::invalid_argument exception is thrown.
+        
+        GLubyte*    copyFrame(ImagePool& pool, const RawVideoFrame& frame) const;
+        
+    private:
+        
+        RawVideoSource(const RawVideoSource&) = delete;
+        RawVideoSource& operator=(const RawVideoSource&) = delete;
+        
+        // Details of the class' data are hidden in the .cpp file.
+        
+        class Imp;
+        std::unique_ptr<Imp> _m;
+    };
+}
+
+#endif
@@ -0,0 +1,597 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglSharedMemoryImagePool.cpp
+//
+
+#include "AglSharedMemoryImagePool.h"
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits>
+#include <new>
+#include <signal.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace Agl
+{
+    
+    namespace
+    {
+        
+        // Atomics in shared memory work across processes only if they are
+        // lock free (and thus do not refer to a lock in one process).
+        
+        static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+                      "64-bit atomics must be lock free in shared memory");
+        static_assert(ATOMIC_INT_LOCK_FREE == 2,
+                      "32-bit atomics must be lock free in shared memory");
+        
+        const uint32_t Magic = 0x41676c53; // "AglS"
+        const uint32_t Version = 3;
+        const size_t CacheLine = 64;
+        
+        // The segment starts with this header, followed by the free list's
+        // links (one per image), the ring's cells, and then the images.  The
+        // counters that different processes update are on separate cache
+        // lines.
+        
+        struct Segment
+        {
+            uint32_t                magic;
+            uint32_t                version;
+            int32_t                 width;
+            int32_t                 height;
+            int32_t                 bytesPerPixel;
+            uint32_t                imageCount;
+            uint32_t                ringDepth;
+            uint64_t                imageStride;
+            uint64_t                imagesOffset;
+            uint64_t                segmentSize;
+            int32_t                 creatorPid;
+            std::atomic<uint32_t>   ready;
+            
+            alignas(CacheLine) std::atomic<uint64_t> freeList;
+            alignas(CacheLine) std::atomic<uint64_t> pushPosition;
+            alignas(CacheLine) std::atomic<uint64_t> popPosition;
+            alignas(CacheLine) std::atomic<uint64_t> droppedCount;
+        };
+        
+        struct Cell
+        {
+            std::atomic<uint64_t>   sequence;
+            uint32_t                index;
+        };
+        
+        // The free list is a stack whose head holds a tag in the high 32 bits
+        // and one plus the top image's index in the low 32 bits, as in
+        // Agl::ImagePool.
+        
+        const uint64_t IndexMask = 0xffffffff;
+        const uint64_t TagIncrement = uint64_t(1) << 32;
+        
+        size_t roundUp(size_t value, size_t multiple)
+        {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+        
+        size_t linksOffset()
+        {
+            return roundUp(sizeof(Segment), CacheLine);
+        }
+        
+        size_t cellsOffset(size_t imageCount)
+        {
+            return roundUp(linksOffset() + imageCount * sizeof(std::atomic<uint32_t>),
+                           CacheLine);
+        }
+        
+        std::string errorMessage(const char* function, const std::string& name)
+        {
+            return std::string("Agl::SharedMemoryImagePool(): ") + function +
+                   "(\"" + name + "\") failed: " + strerror(errno);
+        }
+        
+        // Whether the segment with the name was left behind by a creator
+        // that exited without destroying it (e.g., by crashing), as shown by
+        // its creator's process no longer existing.  A segment from an older
+        // version, or one not yet initialized, is not considered stale, since
+        // its creator cannot be identified.
+        
+        bool isStale(const std::string& name)
+        {
+            int fd = shm_open(name.c_str(), O_RDONLY, 0600);
+            if (fd == -1)
+                return false;
+            
+            bool stale = false;
+            struct stat status;
+            if ((fstat(fd, &status) == 0) &&
+                (size_t(status.st_size) >= sizeof(Segment)))
+            {
+                void* memory = mmap(nullptr, sizeof(Segment), PROT_READ,
+                                    MAP_SHARED, fd, 0);
+                if (memory != MAP_FAILED)
+                {
+                    const Segment* segment = static_cast<const Segment*>(memory);
+                    if ((segment->ready.load(std::memory_order_acquire) != 0) &&
+                        (segment->magic == Magic) &&
+                        (segment->version == Version) &&
+                        (segment->creatorPid > 0) &&
+                        (kill(pid_t(segment->creatorPid), 0) == -1) &&
+                        (errno == ESRCH))
+                        stale = true;
+                    munmap(memory, sizeof(Segment));
+                }
+            }
+            close(fd);
+            return stale;
+        }
+        
+        // The product of the sizes, or 0 if it overflows.
+        
+        size_t checkedProduct(size_t a, size_t b)
+        {
+            if ((a != 0) && (b > std::numeric_limits<size_t>::max() / a))
+                return 0;
+            return a * b;
+        }
+        
+    }
+    
+    class SharedMemoryImagePool::Imp
+    {
+    public:
+        Imp(const std::string& name, bool creator);
+        ~Imp();
+        
+        void                    map(size_t size);
+        void                    push(uint32_t index);
+        bool                    pop(uint32_t& index);
+        
+        // The outcomes of tryPublish(), as for Agl::FrameChannel.  Busy means
+        // the cell for the next frame has been claimed by a consumer that has
+        // not yet published it as empty.
+        
+        enum PublishResult { Published, Full, Busy };
+        
+        PublishResult           tryPublish(uint32_t index);
+        bool                    tryReceive(uint32_t& index);
+        GLubyte*                image(uint32_t index) const;
+        uint32_t                index(const GLubyte* image,
+                                      const char* function) const;
+        
+        std::string             name;
+        bool                    creator;
+        int                     fd;
+        void*                   memory;
+        size_t                  size;
+        
+        Segment*                segment;
+        std::atomic<uint32_t>*  links;
+        Cell*                   cells;
+        GLubyte*                images;
+    };
+    
+    SharedMemoryImagePool::Imp::Imp(const std::string& n, bool c) :
+        name(n), creator(c), fd(-1), memory(MAP_FAILED), size(0),
+        segment(nullptr), links(nullptr), cells(nullptr), images(nullptr)
+    {
+    }
+    
+    SharedMemoryImagePool::Imp::~Imp()
+    {
+        if (memory != MAP_FAILED)
+            munmap(memory, size);
+        if (fd != -1)
+            close(fd);
+        if (creator)
+            shm_unlink(name.c_str());
+    }
+    
+    void SharedMemoryImagePool::Imp::map(size_t s)
+    {
+        memory = mmap(nullptr, s, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (memory == MAP_FAILED)
+            throw std::runtime_error(errorMessage("mmap", name));
+        size = s;
+        segment = static_cast<Segment*>(memory);
+    }
+    
+    void SharedMemoryImagePool::Imp::push(uint32_t index)
+    {
+        uint64_t head = segment->freeList.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            links[index].store(uint32_t(head & IndexMask), std::memory_order_relaxed);
+            uint64_t newHead = ((head & ~IndexMask) + TagIncrement) | (index + 1);
+            if (segment->freeList.compare_exchange_weak(head, newHead,
+                                                        std::memory_order_release,
+                                                        std::memory_order_relaxed))
+                return;
+        }
+    }
+    
+    bool SharedMemoryImagePool::Imp::pop(uint32_t& index)
+    {
+        uint64_t head = segment->freeList.load(std::memory_order_acquire);
+        for (;;)
+        {
+            uint32_t top = uint32_t(head & IndexMask);
+            if (top == 0)
+                return false;
+            uint32_t next = links[top - 1].load(std::memory_order_relaxed);
+            uint64_t newHead = ((head & ~IndexMask) + TagIncrement) | next;
+            if (segment->freeList.compare_exchange_weak(head, newHead,
+                                                        std::memory_order_acquire,
+                                                        std::memory_order_acquire))
+            {
+                index = top - 1;
+                return true;
+            }
+        }
+    }
+    
+    // The ring works like Agl::FrameChannel, with cells whose sequence
+    // numbers say whether they are ready for a producer or a consumer: twice
+    // the position when empty for a frame at that position, and one more
+    // when full, so the two states cannot collide with a depth of 1.
+    
+    SharedMemoryImagePool::Imp::PublishResult
+    SharedMemoryImagePool::Imp::tryPublish(uint32_t index)
+    {
+        uint64_t depth = segment->ringDepth;
+        uint64_t position = segment->pushPosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells[position % depth];
+            uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+            int64_t difference = int64_t(sequence - 2 * position);
+            if (difference == 0)
+            {
+                if (segment->pushPosition.compare_exchange_weak(position, position + 1,
+                                                                std::memory_order_relaxed))
+                {
+                    cell.index = index;
+                    cell.sequence.store(2 * position + 1, std::memory_order_release);
+                    return Published;
+                }
+            }
+            else if (difference < 0)
+            {
+                uint64_t popped = segment->popPosition.load(std::memory_order_relaxed);
+                return (popped > position - depth) ? Busy : Full;
+            }
+            else
+            {
+                position = segment->pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    bool SharedMemoryImagePool::Imp::tryReceive(uint32_t& index)
+    {
+        uint64_t depth = segment->ringDepth;
+        uint64_t position = segment->popPosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells[position % depth];
+            uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+            int64_t difference = int64_t(sequence - (2 * position + 1));
+            if (difference == 0)
+            {
+                if (segment->popPosition.compare_exchange_weak(position, position + 1,
+                                                               std::memory_order_relaxed))
+                {
+                    index = cell.index;
+                    cell.sequence.store(2 * (position + depth),
+                                        std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = segment->popPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    GLubyte* SharedMemoryImagePool::Imp::image(uint32_t index) const
+    {
+        return images + index * segment->imageStride;
+    }
+    
+    uint32_t SharedMemoryImagePool::Imp::index(const GLubyte* image,
+                                               const char* function) const
+    {
+        uintptr_t offset = uintptr_t(image) - uintptr_t(images);
+        if ((image < images) || (offset % segment->imageStride != 0) ||
+            (offset / segment->imageStride >= segment->imageCount))
+        {
+            throw std::invalid_argument(std::string("Agl::SharedMemoryImagePool::") +
+                                        function + "(): the image is not from "
+                                        "this pool");
+        }
+        return uint32_t(offset / segment->imageStride);
+    }
+    
+    SharedMemoryImagePool::SharedMemoryImagePool(const std::string& name,
+                                                 GLsizei width, GLsizei height,
+                                                 GLsizei bytesPerPixel,
+                                                 size_t imageCount,
+                                                 size_t ringDepth)
+    {
+        if ((imageCount == 0) || (ringDepth == 0) || (ringDepth > imageCount) ||
+            (imageCount > IndexMask - 1))
+        {
+            throw std::invalid_argument("Agl::SharedMemoryImagePool(): needs "
+                                        "0 < ringDepth <= imageCount");
+        }
+        if ((width <= 0) || (height <= 0) || (bytesPerPixel <= 0))
+        {
+            throw std::invalid_argument("Agl::SharedMemoryImagePool(): width, "
+                                        "height and bytesPerPixel must be "
+                                        "positive");
+        }
+        
+        // The images are page aligned, and each image starts on a cache line.
+        
+        size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+        size_t imageSize = checkedProduct(checkedProduct(size_t(width),
+                                                         size_t(height)),
+                                          size_t(bytesPerPixel));
+        size_t imageStride = roundUp(imageSize, CacheLine);
+        size_t imagesOffset = roundUp(cellsOffset(imageCount) +
+                                      ringDepth * sizeof(Cell), pageSize);
+        size_t imagesSize = checkedProduct(imageStride, imageCount);
+        if ((imageSize == 0) || (imageStride < imageSize) || (imagesSize == 0) ||
+            (imagesSize > size_t(std::numeric_limits<off_t>::max()) - imagesOffset))
+        {
+            throw std::invalid_argument("Agl::SharedMemoryImagePool(): the "
+                                        "segment size is too large");
+        }
+        size_t size = imagesOffset + imagesSize;
+        
+        // A segment left by a creator that crashed would otherwise make every
+        // restart fail, so it is removed and the creation retried.
+        
+        _m = std::unique_ptr<Imp>(new Imp(name, false));
+        _m->fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if ((_m->fd == -1) && (errno == EEXIST) && isStale(name))
+        {
+            shm_unlink(name.c_str());
+            _m->fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        }
+        if (_m->fd == -1)
+            throw std::runtime_error(errorMessage("shm_open", name));
+        _m->creator = true;
+        
+        if (ftruncate(_m->fd, off_t(size)) != 0)
+            throw std::runtime_error(errorMessage("ftruncate", name));
+        _m->map(size);
+        
+        Segment* segment = new (_m->memory) Segment;
+        segment->ready.store(0, std::memory_order_relaxed);
+        segment->magic = Magic;
+        segment->version = Version;
+        segment->width = width;
+        segment->height = height;
+        segment->bytesPerPixel = bytesPerPixel;
+        segment->imageCount = uint32_t(imageCount);
+        segment->ringDepth = uint32_t(ringDepth);
+        segment->imageStride = imageStride;
+        segment->imagesOffset = imagesOffset;
+        segment->segmentSize = size;
+        segment->creatorPid = int32_t(getpid());
+        segment->freeList.store(0, std::memory_order_relaxed);
+        segment->pushPosition.store(0, std::memory_order_relaxed);
+        segment->popPosition.store(0, std::memory_order_relaxed);
+        segment->droppedCount.store(0, std::memory_order_relaxed);
+        
+        GLubyte* base = static_cast<GLubyte*>(_m->memory);
+        _m->links = reinterpret_cast<std::atomic<uint32_t>*>(base + linksOffset());
+        _m->cells = reinterpret_cast<Cell*>(base + cellsOffset(imageCount));
+        _m->images = base + imagesOffset;
+        for (size_t i = 0; i < imageCount; ++i)
+            new (&_m->links[i]) std::atomic<uint32_t>(0);
+        for (size_t i = 0; i < ringDepth; ++i)
+        {
+            Cell* cell = new (&_m->cells[i]) Cell;
+            cell->sequence.store(2 * i, std::memory_order_relaxed);
+            cell->index = 0;
+        }
+        for (size_t i = imageCount; i > 0; --i)
+            _m->push(uint32_t(i - 1));
+        
+        // Other processes wait for this before using the segment.
+        
+        segment->ready.store(1, std::memory_order_release);
+    }
+    
+    SharedMemoryImagePool::SharedMemoryImagePool(const std::string& name) :
+        _m(new Imp(name, false))
+    {
+        _m->fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (_m->fd == -1)
+            throw std::runtime_error(errorMessage("shm_open", name));
+        
+        // The creator sizes the segment before initializing it, so wait for
+        // both (briefly, since creation is quick).
+        
+        struct stat status;
+        const int maxWaits = 1000;
+        int waits = 0;
+        while ((fstat(_m->fd, &status) == 0) &&
+               (size_t(status.st_size) < sizeof(Segment)) && (waits++ < maxWaits))
+            usleep(1000);
+        if (size_t(status.st_size) < sizeof(Segment))
+        {
+            throw std::runtime_error("Agl::SharedMemoryImagePool(): \"" + name +
+                                     "\" is not an image pool segment");
+        }
+        _m->map(size_t(status.st_size));
+        
+        Segment* segment = _m->segment;
+        while ((segment->ready.load(std::memory_order_acquire) == 0) &&
+               (waits++ < maxWaits))
+            usleep(1000);
+        if ((segment->ready.load(std::memory_order_acquire) == 0) ||
+            (segment->magic != Magic) || (segment->version != Version) ||
+            (segment->segmentSize != _m->size))
+        {
+            throw std::runtime_error("Agl::SharedMemoryImagePool(): \"" + name +
+                                     "\" is not an image pool segment");
+        }
+        
+        GLubyte* base = static_cast<GLubyte*>(_m->memory);
+        _m->links = reinterpret_cast<std::atomic<uint32_t>*>(base + linksOffset());
+        _m->cells = reinterpret_cast<Cell*>(base + cellsOffset(segment->imageCount));
+        _m->images = base + segment->imagesOffset;
+    }
+    
+    SharedMemoryImagePool::~SharedMemoryImagePool()
+    {
+    }
+    
+    const std::string& SharedMemoryImagePool::name() const
+    {
+        return _m->name;
+    }
+    
+    bool SharedMemoryImagePool::isCreator() const
+    {
+        return _m->creator;
+    }
+    
+    GLsizei SharedMemoryImagePool::imageWidth() const
+    {
+        return _m->segment->width;
+    }
+    
+    GLsizei SharedMemoryImagePool::imageHeight() const
+    {
+        return _m->segment->height;
+    }
+    
+    GLsizei SharedMemoryImagePool::bytesPerPixel() const
+    {
+        return _m->segment->bytesPerPixel;
+    }
+    
+    size_t SharedMemoryImagePool::imageCount() const
+    {
+        return _m->segment->imageCount;
+    }
+    
+    size_t SharedMemoryImagePool::ringDepth() const
+    {
+        return _m->segment->ringDepth;
+    }
+    
+    GLubyte* SharedMemoryImagePool::alloc()
+    {
+        uint32_t index;
+        if (_m->pop(index))
+            return _m->image(index);
+        if (_m->tryReceive(index))
+        {
+            _m->segment->droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return _m->image(index);
+        }
+        return nullptr;
+    }
+    
+    void SharedMemoryImagePool::free(GLubyte* image)
+    {
+        _m->push(_m->index(image, "free"));
+    }
+    
+    void SharedMemoryImagePool::publish(GLubyte* image)
+    {
+        uint32_t index = _m->index(image, "publish");
+        for (;;)
+        {
+            Imp::PublishResult result = _m->tryPublish(index);
+            if (result == Imp::Published)
+                break;
+            
+            // Wait for the consumer to finish with the cell, rather than
+            // dropping another frame.
+            
+            if (result == Imp::Busy)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            
+            // Make room by dropping the oldest frame.  A consumer may take it
+            // first, in which case there is room anyway.
+            
+            uint32_t oldest;
+            if (_m->tryReceive(oldest))
+            {
+                _m->push(oldest);
+                _m->segment->droppedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    GLubyte* SharedMemoryImagePool::receive()
+    {
+        uint32_t index;
+        if (_m->tryReceive(index))
+            return _m->image(index);
+        return nullptr;
+    }
+    
+    GLubyte* SharedMemoryImagePool::receiveLatest()
+    {
+        uint32_t index;
+        if (!_m->tryReceive(index))
+            return nullptr;
+        
+        uint32_t newer;
+        while (_m->tryReceive(newer))
+        {
+            _m->push(index);
+            _m->segment->droppedCount.fetch_add(1, std::memory_order_relaxed);
+            index = newer;
+        }
+        return _m->image(index);
+    }
+    
+    uint64_t SharedMemoryImagePool::droppedCount() const
+    {
+        return _m->segment->droppedCount.load(std::memory_order_relaxed);
+    }
+    
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglSharedMemoryImagePool.h
+//
+// A class to share images between processes without copying them, for when
+// camera capture runs in a separate process from rendering (e.g., so a crash
+// in the capture code does not take down the renderer).  One process creates
+// a named POSIX shared-memory segment holding a fixed number of images of one
+// size, a lock-free list of the free images, and a lock-free ring of
+// published frames.  Other processes open the segment by name.  A producer
+// allocates an image, fills it and publishes it; a consumer receives it and,
+// since the image is in its own address space, can pass it directly to
+// Agl::TextureUbyte::setData(), then frees it.  When the ring is full,
+// publishing drops the oldest frame, so the consumer always gets recent
+// frames.  The operations are thread safe as well as process safe.
+//
+
+#ifndef __AglSharedMemoryImagePool__
+#define __AglSharedMemoryImagePool__
+
+#include <OpenGL/gl3.h>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+namespace Agl
+{
+    class SharedMemoryImagePool
+    {
+    public:
+        
+        // Create a shared-memory segment with the specified name (e.g.,
+        // "/facetious-camera"), holding imageCount images of the specified
+        // size and a ring of up to ringDepth published frames (with a
+        // ringDepth of 1, only the newest frame is kept).  The segment
+        // is removed when this instance is destroyed.  If a segment with the
+        // name already exists and its creating process is still running, or
+        // the segment cannot be created, a std::runtime_error exception is
+        // thrown.  A segment whose creator has exited without removing it
+        // (e.g., by crashing) is removed and replaced, so a restarted creator
+        // succeeds.  If imageCount or ringDepth is zero, ringDepth is larger
+        // than imageCount, width, height or bytesPerPixel is not positive,
+        // or the segment's size would overflow, a std::invalid_argument
+        // exception is thrown.
+        
+        SharedMemoryImagePool(const std::string& name, GLsizei width,
+                              GLsizei height, GLsizei bytesPerPixel,
+                              size_t imageCount, size_t ringDepth = 2);
+        
+        // Open the existing segment with the specified name, created by
+        // another instance (usually in another process).  If there is no such
+        // segment, or it is not a segment created by this class, a
+        // std::runtime_error exception is thrown.
+        
+        explicit SharedMemoryImagePool(const std::string& name);
+        
+        ~SharedMemoryImagePool();
+        
+        const std::string&  name() const;
+        bool                isCreator() const;
+        
+        // Access the size of the images, and how many there are.
+        
+        GLsizei             imageWidth() const;
+        GLsizei             imageHeight() const;
+        GLsizei             bytesPerPixel() const;
+        size_t              imageCount() const;
+        size_t              ringDepth() const;
+        
+        // Obtain a free image.  If none is free, the oldest published frame
+        // that has not been received is taken instead (and counted as
+        // dropped).  If that also fails, because every image is held by a
+        // producer or consumer, the result is null.
+        
+        GLubyte*            alloc();
+        
+        // Return an image to the free list.  Any process may free an image,
+        // not just the process that allocated it.
+        
+        void                free(GLubyte* image);
+        
+        // Publish an image as the newest frame, giving up ownership of it.
+        // If the ring is full, the oldest frame is dropped and freed.
+        
+        void                publish(GLubyte* image);
+        
+        // Take the oldest published frame, or null if there is none.  The
+        // caller owns the image and must free() it.
+        
+        GLubyte*            receive();
+        
+        // Take the newest published frame, freeing any older ones, or null
+        // if there is none.  The caller owns the image and must free() it.
+        
+        GLubyte*            receiveLatest();
+        
+        // The number of frames dropped by publish(), alloc() and
+        // receiveLatest(), in all processes.
+        
+        uint64_t            droppedCount() const;
+        
+    private:
+        
+        SharedMemoryImagePool(const SharedMemoryImagePool&) = delete;
+        SharedMemoryImagePool&  operator=(const SharedMemoryImagePool&) = delete;
+        
+        // Details of the class' data are hidden in the .cpp file.
+        
+        class Imp;
+        std::unique_ptr<Imp> _m;
+    };
+}
+
+#endif
@@ -0,0 +1,254 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglSizedImagePool.cpp
+//
+
+#include "AglSizedImagePool.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <stdint.h>
+
+namespace Agl
+{
+    
+    namespace
+    {
+        
+        // Each allocation starts with a header recording its size class, and
+        // the memory given out starts after the header.  The header's size
+        // keeps the memory given out as aligned as the allocation.
+        
+        const size_t HeaderSize = 16;
+        
+        // The default size classes are the powers of two from 2^MinShift
+        // bytes to the largest that size_t can represent.
+        
+        const int MinShift = 12;
+        const int MaxShift = int(sizeof(size_t)) * 8 - 1;
+        
+        struct SizeClass
+        {
+            std::mutex              mutex;
+            std::vector<GLubyte*>   pool;
+        };
+        
+        std::vector<size_t> powerOfTwoSizes()
+        {
+            std::vector<size_t> result;
+            for (int shift = MinShift; shift <= MaxShift; ++shift)
+                result.push_back(size_t(1) << shift);
+            return result;
+        }
+        
+        std::vector<size_t> sortedSizes(std::vector<size_t> sizes)
+        {
+            std::sort(sizes.begin(), sizes.end());
+            sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+            if (!sizes.empty() && (sizes.front() == 0))
+                sizes.erase(sizes.begin());
+            if (sizes.empty())
+            {
+                throw std::invalid_argument("Agl::SizedImagePool needs at least "
+                                            "one non-zero size class");
+            }
+            return sizes;
+        }
+        
+    }
+    
+    class SizedImagePool::Imp
+    {
+    public:
+        Imp(const std::vector<size_t>& classSizes, size_t memoryLimit);
+        ~Imp();
+        
+        size_t                  classIndex(size_t size) const;
+        bool                    reserve(size_t size);
+        bool                    releaseOne(size_t except);
+        
+        std::vector<size_t>     classSizes;
+        std::unique_ptr<SizeClass[]> classes;
+        size_t                  memoryLimit;
+        std::atomic<size_t>     memoryAllocated;
+    };
+    
+    SizedImagePool::Imp::Imp(const std::vector<size_t>& sizes,
+                             size_t limit) :
+        classSizes(sizes), classes(new SizeClass [sizes.size()]),
+        memoryLimit(limit), memoryAllocated(0)
+    {
+    }
+    
+    SizedImagePool::Imp::~Imp()
+    {
+        for (size_t i = 0; i < classSizes.size(); ++i)
+        {
+            for (GLubyte* image : classes[i].pool)
+                delete [] (image - HeaderSize);
+        }
+    }
+    
+    size_t SizedImagePool::Imp::classIndex(size_t size) const
+    {
+        std::vector<size_t>::const_iterator it =
+            std::lower_bound(classSizes.begin(), classSizes.end(), size);
+        if (it == classSizes.end())
+        {
+            throw std::invalid_argument("Agl::SizedImagePool::alloc(): the "
+                                        "size is larger than any size class");
+        }
+        return size_t(it - classSizes.begin());
+    }
+    
+    // Add size to the memory allocated, if that stays within the limit.
+    
+    bool SizedImagePool::Imp::reserve(size_t size)
+    {
+        size_t allocated = memoryAllocated.load(std::memory_order_relaxed);
+        do
+        {
+            if ((memoryLimit != 0) && (allocated + size > memoryLimit))
+                return false;
+        }
+        while (!memoryAllocated.compare_exchange_weak(allocated, allocated + size,
+                                                      std::memory_order_relaxed));
+        return true;
+    }
+    
+    // Release one retained allocation, from the largest class that has one
+    // other than class except, and return whether there was one.
+    
+    bool SizedImagePool::Imp::releaseOne(size_t except)
+    {
+        for (size_t i = classSizes.size(); i-- > 0; )
+        {
+            if (i == except)
+                continue;
+            
+            GLubyte* image = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(classes[i].mutex);
+                if (!classes[i].pool.empty())
+                {
+                    image = classes[i].pool.back();
+                    classes[i].pool.pop_back();
+                }
+            }
+            if (image != nullptr)
+            {
+                delete [] (image - HeaderSize);
+                memoryAllocated.fetch_sub(classSizes[i], std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    SizedImagePool::SizedImagePool(size_t memoryLimit) :
+        _m(new Imp(powerOfTwoSizes(), memoryLimit))
+    {
+    }
+    
+    SizedImagePool::SizedImagePool(const std::vector<size_t>& classSizes,
+                                   size_t memoryLimit) :
+        _m(new Imp(sortedSizes(classSizes), memoryLimit))
+    {
+    }
+    
+    SizedImagePool::~SizedImagePool()
+    {
+    }
+    
+    GLubyte* SizedImagePool::alloc(size_t size)
+    {
+        size_t index = _m->classIndex(size);
+        SizeClass& sizeClass = _m->classes[index];
+        
+        {
+            std::lock_guard<std::mutex> lock(sizeClass.mutex);
+            if (!sizeClass.pool.empty())
+            {
+                GLubyte* result = sizeClass.pool.back();
+                sizeClass.pool.pop_back();
+                return result;
+            }
+        }
+        
+        size_t allocSize = _m->classSizes[index];
+        while (!_m->reserve(allocSize))
+        {
+            if (!_m->releaseOne(index))
+            {
+                throw std::runtime_error("Agl::SizedImagePool::alloc() would "
+                                         "exceed the memory limit");
+            }
+        }
+        
+        GLubyte* memory;
+        try
+        {
+            memory = new GLubyte [HeaderSize + allocSize];
+        }
+        catch (...)
+        {
+            _m->memoryAllocated.fetch_sub(allocSize, std::memory_order_relaxed);
+            throw;
+        }
+        *reinterpret_cast<uint32_t*>(memory) = uint32_t(index);
+        return memory + HeaderSize;
+    }
+    
+    GLubyte* SizedImagePool::alloc(GLsizei width, GLsizei height,
+                                   GLsizei bytesPerPixel)
+    {
+        return alloc(size_t(width) * height * bytesPerPixel);
+    }
+    
+    void SizedImagePool::free(GLubyte* image)
+    {
+        size_t index = *reinterpret_cast<uint32_t*>(image - HeaderSize);
+        SizeClass& sizeClass = _m->classes[index];
+        
+        std::lock_guard<std::mutex> lock(sizeClass.mutex);
+        sizeClass.pool.push_back(image);
+    }
+    
+    size_t SizedImagePool::classSize(size_t size) const
+    {
+        return _m->classSizes[_m->classIndex(size)];
+    }
+    
+    size_t SizedImagePool::memoryLimit() const
+    {
+        return _m->memoryLimit;
+    }
+    
+    size_t SizedImagePool::memoryAllocated() const
+    {
+        return _m->memoryAllocated.load(std::memory_order_relaxed);
+    }
+    
+}
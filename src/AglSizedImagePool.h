@@ -0,0 +1,99 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglSizedImagePool.h
+//
+// A class to manage the memory for images of many different sizes.  Like
+// Agl::ImagePool, it retains freed memory for reuse, but instead of serving
+// one image size set in advance, it serves any size, rounded up to one of a
+// set of size classes, with a separate list of retained memory for each
+// class.  Images of different resolutions (e.g., full, half and quarter
+// resolution, or cropped regions) can thus share one pool.  The total memory
+// allocated by the pool can be limited, in which case retained memory of
+// other classes is released to make room for a new allocation.  The
+// operations of this class are thread safe.
+//
+
+#ifndef __AglSizedImagePool__
+#define __AglSizedImagePool__
+
+#include <OpenGL/gl3.h>
+#include <memory>
+#include <vector>
+
+namespace Agl
+{
+    class SizedImagePool
+    {
+    public:
+        
+        // Create a pool whose size classes are the powers of two, starting
+        // at 4096 bytes.  A memoryLimit of 0 means no limit.
+        
+        SizedImagePool(size_t memoryLimit = 0);
+        
+        // Create a pool with the specified size classes, in bytes.  A request
+        // larger than the largest class causes a std::invalid_argument
+        // exception to be thrown, as does an empty classSizes.
+        
+        SizedImagePool(const std::vector<size_t>& classSizes,
+                       size_t memoryLimit = 0);
+        
+        ~SizedImagePool();
+        
+        // Obtain memory for at least size bytes, or for an image of the
+        // specified dimensions, from the pool.  The memory is reused from the
+        // size class that fits, or is allocated if that class has none.  If
+        // the allocation would exceed the memory limit even after releasing
+        // all the retained memory of other classes, a std::runtime_error
+        // exception is thrown.
+        
+        GLubyte*    alloc(size_t size);
+        GLubyte*    alloc(GLsizei width, GLsizei height, GLsizei bytesPerPixel);
+        
+        // Return memory to the pool for reuse.  The memory must have been
+        // obtained from alloc() on this pool.
+        
+        void        free(GLubyte*);
+        
+        // The number of bytes that alloc(size) actually provides.
+        
+        size_t      classSize(size_t size) const;
+        
+        // The limit on the total memory of the pool, and the total memory
+        // currently allocated, both in the pool and in use.  Both count the
+        // class sizes, not the few bytes of bookkeeping per allocation.
+        
+        size_t      memoryLimit() const;
+        size_t      memoryAllocated() const;
+        
+    private:
+        
+        // Details of the class' data are hidden in the .cpp file.
+        
+        class Imp;
+        std::unique_ptr<Imp> _m;
+    };
+}
+
+#endif
@@ -25,8 +25,136 @@
 //
 
 #include "AglTexture.h"
+#include <algorithm>
+#include <stdexcept>
 #include <vector>
-#include <map>
+
+namespace
+{
+    
+    // The index of a texture target in each texture unit's entries of the
+    // binding cache, or -1 for an unknown target.
+    
+    const size_t targetCount = 11;
+    
+    int targetIndex(GLenum target)
+    {
+        switch (target)
+        {
+            case GL_TEXTURE_2D:
+                return 0;
+            case GL_TEXTURE_RECTANGLE:
+                return 1;
+            case GL_TEXTURE_CUBE_MAP:
+                return 2;
+            case GL_TEXTURE_3D:
+                return 3;
+            case GL_TEXTURE_2D_ARRAY:
+                return 4;
+            case GL_TEXTURE_1D:
+                return 5;
+            case GL_TEXTURE_1D_ARRAY:
+                return 6;
+            case GL_TEXTURE_BUFFER:
+                return 7;
+            case GL_TEXTURE_2D_MULTISAMPLE:
+                return 8;
+            case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:
+                return 9;
+#if defined(GL_TEXTURE_CUBE_MAP_ARRAY)
+            case GL_TEXTURE_CUBE_MAP_ARRAY:
+                return 10;
+#endif
+            default:
+                return -1;
+        }
+    }
+    
+    // The sized internal format that glTexStorage2D() requires in place of
+    // an unsized one.
+    
+    GLenum sizedInternalFormat(GLint internalFormat)
+    {
+        switch (internalFormat)
+        {
+            case GL_RED:
+                return GL_R8;
+            case GL_RG:
+                return GL_RG8;
+            case GL_RGB:
+                return GL_RGB8;
+            case GL_RGBA:
+                return GL_RGBA8;
+            default:
+                return internalFormat;
+        }
+    }
+    
+    // Whether the context supports glTexStorage2D().  The header may declare
+    // it for a newer version of OpenGL than the context provides, so the
+    // version is checked once, like Agl::Texture::maxTextureUnits().
+    
+    bool hasTextureStorage()
+    {
+#if defined(GL_VERSION_4_2)
+        static int has = -1;
+        if (has < 0)
+        {
+            GLint major = 0;
+            GLint minor = 0;
+            glGetIntegerv(GL_MAJOR_VERSION, &major);
+            glGetIntegerv(GL_MINOR_VERSION, &minor);
+            has = ((major > 4) || ((major == 4) && (minor >= 2))) ? 1 : 0;
+        }
+        return has != 0;
+#else
+        return false;
+#endif
+    }
+    
+    // Copy the sampling parameters of one texture object to another of the
+    // same target, leaving the second one bound.  The base and maximum
+    // levels are not copied, because allocating storage sets them.
+    
+    void copyParameters(GLenum target, GLuint from, GLuint to)
+    {
+        static const GLenum intNames[] =
+        {
+            GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S,
+            GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R, GL_TEXTURE_COMPARE_MODE,
+            GL_TEXTURE_COMPARE_FUNC,
+#if defined(GL_TEXTURE_SWIZZLE_R)
+            GL_TEXTURE_SWIZZLE_R, GL_TEXTURE_SWIZZLE_G, GL_TEXTURE_SWIZZLE_B,
+            GL_TEXTURE_SWIZZLE_A
+#endif
+        };
+        static const GLenum floatNames[] =
+        {
+            GL_TEXTURE_MIN_LOD, GL_TEXTURE_MAX_LOD, GL_TEXTURE_LOD_BIAS
+        };
+        const size_t intCount = sizeof(intNames) / sizeof(intNames[0]);
+        const size_t floatCount = sizeof(floatNames) / sizeof(floatNames[0]);
+        
+        GLint ints[intCount];
+        GLfloat floats[floatCount];
+        GLfloat borderColor[4];
+        
+        glBindTexture(target, from);
+        for (size_t i = 0; i < intCount; ++i)
+            glGetTexParameteriv(target, intNames[i], &ints[i]);
+        for (size_t i = 0; i < floatCount; ++i)
+            glGetTexParameterfv(target, floatNames[i], &floats[i]);
+        glGetTexParameterfv(target, GL_TEXTURE_BORDER_COLOR, borderColor);
+        
+        glBindTexture(target, to);
+        for (size_t i = 0; i < intCount; ++i)
+            glTexParameteri(target, intNames[i], ints[i]);
+        for (size_t i = 0; i < floatCount; ++i)
+            glTexParameterf(target, floatNames[i], floats[i]);
+        glTexParameterfv(target, GL_TEXTURE_BORDER_COLOR, borderColor);
+    }
+    
+}
 
 namespace Agl
 {
@@ -34,45 +162,88 @@ namespace Agl
     class Texture::Imp
     {
     public:
-        Imp(GLenum t) : target(t), id(0) {}
+        Imp(GLenum t) : target(t), targetIndex(::targetIndex(t)), id(0),
+            hasStorage(false), immutableStorage(false), replaced(false),
+            width(0), height(0), internalFormat(0), levelCount(0) {}
         GLenum  target;
+        size_t  targetIndex;
         GLuint  id;
         
-        // This vector is indexed by texture units (normalized so that GL_TEXTURE0
-        // has index 0).  A unit's entry in the vector is a map from texture
-        // target identifiers to the Agl::Texture currently bound to that target
-        // for the unit.
+        // The storage allocated by setImage().
+        
+        bool    hasStorage;
+        bool    immutableStorage;
+        
+        // Whether immutable storage had to be replaced to change its size,
+        // after which storage is allocated as mutable, so id() changes at
+        // most once.
+        
+        bool    replaced;
+        GLsizei width;
+        GLsizei height;
+        GLint   internalFormat;
+        GLsizei levelCount;
+        
+        // The Agl::Texture currently bound to each target of each texture
+        // unit, indexed by the unit (normalized so that GL_TEXTURE0 has index
+        // 0) times targetCount plus the target's index, so a lookup is one
+        // array access.  The vector has an entry for every unit, allocated
+        // at the first bind().
+        
+        static std::vector<Texture*>    bindings;
+        
+        // The active texture unit, as last set by bind(), or 0 if it is not
+        // known yet (in which case it is queried once).  Tracking it avoids
+        // redundant calls to glActiveTexture(), and avoids querying it with
+        // glGetIntegerv(), which can stall the pipeline.
+        
+        static GLenum                   activeUnit;
+        
+        static GLenum                   currentActiveUnit();
         
-        typedef std::map<size_t, Texture*>  TargetToTexture;
-        static std::vector<TargetToTexture> unitBindings;
+        // Remove the records of a texture being bound.
+        
+        static void forgetBindings(Texture* texture);
     };
     
-    std::vector<Texture::Imp::TargetToTexture> Texture::Imp::unitBindings;
+    std::vector<Texture*> Texture::Imp::bindings;
+    GLenum Texture::Imp::activeUnit = 0;
+    
+    GLenum Texture::Imp::currentActiveUnit()
+    {
+        if (activeUnit == 0)
+        {
+            GLint unit = GL_TEXTURE0;
+            glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
+            activeUnit = GLenum(unit);
+        }
+        return activeUnit;
+    }
+    
+    void Texture::Imp::forgetBindings(Texture* texture)
+    {
+        // The texture can be bound only to its own target, so there is one
+        // entry to check for each unit.
+        
+        for (size_t i = texture->_m->targetIndex; i < bindings.size();
+             i += targetCount)
+        {
+            if (bindings[i] == texture)
+                bindings[i] = nullptr;
+        }
+    }
     
     Texture::Texture(GLenum target) :
         _m(new Imp(target))
     {
+        if (_m->targetIndex == size_t(-1))
+            throw std::invalid_argument("Agl::Texture(): unknown target");
     }
     
     Texture::~Texture()
     {
         glDeleteTextures(1, &_m->id);
-        
-        // The assumption is that Texture deletion is rare, so
-        // the algorithm does not need to be have special measures
-        // to make it efficient.
-        
-        for (Imp::TargetToTexture& map : Imp::unitBindings)
-        {
-            Imp::TargetToTexture::iterator it = map.begin();
-            while (it != map.end())
-            {
-                if (it->second == this)
-                    map.erase(it++);
-                else
-                    it++;
-            }
-        }
+        Imp::forgetBindings(this);
     }
     
     GLenum Texture::target() const
@@ -97,22 +268,23 @@ namespace Agl
         
         if (!isBound(unit))
         {
-            glActiveTexture(unit);
+            if (unit != Imp::activeUnit)
+            {
+                glActiveTexture(unit);
+                Imp::activeUnit = unit;
+            }
             glBindTexture(_m->target, id());
             
-            // Extend the Imp::unitBindings vector so it is long enough to have
-            // an entry for the (normalized) texture unit.  This approach makes
-            // the assumption that "lower" texture units (e.g., GL_TEXTURE0) are
-            // commonly used, and "higher" texture unis (e.g., GL_TEXTURE0 + N
-            // for a large N) are not used in most applications.
+            // Allocate an entry for every unit and target at once, so no
+            // later bind() reallocates.
             
-            size_t u = unit - GL_TEXTURE0;
-            if (Imp::unitBindings.size() <= u)
-                Imp::unitBindings.resize(u + 1);
+            if (Imp::bindings.empty())
+                Imp::bindings.resize(maxTextureUnits() * targetCount, nullptr);
             
             // Record this texture binding so isBound() can find it.
             
-            Imp::unitBindings[u][_m->target] = this;
+            size_t u = unit - GL_TEXTURE0;
+            Imp::bindings[u * targetCount + _m->targetIndex] = this;
         }
     }
     
@@ -121,18 +293,13 @@ namespace Agl
         if (unit - GL_TEXTURE0 >= maxTextureUnits())
             throw std::out_of_range("Agl::Texture::isBound(): invalid unit");
 
-        bool result = false;
-        
-        size_t u = unit - GL_TEXTURE0;
-        if (Imp::unitBindings.size() > u)
-        {
-            Imp::TargetToTexture& map = Imp::unitBindings[u];
-            Imp::TargetToTexture::iterator it = map.find(_m->target);
-            if ((it != map.end()) && (it->second == this))
-                result = true;
-        }
-        
-        return result;
+        size_t i = (unit - GL_TEXTURE0) * targetCount + _m->targetIndex;
+        return (i < Imp::bindings.size()) && (Imp::bindings[i] == this);
+    }
+    
+    GLsizei Texture::levelCount() const
+    {
+        return _m->levelCount;
     }
     
     GLsizei Texture::maxTextureUnits()
@@ -144,21 +311,125 @@ namespace Agl
         return max;
     }
     
+    void Texture::resetBindingCache()
+    {
+        std::fill(Imp::bindings.begin(), Imp::bindings.end(), nullptr);
+        Imp::activeUnit = 0;
+    }
+    
     void Texture::unbind()
     {
-        GLsizei unit;
-        glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
-
-        size_t u = unit - GL_TEXTURE0;
-        if (Imp::unitBindings.size() > u)
+        size_t u = Imp::currentActiveUnit() - GL_TEXTURE0;
+        size_t i = u * targetCount + _m->targetIndex;
+        if ((i < Imp::bindings.size()) && (Imp::bindings[i] != this))
+            Imp::bindings[i] = nullptr;
+    }
+    
+    void Texture::setImage(GLint internalFormat, GLsizei width,
+                           GLsizei height, GLenum format, GLenum type,
+                           const GLvoid* data, GLint rowLength,
+                           GLint skipPixels, GLint skipRows,
+                           GLsizei levelCount)
+    {
+        bool allocate = !_m->hasStorage || (width != _m->width) ||
+                        (height != _m->height) ||
+                        (internalFormat != _m->internalFormat) ||
+                        (levelCount != _m->levelCount);
+        
+        if (allocate && _m->immutableStorage)
+        {
+            GLuint old = _m->id;
+            glGenTextures(1, &_m->id);
+            copyParameters(_m->target, old, _m->id);
+            glDeleteTextures(1, &old);
+            Imp::forgetBindings(this);
+            _m->replaced = true;
+        }
+        
+        glBindTexture(_m->target, _m->id);
+        
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, skipPixels);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, skipRows);
+        
+        bool copy = (data != nullptr);
+        if (allocate)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                            levelCount - 1);
+            if (levelCount > 1)
+            {
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                                GL_LINEAR_MIPMAP_LINEAR);
+            }
+            
+            _m->immutableStorage = !_m->replaced && hasTextureStorage();
+#if defined(GL_VERSION_4_2)
+            if (_m->immutableStorage)
+            {
+                glTexStorage2D(GL_TEXTURE_2D, levelCount,
+                               sizedInternalFormat(internalFormat), width,
+                               height);
+            }
+#endif
+            if (!_m->immutableStorage)
+            {
+                glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height,
+                             0, format, type, data);
+                copy = false;
+                
+                // The other levels start undefined, as with glTexStorage2D().
+                
+                for (GLsizei level = 1; level < levelCount; ++level)
+                {
+                    glTexImage2D(GL_TEXTURE_2D, level, internalFormat,
+                                 std::max(width >> level, 1),
+                                 std::max(height >> level, 1), 0, format,
+                                 type, nullptr);
+                }
+            }
+            
+            _m->hasStorage = true;
+            _m->width = width;
+            _m->height = height;
+            _m->internalFormat = internalFormat;
+            _m->levelCount = levelCount;
+        }
+        
+        if (copy)
         {
-            Imp::TargetToTexture& map = Imp::unitBindings[u];
-            Imp::TargetToTexture::iterator it = map.find(_m->target);
-            if ((it != map.end()) && (it->second != this))
-                map.erase(it);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format,
+                            type, data);
         }
+        
+        // Make certain Texture::isBound() does not incorrectly return true for
+        // another texture.
+        
+        unbind();
+    }
+    
+    void Texture::setImageLevel(GLint level, GLint x, GLint y, GLsizei width,
+                                GLsizei height, GLenum format, GLenum type,
+                                const GLvoid* data, GLint rowLength,
+                                GLint skipPixels, GLint skipRows)
+    {
+        glBindTexture(_m->target, _m->id);
+        
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, skipPixels);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, skipRows);
+        glTexSubImage2D(GL_TEXTURE_2D, level, x, y, width, height, format, type,
+                        data);
+        
+        unbind();
+    }
+    
+    void Texture::generateMipmap()
+    {
+        glBindTexture(_m->target, _m->id);
+        glGenerateMipmap(_m->target);
+        unbind();
     }
 
 }
-
-
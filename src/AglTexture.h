@@ -39,7 +39,8 @@ namespace Agl
     public:
         
         // The target should be a valid argument for glBindTexture() (e.g.,
-        // GL_TEXTURE_2D).
+        // GL_TEXTURE_2D).  Otherwise, a std::invalid_argument exception is
+        // thrown.
         
         Texture(GLenum target);
         virtual ~Texture();
@@ -58,7 +59,9 @@ namespace Agl
         
         // Bind the texture to the specified texture unit.  The implementation
         // keeps track of which texture is bound, so it will not make an
-        // additional call to glBindTexture() if this texture is already bound.
+        // additional call to glBindTexture() if this texture is already bound,
+        // and of the active texture unit, so it calls glActiveTexture() only
+        // when the unit changes.
         // If the texture unit is not valid, a std::out_of_range exception is
         // thrown.
         
@@ -70,12 +73,25 @@ namespace Agl
         
         bool            isBound(GLenum unit = GL_TEXTURE0);
         
+        // The number of mipmap levels in the texture's storage, which is 1
+        // unless a derived class set more with setImage(), or 0 if there is
+        // no storage yet.
+        
+        GLsizei         levelCount() const;
+        
         // A cache for the maximum number of texture units supported by the
         // implementation of OpenGL, to avoid unnecessary calls to
         // glGetIntegerv().
         
         static GLsizei  maxTextureUnits();
         
+        // The bookkeeping for bind() and isBound() assumes that textures are
+        // bound and the active texture unit is changed only through this
+        // class.  After other code calls glBindTexture() or glActiveTexture()
+        // directly, this routine makes the next bind() calls rebind.
+        
+        static void     resetBindingCache();
+        
     protected:
         
         // Should be called by a derived class if it calls glBindTexture() to
@@ -84,7 +100,50 @@ namespace Agl
         
         void            unbind();
         
+        // Set level 0 of the texture, for the setData() routines of derived
+        // classes, with the arguments as for glTexImage2D() and the unpack
+        // parameters.  Storage is allocated only when the size, internal
+        // format or level count changes (as immutable storage, with
+        // glTexStorage2D(), when the context supports OpenGL 4.2), along with
+        // the mipmap level range, and otherwise the data is copied into the
+        // existing storage with glTexSubImage2D().  Thus streaming frames of
+        // one size does not make the driver reallocate the texture for every
+        // frame.  Immutable storage cannot be resized, so the first new size
+        // replaces the texture object, changing id(), and copies the sampling
+        // parameters (filters, wrap modes, comparison, swizzle, level of
+        // detail and border color) to the new object; framebuffer objects
+        // that had the old texture attached must attach the new one.  Later
+        // allocations use mutable storage, so id() does not change again.
+        // With a levelCount greater than 1, storage is allocated for that
+        // many mipmap levels, which the derived class fills with
+        // setImageLevel() or generateMipmap(), and the minification filter is
+        // set to GL_LINEAR_MIPMAP_LINEAR.
+        
+        void            setImage(GLint internalFormat, GLsizei width,
+                                 GLsizei height, GLenum format, GLenum type,
+                                 const GLvoid* data, GLint rowLength,
+                                 GLint skipPixels, GLint skipRows,
+                                 GLsizei levelCount = 1);
+        
+        // Copy data into a region of a mipmap level allocated by setImage(),
+        // with the arguments as for glTexSubImage2D() and the unpack
+        // parameters.
+        
+        void            setImageLevel(GLint level, GLint x, GLint y,
+                                      GLsizei width, GLsizei height,
+                                      GLenum format, GLenum type,
+                                      const GLvoid* data, GLint rowLength,
+                                      GLint skipPixels, GLint skipRows);
+        
+        // Fill the mipmap levels after level 0 with glGenerateMipmap().
+        
+        void            generateMipmap();
+        
     private:
+        
+        // Agl::TextureStream uploads into the texture from its own buffers.
+        
+        friend class TextureStream;
 
         // Details of the class' data are hidden in the .cpp file.
         // This pattern also prevents instances from being copied, which makes
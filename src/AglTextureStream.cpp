@@ -0,0 +1,281 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglTextureStream.cpp
+//
+
+#include "AglTextureStream.h"
+#include "AglPooledImage.h"
+#include "AglTextureUbyte.h"
+#include "AglUploadFormat.h"
+#include <stdexcept>
+#include <string.h>
+#include <vector>
+
+namespace Agl
+{
+    
+    class TextureStream::Imp
+    {
+    public:
+        Imp(TextureUbyte& texture, GLsizei width, GLsizei height,
+            GLsizei bytesPerPixel, GLenum format, GLenum type);
+        
+        TextureUbyte&           texture;
+        GLsizei                 width;
+        GLsizei                 height;
+        GLsizei                 bytesPerPixel;
+        GLenum                  format;
+        GLenum                  type;
+        GLsizeiptr              bufferSize;
+        
+        // The ring of buffers, and the fence following the last upload from
+        // each, or null if there has been none.
+        
+        std::vector<GLuint>     buffers;
+        std::vector<GLsync>     fences;
+        
+        // The next buffer to acquire, and the acquired buffer, or -1.
+        
+        size_t                  next;
+        long                    acquired;
+        
+        size_t                  waitCount;
+        
+        // Wait until the driver is done with buffer i.
+        
+        void                    waitForBuffer(size_t i);
+    };
+    
+    TextureStream::Imp::Imp(TextureUbyte& texture, GLsizei width,
+                            GLsizei height, GLsizei bytesPerPixel,
+                            GLenum format, GLenum type) :
+        texture(texture), width(width), height(height),
+        bytesPerPixel(bytesPerPixel), format(format), type(type),
+        bufferSize(GLsizeiptr(width) * height * bytesPerPixel), next(0),
+        acquired(-1), waitCount(0)
+    {
+    }
+    
+    void TextureStream::Imp::waitForBuffer(size_t i)
+    {
+        GLsync& fence = fences[i];
+        if (!fence)
+            return;
+        
+        // Check without waiting first, so waitCount counts only the real
+        // waits.  The first wait flushes, so the fence is sure to signal.
+        
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if ((status == GL_TIMEOUT_EXPIRED))
+        {
+            ++waitCount;
+            const GLuint64 second = 1000000000;
+            do
+                status = glClientWaitSync(fence, 0, second);
+            while (status == GL_TIMEOUT_EXPIRED);
+        }
+        
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    
+    TextureStream::TextureStream(TextureUbyte& texture, GLsizei width,
+                                 GLsizei height, GLsizei bytesPerPixel,
+                                 size_t bufferCount, GLint internalFormat,
+                                 GLenum format, GLenum type) :
+        _m(new Imp(texture, width, height, bytesPerPixel, format,
+                   (type != 0) ? type :
+                                 preferredUploadType(format, internalFormat)))
+    {
+        if (bufferCount == 0)
+        {
+            throw std::invalid_argument("Agl::TextureStream(): bufferCount "
+                                        "must be positive");
+        }
+        
+        texture.setData(nullptr, width, height, internalFormat, format, 0, 0, 0,
+                        _m->type);
+        
+        _m->buffers.resize(bufferCount);
+        _m->fences.resize(bufferCount, nullptr);
+        glGenBuffers(GLsizei(bufferCount), _m->buffers.data());
+        for (GLuint buffer : _m->buffers)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, _m->bufferSize, nullptr,
+                         GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    
+    TextureStream::~TextureStream()
+    {
+        if (_m->acquired >= 0)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _m->buffers[_m->acquired]);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        for (GLsync fence : _m->fences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+        }
+        glDeleteBuffers(GLsizei(_m->buffers.size()), _m->buffers.data());
+    }
+    
+    GLsizei TextureStream::width() const
+    {
+        return _m->width;
+    }
+    
+    GLsizei TextureStream::height() const
+    {
+        return _m->height;
+    }
+    
+    GLsizei TextureStream::bytesPerPixel() const
+    {
+        return _m->bytesPerPixel;
+    }
+    
+    size_t TextureStream::bufferCount() const
+    {
+        return _m->buffers.size();
+    }
+    
+    MutableImageView TextureStream::acquire()
+    {
+        if (_m->acquired >= 0)
+        {
+            throw std::runtime_error("Agl::TextureStream::acquire(): a buffer "
+                                     "is already acquired");
+        }
+        
+        size_t i = _m->next;
+        _m->waitForBuffer(i);
+        
+        // The fence has signaled, so the driver need not synchronize the
+        // mapping with earlier uses of the buffer, and the old contents are
+        // not needed.
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _m->buffers[i]);
+        void* memory = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+                                        _m->bufferSize,
+                                        GL_MAP_WRITE_BIT |
+                                        GL_MAP_INVALIDATE_BUFFER_BIT |
+                                        GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!memory)
+        {
+            throw std::runtime_error("Agl::TextureStream::acquire(): "
+                                     "glMapBufferRange() failed");
+        }
+        
+        _m->acquired = long(i);
+        _m->next = (i + 1) % _m->buffers.size();
+        
+        return MutableImageView(static_cast<GLubyte*>(memory), _m->width,
+                                _m->height, _m->bytesPerPixel);
+    }
+    
+    void TextureStream::submit()
+    {
+        if (_m->acquired < 0)
+        {
+            throw std::runtime_error("Agl::TextureStream::submit(): no buffer "
+                                     "is acquired");
+        }
+        
+        size_t i = size_t(_m->acquired);
+        _m->acquired = -1;
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _m->buffers[i]);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        
+        Texture& texture = _m->texture;
+        glBindTexture(texture.target(), texture.id());
+        
+        // The buffer holds a packed frame, whose rows need not be a multiple
+        // of 4 bytes.  With the buffer bound, the data argument is an offset
+        // into it.
+        
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _m->width, _m->height,
+                        _m->format, _m->type, nullptr);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        
+        // The buffer holds only level 0, so other levels are generated from
+        // it.
+        
+        if (texture.levelCount() > 1)
+            glGenerateMipmap(GL_TEXTURE_2D);
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        _m->fences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        
+        // Make certain Texture::isBound() does not incorrectly return true for
+        // another texture.
+        
+        texture.unbind();
+    }
+    
+    void TextureStream::upload(const ImageView& frame)
+    {
+        if ((frame.width() != _m->width) || (frame.height() != _m->height) ||
+            (frame.bytesPerPixel() != _m->bytesPerPixel))
+        {
+            throw std::invalid_argument("Agl::TextureStream::upload(): the "
+                                        "frame's size does not match");
+        }
+        
+        MutableImageView buffer = acquire();
+        if (frame.isPacked())
+        {
+            memcpy(buffer.data(), frame.data(), size_t(_m->bufferSize));
+        }
+        else
+        {
+            const size_t rowSize = size_t(_m->width) * _m->bytesPerPixel;
+            for (GLsizei y = 0; y < _m->height; ++y)
+                memcpy(buffer.row(y), frame.row(y), rowSize);
+        }
+        submit();
+    }
+    
+    void TextureStream::upload(PooledImage&& frame)
+    {
+        PooledImage image(std::move(frame));
+        upload(ImageView(image.view()));
+    }
+    
+    size_t TextureStream::waitCount() const
+    {
+        return _m->waitCount;
+    }
+    
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglTextureStream.h
+//
+// A class to stream frames into an Agl::TextureUbyte through a ring of pixel
+// unpack buffers, so the upload overlaps with rendering instead of blocking
+// the render thread while the driver copies the frame from client memory, as
+// TextureUbyte::setData() does.  Each frame is written into a mapped buffer
+// (directly by the producer, or by copying), and the upload from the buffer
+// into the texture is then queued, with a fence sync object marking when the
+// driver has finished reading the buffer.  A buffer is reused only once its
+// fence signals, so with N buffers, frame N + 1 can be written while the
+// previous frames are still being consumed.
+//
+
+#ifndef __AglTextureStream__
+#define __AglTextureStream__
+
+#include "AglImageView.h"
+#include <OpenGL/gl3.h>
+#include <memory>
+
+namespace Agl
+{
+    class PooledImage;
+    class TextureUbyte;
+    
+    class TextureStream
+    {
+    public:
+        
+        // Create a stream of frames of the specified size into the texture,
+        // which must have been built and must outlive the stream, with the
+        // internal format, format and type arguments as for
+        // TextureUbyte::setData().  The texture's storage is allocated here,
+        // and should not be changed by setData() while the stream is used.
+        // If bufferCount is 0, a std::invalid_argument exception is thrown.
+        // The OpenGL context must be current, as for the other routines.
+        
+        TextureStream(TextureUbyte& texture, GLsizei width, GLsizei height,
+                      GLsizei bytesPerPixel = 4, size_t bufferCount = 3,
+                      GLint internalFormat = GL_RGBA, GLenum format = GL_RGBA,
+                      GLenum type = GL_UNSIGNED_BYTE);
+        ~TextureStream();
+        
+        GLsizei         width() const;
+        GLsizei         height() const;
+        GLsizei         bytesPerPixel() const;
+        size_t          bufferCount() const;
+        
+        // Map the next buffer of the ring for writing, and return a packed
+        // view of it.  If the driver has not finished reading the buffer
+        // for an earlier frame, this routine waits until it has.  The view's
+        // memory may be written on any thread until submit() is called,
+        // which lets a producer write a frame (e.g., convert a camera image)
+        // directly into the buffer.  If a buffer is already acquired, a
+        // std::runtime_error exception is thrown.
+        
+        MutableImageView    acquire();
+        
+        // Unmap the acquired buffer and queue the upload from it into the
+        // texture, followed by its fence.  If no buffer is acquired, a
+        // std::runtime_error exception is thrown.
+        
+        void            submit();
+        
+        // Acquire a buffer, copy a frame into it, and submit it.  If the
+        // frame's size differs from the stream's, a std::invalid_argument
+        // exception is thrown.  The version taking a PooledImage returns the
+        // image to its pool once the copy is done, since the upload reads
+        // only the buffer.
+        
+        void            upload(const ImageView& frame);
+        void            upload(PooledImage&& frame);
+        
+        // The number of times acquire() had to wait for the driver to finish
+        // with a buffer, which suggests more buffers would help.
+        
+        size_t          waitCount() const;
+        
+    private:
+        
+        TextureStream(const TextureStream&) = delete;
+        TextureStream&  operator=(const TextureStream&) = delete;
+        
+        // Details of the class' data are hidden in the .cpp file.
+        
+        class Imp;
+        std::unique_ptr<Imp> _m;
+    };
+}
+
+#endif
@@ -25,6 +25,84 @@
 //
 
 #include "AglTextureUbyte.h"
+#include "AglTileChangeDetector.h"
+#include "AglUploadFormat.h"
+#include "AglUtilities.h"
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+    
+    // The GL_UNPACK_ALIGNMENT for rows of pixels of the type.  Rows are
+    // packed tightly, as in an Agl::ImageView (a row length of pixels, with no
+    // padding), so for bytes and the 16-bit types, a row need not be a
+    // multiple of 4 bytes (e.g., an RGB image of odd width).
+    
+    GLint unpackAlignment(GLenum type)
+    {
+        switch (type)
+        {
+            case GL_UNSIGNED_BYTE:
+                return 1;
+            case GL_UNSIGNED_SHORT_5_6_5:
+            case GL_UNSIGNED_SHORT_5_6_5_REV:
+            case GL_UNSIGNED_SHORT_4_4_4_4:
+            case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+            case GL_UNSIGNED_SHORT_5_5_5_1:
+            case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+                return 2;
+            default:
+                return 4;
+        }
+    }
+    
+    // The bytes per pixel of data that can be reduced a byte at a time, for
+    // Agl::generateImagePyramid(), or 0 if it cannot.
+    
+    GLsizei reducibleBytesPerPixel(GLenum format, GLenum type)
+    {
+        if (type == GL_UNSIGNED_INT_8_8_8_8_REV)
+            return ((format == GL_RGBA) || (format == GL_BGRA)) ? 4 : 0;
+        if (type != GL_UNSIGNED_BYTE)
+            return 0;
+        
+        switch (format)
+        {
+            case GL_RED:
+                return 1;
+            case GL_RG:
+                return 2;
+            case GL_RGB:
+            case GL_BGR:
+                return 3;
+            case GL_RGBA:
+            case GL_BGRA:
+                return 4;
+            default:
+                return 0;
+        }
+    }
+    
+    // The number of mipmap levels that halve both the width and height down
+    // to at least 1, as in Agl::generateImagePyramid(), plus level 0.
+    
+    GLsizei mipmapLevelCount(GLsizei width, GLsizei height)
+    {
+        GLsizei count = 1;
+        while (((width >> count) > 0) && ((height >> count) > 0))
+            ++count;
+        return count;
+    }
+    
+    // The number of uploads of the whole image that MipmapAutomatic times
+    // with each method before choosing.
+    
+    const int automaticSamples = 3;
+    
+}
 
 namespace Agl
 {
@@ -32,11 +110,99 @@ namespace Agl
     class TextureUbyte::Imp
     {
     public:
-        Imp() : width(0), height(0) {}
+        Imp() : width(0), height(0), internalFormat(0), format(0), type(0),
+            policy(MipmapNone), chosen(MipmapAutomatic), generateSamples(0),
+            pyramidSamples(0), generateTime(0), pyramidTime(0) {}
         GLsizei     width;
         GLsizei     height;
+        GLint       internalFormat;
+        GLenum      format;
+        GLenum      type;
+        
+        // The changes since the frame last passed to updateData(), or null
+        // if setData() was called since then.
+        
+        std::unique_ptr<TileChangeDetector> detector;
+        
+        // The mipmap policy, and for MipmapAutomatic, the method chosen (or
+        // MipmapAutomatic until then) and the fastest times measured so far.
+        
+        MipmapPolicy                        policy;
+        MipmapPolicy                        chosen;
+        int                                 generateSamples;
+        int                                 pyramidSamples;
+        std::chrono::steady_clock::duration generateTime;
+        std::chrono::steady_clock::duration pyramidTime;
+        
+        // For MipmapPyramid, the levels after level 0 from the last upload,
+        // as from generateImagePyramid(), and a region being reduced.
+        
+        std::vector<GLubyte>                pyramid;
+        std::vector<GLubyte>                scratch;
+        
+        // The method for filling the levels of an image with the format and
+        // type, and for MipmapAutomatic, the one to time next.
+        
+        MipmapPolicy                        method(GLenum format, GLenum type) const;
+        
+        // Whether MipmapAutomatic is still timing the methods for the format
+        // and type.
+        
+        bool                                sampling(GLenum format, GLenum type) const;
+        
+        // Record the time taken by a method, choosing one when there are
+        // enough samples.
+        
+        void                                addSample(MipmapPolicy method,
+                                                      std::chrono::steady_clock::duration time);
     };
     
+    TextureUbyte::MipmapPolicy TextureUbyte::Imp::method(GLenum format,
+                                                         GLenum type) const
+    {
+        if (policy == MipmapNone)
+            return MipmapNone;
+        if (reducibleBytesPerPixel(format, type) == 0)
+            return MipmapGenerate;
+        if (policy != MipmapAutomatic)
+            return policy;
+        if (chosen != MipmapAutomatic)
+            return chosen;
+        
+        return (generateSamples <= pyramidSamples) ? MipmapGenerate :
+                                                     MipmapPyramid;
+    }
+    
+    bool TextureUbyte::Imp::sampling(GLenum format, GLenum type) const
+    {
+        return (policy == MipmapAutomatic) && (chosen == MipmapAutomatic) &&
+               (reducibleBytesPerPixel(format, type) != 0);
+    }
+    
+    void TextureUbyte::Imp::addSample(MipmapPolicy method,
+                                      std::chrono::steady_clock::duration time)
+    {
+        if (method == MipmapGenerate)
+        {
+            if ((generateSamples == 0) || (time < generateTime))
+                generateTime = time;
+            ++generateSamples;
+        }
+        else
+        {
+            if ((pyramidSamples == 0) || (time < pyramidTime))
+                pyramidTime = time;
+            ++pyramidSamples;
+        }
+        
+        if ((generateSamples >= automaticSamples) &&
+            (pyramidSamples >= automaticSamples))
+        {
+            chosen = (pyramidTime < generateTime) ? MipmapPyramid :
+                                                    MipmapGenerate;
+        }
+    }
+    
     TextureUbyte::TextureUbyte(GLenum target) :
         Texture(target), _m(new Imp)
     {
@@ -46,32 +212,236 @@ namespace Agl
     {
     }
     
+    void TextureUbyte::setMipmapPolicy(MipmapPolicy policy)
+    {
+        if (policy != _m->policy)
+        {
+            _m->policy = policy;
+            _m->chosen = MipmapAutomatic;
+            _m->generateSamples = 0;
+            _m->pyramidSamples = 0;
+            _m->detector.reset();
+            _m->pyramid.clear();
+        }
+    }
+    
+    TextureUbyte::MipmapPolicy TextureUbyte::mipmapPolicy() const
+    {
+        return _m->policy;
+    }
+    
+    TextureUbyte::MipmapPolicy TextureUbyte::mipmapMethod() const
+    {
+        if ((_m->policy == MipmapAutomatic) && (_m->chosen != MipmapAutomatic))
+            return _m->chosen;
+        return _m->policy;
+    }
+    
     void TextureUbyte::setData(GLubyte* data, GLsizei width, GLsizei height,
                                GLint internalFormat, GLenum format,
-                               GLint rowLength, GLint skipPixels, GLint skipRows)
+                               GLint rowLength, GLint skipPixels, GLint skipRows,
+                               GLenum type)
     {
+        if (type == 0)
+            type = preferredUploadType(format, internalFormat);
+        
         _m->width = width;
         _m->height = height;
+        _m->internalFormat = internalFormat;
+        _m->format = format;
+        _m->type = type;
+        _m->detector.reset();
     
-        glBindTexture(target(), id());
+        MipmapPolicy method = _m->method(format, type);
+        GLsizei levelCount = (method == MipmapNone) ? 1 :
+                             mipmapLevelCount(width, height);
         
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
-        glPixelStorei(GL_UNPACK_SKIP_PIXELS, skipPixels);
-        glPixelStorei(GL_UNPACK_SKIP_ROWS, skipRows);
+        GLint alignment = unpackAlignment(type);
+        if (alignment != 4)
+            glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
         
-        // TODO: Replace with glTexStorage2D() and glTexSubImage2D(), when
-        // the former becomes available on OS X.
+        setImage(internalFormat, width, height, format, type, data,
+                 rowLength, skipPixels, skipRows, levelCount);
         
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        if (alignment != 4)
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
         
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0,
-                     format, GL_UNSIGNED_BYTE, data);
+        if ((levelCount == 1) || !data)
+            return;
         
-        // Make certain Texture::isBound() does not incorrectly return true for
-        // another texture.
-
-        unbind();
+        // For MipmapAutomatic, time only the filling of the levels, after the
+        // upload of level 0 and earlier commands have finished.
+        
+        bool timing = _m->sampling(format, type);
+        std::chrono::steady_clock::time_point start;
+        if (timing)
+        {
+            glFinish();
+            start = std::chrono::steady_clock::now();
+        }
+        
+        if (method == MipmapGenerate)
+        {
+            generateMipmap();
+            _m->pyramid.clear();
+        }
+        else
+        {
+            GLsizei bytesPerPixel = reducibleBytesPerPixel(format, type);
+            _m->pyramid.resize(imagePyramidSize(width, height, bytesPerPixel,
+                                                levelCount - 1));
+            generateImagePyramid(_m->pyramid.data(), levelCount - 1, data,
+                                 width, height, bytesPerPixel, rowLength,
+                                 skipPixels, skipRows);
+            
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (GLsizei level = 1; level < levelCount; ++level)
+            {
+                setImageLevel(level, 0, 0, width >> level, height >> level,
+                              format, type, _m->pyramid.data(), width / 2, 0,
+                              imagePyramidSkipRows(height, level));
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+        
+        if (timing)
+        {
+            glFinish();
+            _m->addSample(method, std::chrono::steady_clock::now() - start);
+        }
+    }
+    
+    void TextureUbyte::setData(const ImageView& view, GLint internalFormat,
+                               GLenum format, GLenum type)
+    {
+        setData(const_cast<GLubyte*>(view.data()), view.width(), view.height(),
+                internalFormat, format, view.rowLength(), view.skipPixels(),
+                view.skipRows(), type);
+    }
+    
+    size_t TextureUbyte::updateData(const ImageView& view, GLint internalFormat,
+                                    GLenum format, GLenum type)
+    {
+        if (type == 0)
+            type = preferredUploadType(format, internalFormat);
+        
+        MipmapPolicy method = _m->method(format, type);
+        
+        // The pyramid must be rebuilt from the whole image if the levels were
+        // last generated otherwise, and MipmapAutomatic times only uploads of
+        // the whole image.
+        
+        bool pyramidStale = (method == MipmapPyramid) && _m->pyramid.empty();
+        
+        if (!_m->detector || (view.width() != _m->width) ||
+            (view.height() != _m->height) ||
+            (internalFormat != _m->internalFormat) || (format != _m->format) ||
+            (type != _m->type) ||
+            pyramidStale || _m->sampling(format, type))
+        {
+            setData(view, internalFormat, format, type);
+            _m->detector.reset(new TileChangeDetector);
+            _m->detector->update(view);
+            return _m->detector->tileCount();
+        }
+        
+        const std::vector<TileChangeDetector::Region>& regions =
+            _m->detector->update(view);
+        if (regions.empty())
+            return 0;
+        
+        // Each region is a subregion of the view, so the skips locate it
+        // within the view's memory, which needs an explicit row length.
+        
+        GLint rowLength = (view.rowLength() != 0) ? view.rowLength() : view.width();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment(type));
+        
+        for (const TileChangeDetector::Region& region : regions)
+        {
+            setImageLevel(0, region.x, region.y, region.width, region.height,
+                          format, type, view.data(), rowLength,
+                          view.skipPixels() + region.x,
+                          view.skipRows() + region.y);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        
+        if (method == MipmapGenerate)
+        {
+            generateMipmap();
+            _m->pyramid.clear();
+        }
+        else if (method == MipmapPyramid)
+        {
+            // Reduce each region level by level, widened to even coordinates
+            // in the level above so its pixels reduce exactly as they did in
+            // the whole pyramid.  Level n - 1 is the view for n = 1 and
+            // otherwise a level of the pyramid, which has a row length of
+            // half the width.
+            
+            const GLsizei bytesPerPixel = reducibleBytesPerPixel(format, type);
+            const GLsizei pyramidRowLength = _m->width / 2;
+            const size_t pyramidRowSize = size_t(pyramidRowLength) *
+                                          bytesPerPixel;
+            const GLsizei levelCount = this->levelCount();
+            
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (const TileChangeDetector::Region& region : regions)
+            {
+                GLsizei x0 = region.x;
+                GLsizei y0 = region.y;
+                GLsizei x1 = region.x + region.width;
+                GLsizei y1 = region.y + region.height;
+                
+                for (GLsizei level = 1; level < levelCount; ++level)
+                {
+                    const GLsizei levelWidth = _m->width >> level;
+                    const GLsizei levelHeight = _m->height >> level;
+                    x0 = x0 / 2;
+                    y0 = y0 / 2;
+                    x1 = std::min((x1 + 1) / 2, levelWidth);
+                    y1 = std::min((y1 + 1) / 2, levelHeight);
+                    if ((x0 >= x1) || (y0 >= y1))
+                        break;
+                    const GLsizei w = x1 - x0;
+                    const GLsizei h = y1 - y0;
+                    
+                    _m->scratch.resize(size_t(w) * h * bytesPerPixel);
+                    if (level == 1)
+                    {
+                        reduceImageBy2(_m->scratch.data(), view.data(), 2 * w,
+                                       2 * h, bytesPerPixel, rowLength,
+                                       view.skipPixels() + 2 * x0,
+                                       view.skipRows() + 2 * y0);
+                    }
+                    else
+                    {
+                        reduceImageBy2(_m->scratch.data(), _m->pyramid.data(),
+                                       2 * w, 2 * h, bytesPerPixel,
+                                       pyramidRowLength, 2 * x0,
+                                       imagePyramidSkipRows(_m->height,
+                                                            level - 1) +
+                                       2 * y0);
+                    }
+                    
+                    const GLsizei skipRows =
+                        imagePyramidSkipRows(_m->height, level) + y0;
+                    for (GLsizei y = 0; y < h; ++y)
+                    {
+                        memcpy(_m->pyramid.data() +
+                               (skipRows + y) * pyramidRowSize +
+                               size_t(x0) * bytesPerPixel,
+                               _m->scratch.data() + size_t(y) * w * bytesPerPixel,
+                               size_t(w) * bytesPerPixel);
+                    }
+                    
+                    setImageLevel(level, x0, y0, w, h, format, type,
+                                  _m->scratch.data(), 0, 0, 0);
+                }
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+        
+        return _m->detector->changedTileCount();
     }
     
     GLsizei TextureUbyte::width() const
@@ -85,5 +455,3 @@ namespace Agl
     }
 
 }
-
-
@@ -31,6 +31,7 @@
 #define __AglTextureUbyte__
 
 #include "AglTexture.h"
+#include "AglImageView.h"
 #include <OpenGL/gl3.h>
 
 namespace Agl
@@ -45,22 +46,111 @@ namespace Agl
         
         TextureUbyte(GLenum target);
         virtual ~TextureUbyte();
+        
+        // How setData() and updateData() fill mipmap levels, so a surface
+        // that is small on screen samples a correspondingly small level
+        // instead of the full frame, which thrashes the texture cache and
+        // aliases.
+        
+        enum MipmapPolicy
+        {
+            // Only level 0, the default.
+            
+            MipmapNone,
+            
+            // All the levels the size allows (down to a width or height of 1),
+            // filled by glGenerateMipmap() after each upload.
+            
+            MipmapGenerate,
+            
+            // All the levels the size allows, reduced on the CPU by
+            // Agl::generateImagePyramid() and uploaded like level 0.  For
+            // updateData(), only the changed regions of each level are
+            // reduced, by Agl::reduceImageBy2(), and uploaded.  The levels are
+            // kept in memory for that purpose.  This policy works only for
+            // 8-bit components (a type of GL_UNSIGNED_BYTE, or
+            // GL_UNSIGNED_INT_8_8_8_8_REV with GL_RGBA or GL_BGRA), and
+            // MipmapGenerate is used for other data.
+            
+            MipmapPyramid,
+            
+            // Time MipmapGenerate and MipmapPyramid for the first few uploads
+            // of the whole image (waiting for each to finish with glFinish()),
+            // then use the cheaper for this texture.
+            
+            MipmapAutomatic
+        };
+        
+        // Set the policy, which takes effect at the next setData() or
+        // updateData().  The minification filter is set to
+        // GL_LINEAR_MIPMAP_LINEAR when mipmapped storage is allocated, and can
+        // be changed after that.
+        
+        void            setMipmapPolicy(MipmapPolicy policy);
+        MipmapPolicy    mipmapPolicy() const;
+        
+        // The way the levels are actually being filled: MipmapNone,
+        // MipmapGenerate or MipmapPyramid, or MipmapAutomatic while
+        // MipmapAutomatic is still timing the alternatives.
+        
+        MipmapPolicy    mipmapMethod() const;
 
         // Set the data of the texture.  Note that the mipmapping is disabled
-        // for the texture, so only one piece of data is necessary (which makes
-        // sense forthe Facetious application since the data is being updated
-        // repeatedly from the video camera).  Note a format arguments have the
-        // same meanings as for glTexImage2D().  The rowLength, skipPixels and
-        // skipRows arguments set the GL_UNPACK_ROW_LENGTH, GL_UNPACK_SKIP_PIXELS
-        // and GL_UNPACK_SKIP_ROWS parameters, respectively, allowing the texture to
-        // be set from a smaller region within the data argument (if the arguments
-        // have values otherthan their default values of 0).
+        // for the texture unless a mipmap policy is set, so only one piece of
+        // data is necessary (which makes sense forthe Facetious application
+        // since the data is being updated repeatedly from the video camera).
+        // Note a format arguments have the same meanings as for
+        // glTexImage2D().  The rowLength, skipPixels and skipRows arguments
+        // set the GL_UNPACK_ROW_LENGTH, GL_UNPACK_SKIP_PIXELS and
+        // GL_UNPACK_SKIP_ROWS parameters, respectively, allowing the texture
+        // to be set from a smaller region within the data argument (if the
+        // arguments have values otherthan their default values of 0).  The
+        // texture's storage is allocated only when the size or internal
+        // format changes, and otherwise the data is copied into it, so
+        // streaming frames of one size does not reallocate the texture each
+        // frame.  Rows are taken to be packed tightly, as in an
+        // Agl::ImageView, so with a type of GL_UNSIGNED_BYTE the unpack
+        // alignment is 1, and an RGB image of odd width needs no padding.  The
+        // type argument is as for glTexImage2D(), allowing data in a packed
+        // format like GL_UNSIGNED_SHORT_5_6_5 or GL_UNSIGNED_SHORT_1_5_5_5_REV
+        // (with two bytes per pixel, and a sized internal format like
+        // GL_RGB5_A1).  A type of 0 means Agl::preferredUploadType() for the
+        // format and internal format, which for GL_RGBA or GL_BGRA is
+        // whichever of GL_UNSIGNED_BYTE and GL_UNSIGNED_INT_8_8_8_8_REV the
+        // driver uploads faster; the first such call for a format measures
+        // the upload, so it is better made at startup than for the first
+        // frame.
         
         void    setData(GLubyte* data, GLsizei width, GLsizei height,
                         GLint internalFormat = GL_RGBA,
                         GLenum format = GL_RGBA,
                         GLint rowLength = 0, GLint skipPixels = 0,
-                        GLint skipRows = 0);
+                        GLint skipRows = 0, GLenum type = GL_UNSIGNED_BYTE);
+        
+        // Set the data from a view, whose parameters take the place of the
+        // data, width, height, rowLength, skipPixels and skipRows arguments.
+        
+        void    setData(const ImageView& view, GLint internalFormat = GL_RGBA,
+                        GLenum format = GL_RGBA,
+                        GLenum type = GL_UNSIGNED_BYTE);
+        
+        // Set the data from a view, as above, but upload with
+        // glTexSubImage2D() only the tiles that changed since the previous
+        // call, and nothing at all if none changed, which saves most of the
+        // upload bandwidth for a mostly static scene.  The first call, or a
+        // call with a different size, internal format, format or type,
+        // uploads the whole image.  The changes are found by an
+        // Agl::TileChangeDetector with 64 by 64 tiles, which keeps a copy of
+        // the previous frame, so for content that changes everywhere in every
+        // frame, setData() is cheaper.  Calling setData() makes the next call
+        // upload the whole image.  With mipmaps, the changed regions of the
+        // other levels are updated as the mipmap policy specifies.  Returns
+        // the number of tiles uploaded.
+        
+        size_t  updateData(const ImageView& view,
+                           GLint internalFormat = GL_RGBA,
+                           GLenum format = GL_RGBA,
+                           GLenum type = GL_UNSIGNED_BYTE);
         
         // Access the dimensions of the texture.
         
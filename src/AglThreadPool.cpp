@@ -0,0 +1,196 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglThreadPool.cpp
+//
+
+#include "AglThreadPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Agl
+{
+    
+    namespace
+    {
+        // True on a worker thread, and on any thread while it is running tasks,
+        // so nested calls to run() can be detected.
+        
+        thread_local bool runningTasks = false;
+    }
+    
+    class ThreadPool::Imp
+    {
+    public:
+        Imp() : task(0), taskCount(0), nextTask(0), unfinished(0),
+            generation(0), activeWorkers(0), stopping(false) {}
+        
+        void                    workerLoop();
+        void                    runTasks();
+        
+        std::vector<std::thread> workers;
+        
+        // Serializes calls to run().
+        
+        std::mutex              runMutex;
+        
+        // The current batch of tasks.  Threads claim task indices from nextTask
+        // and decrement unfinished as they complete them.  The task and
+        // taskCount change only when no worker is active.
+        
+        const std::function<void(size_t)>* task;
+        size_t                  taskCount;
+        std::atomic<size_t>     nextTask;
+        std::atomic<size_t>     unfinished;
+        
+        // Protects the remaining members.  Workers wait for generation to
+        // change, which means a new batch has started, and count themselves in
+        // activeWorkers while they work on it.
+        
+        std::mutex              mutex;
+        std::condition_variable workAvailable;
+        std::condition_variable workFinished;
+        size_t                  generation;
+        size_t                  activeWorkers;
+        bool                    stopping;
+    };
+    
+    void ThreadPool::Imp::runTasks()
+    {
+        for (;;)
+        {
+            size_t i = nextTask.fetch_add(1);
+            if (i >= taskCount)
+                break;
+            
+            (*task)(i);
+            
+            if (unfinished.fetch_sub(1) == 1)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                workFinished.notify_all();
+            }
+        }
+    }
+    
+    void ThreadPool::Imp::workerLoop()
+    {
+        runningTasks = true;
+        size_t seen = 0;
+        
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                workAvailable.wait(lock, [&]{ return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                ++activeWorkers;
+            }
+            
+            runTasks();
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--activeWorkers == 0)
+                    workFinished.notify_all();
+            }
+        }
+    }
+    
+    ThreadPool::ThreadPool(size_t threadCount) :
+        _m(new Imp)
+    {
+        if (threadCount == 0)
+        {
+            size_t hardware = std::thread::hardware_concurrency();
+            threadCount = (hardware > 1) ? hardware - 1 : 0;
+        }
+        
+        for (size_t i = 0; i < threadCount; ++i)
+            _m->workers.push_back(std::thread(&Imp::workerLoop, _m.get()));
+    }
+    
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_m->mutex);
+            _m->stopping = true;
+        }
+        _m->workAvailable.notify_all();
+        
+        for (std::thread& worker : _m->workers)
+            worker.join();
+    }
+    
+    size_t ThreadPool::threadCount() const
+    {
+        return _m->workers.size();
+    }
+    
+    void ThreadPool::run(size_t taskCount,
+                         const std::function<void(size_t)>& task)
+    {
+        if ((taskCount <= 1) || _m->workers.empty() || runningTasks)
+        {
+            for (size_t i = 0; i < taskCount; ++i)
+                task(i);
+            return;
+        }
+        
+        std::lock_guard<std::mutex> runLock(_m->runMutex);
+        
+        {
+            // A worker that woke late for the previous batch may still be
+            // looking at it, so wait for it before replacing the batch.
+            
+            std::unique_lock<std::mutex> lock(_m->mutex);
+            _m->workFinished.wait(lock, [&]{ return _m->activeWorkers == 0; });
+            
+            _m->task = &task;
+            _m->taskCount = taskCount;
+            _m->nextTask = 0;
+            _m->unfinished = taskCount;
+            ++_m->generation;
+        }
+        _m->workAvailable.notify_all();
+        
+        runningTasks = true;
+        _m->runTasks();
+        runningTasks = false;
+        
+        std::unique_lock<std::mutex> lock(_m->mutex);
+        _m->workFinished.wait(lock, [&]{ return _m->unfinished == 0; });
+    }
+    
+    ThreadPool& ThreadPool::shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+    
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglThreadPool.h
+//
+// A class to run a number of independent tasks on a set of worker threads
+// that is created once and reused.  The image utilities use it to process
+// bands of an image in parallel without the cost of creating threads each
+// time.
+//
+
+#ifndef __AglThreadPool__
+#define __AglThreadPool__
+
+#include <functional>
+#include <memory>
+
+namespace Agl
+{
+    
+    class ThreadPool
+    {
+    public:
+        
+        // Create a pool with the specified number of worker threads.  A
+        // threadCount of 0 means one fewer than the number of hardware
+        // threads, since the thread calling run() also does work.
+        
+        ThreadPool(size_t threadCount = 0);
+        ~ThreadPool();
+        
+        // Access the number of worker threads.
+        
+        size_t      threadCount() const;
+        
+        // Call task(i) for every i from 0 to taskCount - 1, and return when
+        // all the calls have finished.  The calls are spread across the worker
+        // threads and the calling thread, in no particular order.  Calls to
+        // run() from different threads are serialized.  A call to run() from
+        // within a task runs the nested tasks on the calling thread, to avoid
+        // deadlock.  The tasks must not throw exceptions.
+        
+        void        run(size_t taskCount, const std::function<void(size_t)>& task);
+        
+        // A pool shared by the Agl image utilities, created on first use with
+        // the default number of threads.
+        
+        static ThreadPool&  shared();
+        
+    private:
+        
+        // Details of the class' data are hidden in the .cpp file.
+        // This pattern also prevents instances from being copied, which makes
+        // sense because copies would share the worker threads.
+        
+        class Imp;
+        std::unique_ptr<Imp> _m;
+    };
+    
+}
+
+#endif
@@ -0,0 +1,292 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglTileChangeDetector.cpp
+//
+
+#include "AglTileChangeDetector.h"
+#include "AglImageView.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AGL_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define AGL_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    
+    // Return true if the n bytes at a and b differ.  The SIMD paths
+    // accumulate the differences without branching, and test them once at
+    // the end, since a tile row is short and usually unchanged.
+    
+    bool bytesDiffer(const GLubyte* a, const GLubyte* b, size_t n)
+    {
+        size_t i = 0;
+        
+#if defined(AGL_SIMD_X86)
+        __m128i d0 = _mm_setzero_si128();
+        __m128i d1 = _mm_setzero_si128();
+        for (; i + 32 <= n; i += 32)
+        {
+            d0 = _mm_or_si128(d0, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+            d1 = _mm_or_si128(d1, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)),
+                                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16))));
+        }
+        for (; i + 16 <= n; i += 16)
+        {
+            d0 = _mm_or_si128(d0, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+        }
+        __m128i d = _mm_or_si128(d0, d1);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(d, _mm_setzero_si128())) != 0xffff)
+            return true;
+#elif defined(AGL_SIMD_NEON)
+        uint8x16_t d = vdupq_n_u8(0);
+        for (; i + 16 <= n; i += 16)
+            d = vorrq_u8(d, veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+        uint64x2_t d64 = vreinterpretq_u64_u8(d);
+        if ((vgetq_lane_u64(d64, 0) | vgetq_lane_u64(d64, 1)) != 0)
+            return true;
+#endif
+        
+        for (; i < n; ++i)
+        {
+            if (a[i] != b[i])
+                return true;
+        }
+        return false;
+    }
+    
+}
+
+namespace Agl
+{
+    
+    class TileChangeDetector::Imp
+    {
+    public:
+        Imp(GLsizei tileWidth, GLsizei tileHeight);
+        
+        GLsizei                 tileWidth;
+        GLsizei                 tileHeight;
+        
+        // The previous frame, packed, and its size.
+        
+        std::vector<GLubyte>    previous;
+        GLsizei                 width;
+        GLsizei                 height;
+        GLsizei                 bytesPerPixel;
+        bool                    hasPrevious;
+        
+        std::vector<Region>     regions;
+        size_t                  changedTileCount;
+        
+        // Whether each tile in the current row of tiles changed.
+        
+        std::vector<char>       changed;
+        
+        size_t                  tileColumnCount() const;
+        size_t                  tileRowCount() const;
+        
+        // Copy the rows of a region of the frame into the previous frame.
+        
+        void                    copyRegion(const ImageView& frame,
+                                           const Region& region);
+    };
+    
+    TileChangeDetector::Imp::Imp(GLsizei tileWidth, GLsizei tileHeight) :
+        tileWidth(tileWidth), tileHeight(tileHeight), width(0), height(0),
+        bytesPerPixel(0), hasPrevious(false), changedTileCount(0)
+    {
+    }
+    
+    size_t TileChangeDetector::Imp::tileColumnCount() const
+    {
+        return (width + tileWidth - 1) / tileWidth;
+    }
+    
+    size_t TileChangeDetector::Imp::tileRowCount() const
+    {
+        return (height + tileHeight - 1) / tileHeight;
+    }
+    
+    void TileChangeDetector::Imp::copyRegion(const ImageView& frame,
+                                             const Region& region)
+    {
+        const size_t rowSize = size_t(width) * bytesPerPixel;
+        const size_t offset = size_t(region.x) * bytesPerPixel;
+        const size_t size = size_t(region.width) * bytesPerPixel;
+        for (GLsizei y = region.y; y < region.y + region.height; ++y)
+            memcpy(&previous[y * rowSize + offset], frame.row(y) + offset, size);
+    }
+    
+    TileChangeDetector::Region::Region() :
+        x(0), y(0), width(0), height(0)
+    {
+    }
+    
+    TileChangeDetector::Region::Region(GLsizei x, GLsizei y, GLsizei width,
+                                       GLsizei height) :
+        x(x), y(y), width(width), height(height)
+    {
+    }
+    
+    TileChangeDetector::TileChangeDetector(GLsizei tileWidth,
+                                           GLsizei tileHeight)
+    {
+        if ((tileWidth <= 0) || (tileHeight <= 0))
+        {
+            throw std::invalid_argument("Agl::TileChangeDetector(): the tile "
+                                        "size must be positive");
+        }
+        _m.reset(new Imp(tileWidth, tileHeight));
+    }
+    
+    TileChangeDetector::~TileChangeDetector()
+    {
+    }
+    
+    GLsizei TileChangeDetector::tileWidth() const
+    {
+        return _m->tileWidth;
+    }
+    
+    GLsizei TileChangeDetector::tileHeight() const
+    {
+        return _m->tileHeight;
+    }
+    
+    const std::vector<TileChangeDetector::Region>&
+    TileChangeDetector::update(const ImageView& frame)
+    {
+        _m->regions.clear();
+        
+        if (!_m->hasPrevious || (frame.width() != _m->width) ||
+            (frame.height() != _m->height) ||
+            (frame.bytesPerPixel() != _m->bytesPerPixel))
+        {
+            _m->width = frame.width();
+            _m->height = frame.height();
+            _m->bytesPerPixel = frame.bytesPerPixel();
+            _m->previous.resize(size_t(_m->width) * _m->height *
+                                _m->bytesPerPixel);
+            _m->hasPrevious = true;
+            _m->changedTileCount = tileCount();
+            
+            if (!frame.empty())
+            {
+                Region all(0, 0, _m->width, _m->height);
+                _m->copyRegion(frame, all);
+                _m->regions.push_back(all);
+            }
+            return _m->regions;
+        }
+        
+        _m->changedTileCount = 0;
+        
+        const size_t columnCount = _m->tileColumnCount();
+        const size_t rowSize = size_t(_m->width) * _m->bytesPerPixel;
+        const size_t tileSize = size_t(_m->tileWidth) * _m->bytesPerPixel;
+        _m->changed.resize(columnCount);
+        
+        for (GLsizei y0 = 0; y0 < _m->height; y0 += _m->tileHeight)
+        {
+            const GLsizei rows = std::min(_m->tileHeight, _m->height - y0);
+            std::fill(_m->changed.begin(), _m->changed.end(), 0);
+            size_t changedCount = 0;
+            
+            // Compare row by row, so each row of the frame is read in order,
+            // and stop comparing a tile once it is known to have changed.
+            
+            for (GLsizei y = y0; (y < y0 + rows) && (changedCount < columnCount);
+                 ++y)
+            {
+                const GLubyte* current = frame.row(y);
+                const GLubyte* previous = &_m->previous[y * rowSize];
+                for (size_t c = 0; c < columnCount; ++c)
+                {
+                    if (_m->changed[c])
+                        continue;
+                    size_t offset = c * tileSize;
+                    size_t size = std::min(tileSize, rowSize - offset);
+                    if (bytesDiffer(current + offset, previous + offset, size))
+                    {
+                        _m->changed[c] = 1;
+                        ++changedCount;
+                    }
+                }
+            }
+            
+            _m->changedTileCount += changedCount;
+            
+            // Merge runs of changed tiles into regions, and copy them.
+            
+            for (size_t c = 0; c < columnCount; )
+            {
+                if (!_m->changed[c])
+                {
+                    ++c;
+                    continue;
+                }
+                size_t end = c + 1;
+                while ((end < columnCount) && _m->changed[end])
+                    ++end;
+                
+                GLsizei x = GLsizei(c) * _m->tileWidth;
+                GLsizei right = std::min(GLsizei(end) * _m->tileWidth,
+                                         _m->width);
+                Region region(x, y0, right - x, rows);
+                _m->copyRegion(frame, region);
+                _m->regions.push_back(region);
+                c = end;
+            }
+        }
+        
+        return _m->regions;
+    }
+    
+    size_t TileChangeDetector::changedTileCount() const
+    {
+        return _m->changedTileCount;
+    }
+    
+    size_t TileChangeDetector::tileCount() const
+    {
+        return _m->tileColumnCount() * _m->tileRowCount();
+    }
+    
+    void TileChangeDetector::reset()
+    {
+        _m->hasPrevious = false;
+        _m->regions.clear();
+        _m->changedTileCount = 0;
+    }
+    
+}
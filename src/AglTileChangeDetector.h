@@ -0,0 +1,108 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglTileChangeDetector.h
+//
+// A class to find which tiles of an image changed since the previous frame,
+// so that only those tiles need to be uploaded to a texture (e.g., by
+// Agl::TextureUbyte::updateData()), and nothing at all when the frame is
+// unchanged.  Camera frames of a mostly static scene change in only a few
+// tiles, so this saves most of the upload bandwidth.  The detector keeps its
+// own copy of the previous frame, since the frame's memory is usually
+// recycled (e.g., by an Agl::ImagePool), and compares exactly, with SIMD
+// instructions, rather than by hashing, so a change is never missed.  The
+// changed tiles in each row of tiles are merged into runs, so fewer regions
+// are returned.
+//
+
+#ifndef __AglTileChangeDetector__
+#define __AglTileChangeDetector__
+
+#include <OpenGL/gl3.h>
+#include <memory>
+#include <vector>
+
+namespace Agl
+{
+    class ImageView;
+    
+    class TileChangeDetector
+    {
+    public:
+        
+        // Create a detector with tiles of the specified size, in pixels.  If
+        // either is not positive, a std::invalid_argument exception is
+        // thrown.
+        
+        TileChangeDetector(GLsizei tileWidth = 64, GLsizei tileHeight = 64);
+        ~TileChangeDetector();
+        
+        GLsizei         tileWidth() const;
+        GLsizei         tileHeight() const;
+        
+        // A region of the frame, in pixels, made of whole tiles (except at
+        // the right and bottom edges of the frame).
+        
+        struct Region
+        {
+            Region();
+            Region(GLsizei x, GLsizei y, GLsizei width, GLsizei height);
+            
+            GLsizei     x;
+            GLsizei     y;
+            GLsizei     width;
+            GLsizei     height;
+        };
+        
+        // Compare a frame with the previous frame passed to this routine, and
+        // return the regions that changed, which are empty if none did.  The
+        // first frame, and a frame whose width, height or bytes per pixel
+        // differ from the previous one, changed entirely.  The changed tiles
+        // are copied, so the detector is ready for the next frame.  The
+        // returned regions remain valid until the next call.
+        
+        const std::vector<Region>&  update(const ImageView& frame);
+        
+        // The number of tiles that changed in the last call to update(), and
+        // the number of tiles in a frame.
+        
+        size_t          changedTileCount() const;
+        size_t          tileCount() const;
+        
+        // Forget the previous frame, so the next frame changed entirely.
+        
+        void            reset();
+        
+    private:
+        
+        TileChangeDetector(const TileChangeDetector&) = delete;
+        TileChangeDetector& operator=(const TileChangeDetector&) = delete;
+        
+        // Details of the class' data are hidden in the .cpp file.
+        
+        class Imp;
+        std::unique_ptr<Imp> _m;
+    };
+}
+
+#endif
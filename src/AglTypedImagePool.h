@@ -0,0 +1,89 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglTypedImagePool.h
+//
+// A template class for an Agl::ImagePool whose images have components of type
+// T (e.g., GLushort, half or GLfloat for HDR images) rather than bytes.  The
+// memory is allocated and freed as T*, and the image size is given in
+// components per pixel.  The images come from an ordinary ImagePool, which is
+// available for the handles of AglPooledImage.h and for the statistics.  The
+// ImagePool aligns images at least to the size of a pointer, and thus
+// suitably for T.
+//
+
+#ifndef __AglTypedImagePool__
+#define __AglTypedImagePool__
+
+#include "AglImagePool.h"
+#include <OpenGL/gl3.h>
+
+namespace Agl
+{
+    template <class T>
+    class TypedImagePool
+    {
+    public:
+        
+        TypedImagePool();
+        
+        // Set the size of the images, as for ImagePool::setImageSize(), but
+        // with componentsPerPixel components of type T per pixel.
+        
+        void        setImageSize(GLsizei width, GLsizei height,
+                                 GLsizei componentsPerPixel,
+                                 const ImagePool::Options& options =
+                                     ImagePool::Options());
+        
+        // Access the size of the images managed by this class.
+        
+        GLsizei     imageWidth() const;
+        GLsizei     imageHeight() const;
+        GLsizei     componentsPerPixel() const;
+        
+        // Obtain image memory from the pool, and return it, as for
+        // ImagePool::alloc() and ImagePool::free().
+        
+        T*          alloc();
+        void        free(T* image);
+        
+        // Access the underlying pool, whose images are the same memory viewed
+        // as bytes.
+        
+        ImagePool&  pool();
+        
+    private:
+        
+        TypedImagePool(const TypedImagePool&) = delete;
+        TypedImagePool& operator=(const TypedImagePool&) = delete;
+        
+        ImagePool   _pool;
+    };
+}
+
+// The template definitions in the following header file should be considered
+// private implementation details.
+
+#include "AglTypedImagePoolImp.h"
+
+#endif
@@ -0,0 +1,87 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglTypedImagePoolImp.h
+//
+// The template definitions in the this header file should be considered
+// private implementation details.
+//
+
+#ifndef __AglTypedImagePoolImp__
+#define __AglTypedImagePoolImp__
+
+namespace Agl
+{
+    template <class T>
+    TypedImagePool<T>::TypedImagePool()
+    {
+    }
+    
+    template <class T>
+    void TypedImagePool<T>::setImageSize(GLsizei width, GLsizei height,
+                                         GLsizei componentsPerPixel,
+                                         const ImagePool::Options& options)
+    {
+        _pool.setImageSize(width, height,
+                           componentsPerPixel * GLsizei(sizeof(T)), options);
+    }
+    
+    template <class T>
+    GLsizei TypedImagePool<T>::imageWidth() const
+    {
+        return _pool.imageWidth();
+    }
+    
+    template <class T>
+    GLsizei TypedImagePool<T>::imageHeight() const
+    {
+        return _pool.imageHeight();
+    }
+    
+    template <class T>
+    GLsizei TypedImagePool<T>::componentsPerPixel() const
+    {
+        return _pool.bytesPerPixel() / GLsizei(sizeof(T));
+    }
+    
+    template <class T>
+    T* TypedImagePool<T>::alloc()
+    {
+        return reinterpret_cast<T*>(_pool.alloc());
+    }
+    
+    template <class T>
+    void TypedImagePool<T>::free(T* image)
+    {
+        _pool.free(reinterpret_cast<GLubyte*>(image));
+    }
+    
+    template <class T>
+    ImagePool& TypedImagePool<T>::pool()
+    {
+        return _pool;
+    }
+    
+}
+
+#endif
@@ -0,0 +1,92 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglTypedTexture.h
+//
+// A template class derived from Agl::Texture for an OpenGL texture whose color
+// components are of type T, to upload HDR images without quantizing them to
+// bytes.  The supported types are GLushort, half (the half-float type of the
+// IlmBase library) and GLfloat, for which TextureUshort, TextureHalf and
+// TextureFloat are shorter names.  The class otherwise works like
+// Agl::TextureUbyte.
+//
+
+#ifndef __AglTypedTexture__
+#define __AglTypedTexture__
+
+#include "AglTexture.h"
+#include <OpenGL/gl3.h>
+
+class half;
+
+namespace Agl
+{
+    template <class T>
+    class TypedTexture : public Texture
+    {
+    public:
+        
+        // The target should be a valid argument for glBindTexture() (e.g.,
+        // GL_TEXTURE_2D).
+        
+        TypedTexture(GLenum target);
+        virtual ~TypedTexture();
+        
+        // Set the data of the texture, with the arguments as for
+        // TextureUbyte::setData().  The default internal format of 0 means
+        // GL_RGBA16, GL_RGBA16F or GL_RGBA32F for GLushort, half or GLfloat
+        // components, respectively, keeping the precision of the data.  The
+        // unpack alignment is set to the size of T, so rows of any width
+        // are read correctly.
+        
+        void    setData(const T* data, GLsizei width, GLsizei height,
+                        GLint internalFormat = 0,
+                        GLenum format = GL_RGBA,
+                        GLint rowLength = 0, GLint skipPixels = 0,
+                        GLint skipRows = 0);
+        
+        // Access the dimensions of the texture.
+        
+        GLsizei width() const;
+        GLsizei height() const;
+        
+    private:
+        
+        // Details of the class' data are hidden in the Imp header file.
+        
+        class Imp;
+        std::unique_ptr<Imp> _m;
+    };
+    
+    typedef TypedTexture<GLushort>  TextureUshort;
+    typedef TypedTexture<half>      TextureHalf;
+    typedef TypedTexture<GLfloat>   TextureFloat;
+    
+}
+
+// The template definitions in the following header file should be considered
+// private implementation details.
+
+#include "AglTypedTextureImp.h"
+
+#endif
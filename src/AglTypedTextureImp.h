@@ -0,0 +1,119 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglTypedTextureImp.h
+//
+// The template definitions in the this header file should be considered
+// private implementation details.
+//
+
+#ifndef __AglTypedTextureImp__
+#define __AglTypedTextureImp__
+
+namespace Agl
+{
+    // The OpenGL type of the components, and the internal format that keeps
+    // their precision.
+    
+    template <class T>
+    struct TypedTextureFormat;
+    
+    template <>
+    struct TypedTextureFormat<GLushort>
+    {
+        static GLenum   type()              { return GL_UNSIGNED_SHORT; }
+        static GLint    internalFormat()    { return GL_RGBA16; }
+    };
+    
+    template <>
+    struct TypedTextureFormat<half>
+    {
+        static GLenum   type()              { return GL_HALF_FLOAT; }
+        static GLint    internalFormat()    { return GL_RGBA16F; }
+    };
+    
+    template <>
+    struct TypedTextureFormat<GLfloat>
+    {
+        static GLenum   type()              { return GL_FLOAT; }
+        static GLint    internalFormat()    { return GL_RGBA32F; }
+    };
+    
+    template <class T>
+    class TypedTexture<T>::Imp
+    {
+    public:
+        Imp() : width(0), height(0) {}
+        GLsizei     width;
+        GLsizei     height;
+    };
+    
+    template <class T>
+    TypedTexture<T>::TypedTexture(GLenum target) :
+        Texture(target), _m(new Imp)
+    {
+    }
+    
+    template <class T>
+    TypedTexture<T>::~TypedTexture()
+    {
+    }
+    
+    template <class T>
+    void TypedTexture<T>::setData(const T* data, GLsizei width, GLsizei height,
+                                  GLint internalFormat, GLenum format,
+                                  GLint rowLength, GLint skipPixels,
+                                  GLint skipRows)
+    {
+        _m->width = width;
+        _m->height = height;
+        
+        if (internalFormat == 0)
+            internalFormat = TypedTextureFormat<T>::internalFormat();
+        
+        glPixelStorei(GL_UNPACK_ALIGNMENT, GLint(sizeof(T)));
+        
+        setImage(internalFormat, width, height, format,
+                 TypedTextureFormat<T>::type(), data, rowLength, skipPixels,
+                 skipRows);
+        
+        // Restore the default alignment, which Agl::TextureUbyte assumes.
+        
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    
+    template <class T>
+    GLsizei TypedTexture<T>::width() const
+    {
+        return _m->width;
+    }
+    
+    template <class T>
+    GLsizei TypedTexture<T>::height() const
+    {
+        return _m->height;
+    }
+    
+}
+
+#endif
@@ -0,0 +1,187 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglUploadFormat.cpp
+//
+
+#include "AglUploadFormat.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    
+    // The fastest type for a format, and its rate, once measured.
+    
+    struct Choice
+    {
+        Choice() : type(0), rate(0) {}
+        GLenum  type;
+        double  rate;
+    };
+    
+    // The size of the images for the measurements, big enough for the rate to
+    // reflect the driver's copy rather than the overhead of the call.
+    
+    const GLsizei probeWidth = 512;
+    const GLsizei probeHeight = 512;
+    
+    // How much faster an alternative must measure to be preferred over
+    // GL_RGBA with GL_UNSIGNED_BYTE, so noise in the timing does not decide.
+    
+    const double margin = 1.05;
+    
+    // The best of several measurements, which is less noisy than one.
+    
+    const int probeRepeats = 3;
+    
+    // The internal format to measure in place of an unsized one, so the two
+    // share a measurement.
+    
+    GLint probeInternalFormat(GLint internalFormat)
+    {
+        switch (internalFormat)
+        {
+            case GL_RGBA:
+                return GL_RGBA8;
+            case GL_RGB:
+                return GL_RGB8;
+            default:
+                return internalFormat;
+        }
+    }
+    
+    const Choice& choose(GLenum format, GLint internalFormat)
+    {
+        internalFormat = probeInternalFormat(internalFormat);
+        static std::map<std::pair<GLenum, GLint>, Choice> choices;
+        Choice& choice = choices[std::make_pair(format, internalFormat)];
+        
+        if (choice.type == 0)
+        {
+            const GLenum types [] =
+            {
+                GL_UNSIGNED_BYTE,
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+                GL_UNSIGNED_INT_8_8_8_8_REV
+#endif
+            };
+            
+            for (GLenum type : types)
+            {
+                double rate = 0;
+                for (int i = 0; i < probeRepeats; ++i)
+                {
+                    rate = std::max(rate,
+                                    Agl::measureUploadRate(internalFormat,
+                                                           format, type, 4,
+                                                           probeWidth,
+                                                           probeHeight));
+                }
+                if ((choice.type == 0) || (rate > choice.rate * margin))
+                {
+                    choice.type = type;
+                    choice.rate = rate;
+                }
+            }
+        }
+        
+        return choice;
+    }
+    
+}
+
+namespace Agl
+{
+    
+    GLenum preferredUploadType(GLenum format, GLint internalFormat)
+    {
+        if ((format != GL_RGBA) && (format != GL_BGRA))
+            return GL_UNSIGNED_BYTE;
+        
+        return choose(format, internalFormat).type;
+    }
+    
+    GLenum preferredUploadFormat(GLint internalFormat)
+    {
+        double bgra = choose(GL_BGRA, internalFormat).rate;
+        double rgba = choose(GL_RGBA, internalFormat).rate;
+        return (bgra > rgba * margin) ? GL_BGRA : GL_RGBA;
+    }
+    
+    double measureUploadRate(GLint internalFormat, GLenum format, GLenum type,
+                             GLsizei bytesPerPixel, GLsizei width,
+                             GLsizei height, int iterations)
+    {
+        GLint previous = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        
+        // The pixel values are arbitrary, but varied, in case a driver does
+        // something special for uniform data.
+        
+        std::vector<GLubyte> data(size_t(width) * height * bytesPerPixel);
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = GLubyte(i * 7);
+        
+        GLuint texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        
+        // The first upload allocates the storage, and is not timed.
+        
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format,
+                     type, data.data());
+        glFinish();
+        
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            data[0] = GLubyte(i);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type,
+                            data.data());
+            glFinish();
+        }
+        std::chrono::steady_clock::duration elapsed =
+            std::chrono::steady_clock::now() - start;
+        
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glDeleteTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, GLuint(previous));
+        
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        double megabytes = double(data.size()) * iterations / (1024.0 * 1024.0);
+        return (seconds > 0) ? megabytes / seconds : 0;
+    }
+    
+}
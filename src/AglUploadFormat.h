@@ -0,0 +1,78 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// AglUploadFormat.h
+//
+// Routines that choose the format and type arguments for uploading texture
+// data.  The Apple "OpenGL Programming Guide for Mac" states that GL_RGBA with
+// GL_UNSIGNED_BYTE "needs to be swizzled by many cards when the data is
+// loaded", while GL_BGRA with GL_UNSIGNED_INT_8_8_8_8_REV is often the
+// driver's native layout.  Which combination is fastest depends on the driver,
+// so these routines measure the candidates once, on first use, and remember
+// the fastest for the rest of the process.
+//
+
+#ifndef __AglUploadFormat__
+#define __AglUploadFormat__
+
+#include <OpenGL/gl3.h>
+
+namespace Agl
+{
+    
+    // Return the type argument that uploads 8-bit pixels of the format
+    // (GL_RGBA or GL_BGRA) fastest on the current driver into a texture with
+    // the internal format: GL_UNSIGNED_BYTE, or GL_UNSIGNED_INT_8_8_8_8_REV,
+    // which has the same layout in memory on a little-endian CPU.  The first
+    // call for each format and internal format measures both, so it needs the
+    // OpenGL context to be current, and takes tens of milliseconds; it should
+    // be made at startup rather than before the first frame is drawn.  The
+    // unsized GL_RGBA and GL_RGB are measured as GL_RGBA8 and GL_RGB8.  For
+    // other formats, and on a big-endian CPU, GL_UNSIGNED_BYTE is returned
+    // without measuring.
+    
+    GLenum  preferredUploadType(GLenum format,
+                                GLint internalFormat = GL_RGBA8);
+    
+    // Return the order of 8-bit components, GL_RGBA or GL_BGRA, that uploads
+    // fastest on the current driver into a texture with the internal format,
+    // with its preferredUploadType().  A producer that can write either order
+    // (e.g., a camera that can deliver BGRA, which then needs no
+    // Agl::convertBgraToRgba()) should use this one.  The context must be
+    // current, as for preferredUploadType().
+    
+    GLenum  preferredUploadFormat(GLint internalFormat = GL_RGBA8);
+    
+    // Measure the rate, in megabytes per second, of uploading an image of the
+    // specified size and bytesPerPixel with glTexSubImage2D() into a texture
+    // with the internal format, over the number of iterations, each waiting
+    // for the upload to finish.  The OpenGL context must be current.  The
+    // texture binding of the active texture unit is restored afterwards.
+    
+    double  measureUploadRate(GLint internalFormat, GLenum format, GLenum type,
+                              GLsizei bytesPerPixel, GLsizei width,
+                              GLsizei height, int iterations = 10);
+    
+}
+
+#endif
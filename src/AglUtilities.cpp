@@ -25,6 +25,1644 @@
 //
 
 #include "AglUtilities.h"
+#include "AglImagePool.h"
+#include "AglImageView.h"
+#include "AglThreadPool.h"
+#include <OpenEXR/half.h>
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AGL_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define AGL_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Functions with this attribute may use AVX2 instructions even though the
+// rest of the library is compiled for the baseline instruction set.  They are
+// called only after a runtime check that the CPU supports AVX2.
+
+#if defined(AGL_SIMD_X86) && defined(__GNUC__)
+#define AGL_SIMD_AVX2 1
+#define AGL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Likewise for the F16C instructions, which convert between half and single
+// precision floats.
+
+#if defined(AGL_SIMD_X86) && defined(__GNUC__)
+#define AGL_SIMD_F16C 1
+#define AGL_TARGET_F16C __attribute__((target("f16c")))
+#endif
+
+namespace
+{
+    
+    // The implementations of Agl::reduceImageBy2() work a row at a time.  Each
+    // reduces the two original rows row0 and row1 into one row of resultWidth
+    // pixels.  To match the original code exactly, every path computes the
+    // sum of the four original bytes and truncates when dividing by 4.
+    
+    typedef void (*ReduceRowBy2Function)(GLubyte* result, const GLubyte* row0,
+                                         const GLubyte* row1,
+                                         GLsizei resultWidth,
+                                         GLsizei bytesPerPixel);
+    
+    // Reduce the pixels from index begin to the end of the row.  This is the
+    // fallback when no SIMD path exists, and it also finishes the pixels left
+    // over at the end of a row by the SIMD paths.
+    
+    void reduceRowBy2Scalar(GLubyte* result, const GLubyte* row0,
+                            const GLubyte* row1, GLsizei resultWidth,
+                            GLsizei bytesPerPixel, GLsizei begin)
+    {
+        const GLubyte* origPtr0a = row0 + 2 * begin * bytesPerPixel;
+        const GLubyte* origPtr0b = origPtr0a + bytesPerPixel;
+        const GLubyte* origPtr1a = row1 + 2 * begin * bytesPerPixel;
+        const GLubyte* origPtr1b = origPtr1a + bytesPerPixel;
+        GLubyte* resultPtr = result + begin * bytesPerPixel;
+        
+        for (GLsizei j = begin; j < resultWidth; ++j)
+        {
+            for (GLsizei k = 0; k < bytesPerPixel; ++k)
+            {
+                GLuint r = *origPtr0a++ + *origPtr0b++ + *origPtr1a++ + *origPtr1b++;
+                *resultPtr++ = r / 4;
+            }
+            origPtr0a += bytesPerPixel;
+            origPtr0b += bytesPerPixel;
+            origPtr1a += bytesPerPixel;
+            origPtr1b += bytesPerPixel;
+        }
+    }
+    
+#if !defined(AGL_SIMD_X86) && !defined(AGL_SIMD_NEON)
+    
+    void reduceRowBy2Scalar(GLubyte* result, const GLubyte* row0,
+                            const GLubyte* row1, GLsizei resultWidth,
+                            GLsizei bytesPerPixel)
+    {
+        reduceRowBy2Scalar(result, row0, row1, resultWidth, bytesPerPixel, 0);
+    }
+    
+#endif
+    
+#if defined(AGL_SIMD_X86)
+    
+    // The SSE2 kernels take the 16-bit sums of two original rows for 16
+    // consecutive bytes in a and the next 16 bytes in b, and add the
+    // horizontally adjacent pixels to give 8 16-bit sums for the result.  The
+    // pixel size determines how the adjacent pixels are gathered.
+    
+    template <int BytesPerPixel>
+    inline __m128i addPixelPairsSSE2(__m128i a, __m128i b);
+    
+    template <>
+    inline __m128i addPixelPairsSSE2<1>(__m128i a, __m128i b)
+    {
+        const __m128i ones = _mm_set1_epi16(1);
+        return _mm_packs_epi32(_mm_madd_epi16(a, ones), _mm_madd_epi16(b, ones));
+    }
+    
+    template <>
+    inline __m128i addPixelPairsSSE2<2>(__m128i a, __m128i b)
+    {
+        __m128 fa = _mm_castsi128_ps(a);
+        __m128 fb = _mm_castsi128_ps(b);
+        __m128i even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i odd = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+        return _mm_add_epi16(even, odd);
+    }
+    
+    template <>
+    inline __m128i addPixelPairsSSE2<4>(__m128i a, __m128i b)
+    {
+        return _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+    }
+    
+    // Reduce as much of a row as possible in groups of 16 result bytes, and
+    // return the number of result pixels produced.  Works for pixel sizes that
+    // divide 16 evenly.
+    
+    template <int BytesPerPixel>
+    GLsizei reduceRowBy2SSE2(GLubyte* result, const GLubyte* row0,
+                             const GLubyte* row1, GLsizei resultWidth)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const GLsizei n = resultWidth * BytesPerPixel / 16;
+        
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 16));
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+            __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 16));
+            
+            __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+            __m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+            __m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+            __m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+            
+            __m128i lo = _mm_srli_epi16(addPixelPairsSSE2<BytesPerPixel>(s0, s1), 2);
+            __m128i hi = _mm_srli_epi16(addPixelPairsSSE2<BytesPerPixel>(s2, s3), 2);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(result), _mm_packus_epi16(lo, hi));
+            
+            row0 += 32;
+            row1 += 32;
+            result += 16;
+        }
+        
+        return n * 16 / BytesPerPixel;
+    }
+    
+    // Gather the 4-byte windows starting at the first and second pixels of
+    // each pair of 3-byte pixels, for four pairs.  The fourth byte of each
+    // window belongs to the next pixel and is discarded later.
+    
+    inline void gatherPixelPairs3(const GLubyte* row, __m128i& even, __m128i& odd)
+    {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 12));
+        even = _mm_unpacklo_epi64(_mm_unpacklo_epi32(v0, _mm_srli_si128(v0, 6)),
+                                  _mm_unpacklo_epi32(v1, _mm_srli_si128(v1, 6)));
+        odd = _mm_unpacklo_epi64(_mm_unpacklo_epi32(_mm_srli_si128(v0, 3),
+                                                    _mm_srli_si128(v0, 9)),
+                                 _mm_unpacklo_epi32(_mm_srli_si128(v1, 3),
+                                                    _mm_srli_si128(v1, 9)));
+    }
+    
+    // Three bytes per pixel does not divide 16 evenly, so this kernel widens
+    // each pixel to four bytes, produces four result pixels per iteration and
+    // stores only their first three bytes.  The loads for the last pixel pair
+    // read four bytes past it, so the loop stops early enough to stay within
+    // the row.
+    
+    GLsizei reduceRowBy2SSE2Rgb(GLubyte* result, const GLubyte* row0,
+                                const GLubyte* row1, GLsizei resultWidth)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        GLsizei j = 0;
+        
+        for (; j + 5 <= resultWidth; j += 4)
+        {
+            __m128i even0, odd0, even1, odd1;
+            gatherPixelPairs3(row0, even0, odd0);
+            gatherPixelPairs3(row1, even1, odd1);
+            
+            __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(even0, zero),
+                                                     _mm_unpacklo_epi8(odd0, zero)),
+                                       _mm_add_epi16(_mm_unpacklo_epi8(even1, zero),
+                                                     _mm_unpacklo_epi8(odd1, zero)));
+            __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(even0, zero),
+                                                     _mm_unpackhi_epi8(odd0, zero)),
+                                       _mm_add_epi16(_mm_unpackhi_epi8(even1, zero),
+                                                     _mm_unpackhi_epi8(odd1, zero)));
+            __m128i r = _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2));
+            
+            GLubyte pixels[16];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), r);
+            memcpy(result, pixels, 3);
+            memcpy(result + 3, pixels + 4, 3);
+            memcpy(result + 6, pixels + 8, 3);
+            memcpy(result + 9, pixels + 12, 3);
+            
+            row0 += 24;
+            row1 += 24;
+            result += 12;
+        }
+        
+        return j;
+    }
+    
+    void reduceRowBy2SSE2(GLubyte* result, const GLubyte* row0,
+                          const GLubyte* row1, GLsizei resultWidth,
+                          GLsizei bytesPerPixel)
+    {
+        GLsizei done = 0;
+        switch (bytesPerPixel)
+        {
+            case 1:
+                done = reduceRowBy2SSE2<1>(result, row0, row1, resultWidth);
+                break;
+            case 2:
+                done = reduceRowBy2SSE2<2>(result, row0, row1, resultWidth);
+                break;
+            case 3:
+                done = reduceRowBy2SSE2Rgb(result, row0, row1, resultWidth);
+                break;
+            case 4:
+                done = reduceRowBy2SSE2<4>(result, row0, row1, resultWidth);
+                break;
+            default:
+                break;
+        }
+        reduceRowBy2Scalar(result, row0, row1, resultWidth, bytesPerPixel, done);
+    }
+    
+#endif
+    
+#if defined(AGL_SIMD_AVX2)
+    
+    // The AVX2 kernels follow the SSE2 kernels, but with 32 16-bit sums in a
+    // and b.  The AVX2 pack and shuffle instructions work within each 128-bit
+    // lane, so the 64-bit quarters of each result are permuted back into
+    // order.
+    
+    template <int BytesPerPixel>
+    AGL_TARGET_AVX2 inline __m256i addPixelPairsAVX2(__m256i a, __m256i b);
+    
+    template <>
+    AGL_TARGET_AVX2 inline __m256i addPixelPairsAVX2<1>(__m256i a, __m256i b)
+    {
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i r = _mm256_packs_epi32(_mm256_madd_epi16(a, ones),
+                                       _mm256_madd_epi16(b, ones));
+        return _mm256_permute4x64_epi64(r, _MM_SHUFFLE(3, 1, 2, 0));
+    }
+    
+    template <>
+    AGL_TARGET_AVX2 inline __m256i addPixelPairsAVX2<2>(__m256i a, __m256i b)
+    {
+        __m256 fa = _mm256_castsi256_ps(a);
+        __m256 fb = _mm256_castsi256_ps(b);
+        __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+        return _mm256_permute4x64_epi64(_mm256_add_epi16(even, odd),
+                                        _MM_SHUFFLE(3, 1, 2, 0));
+    }
+    
+    template <>
+    AGL_TARGET_AVX2 inline __m256i addPixelPairsAVX2<4>(__m256i a, __m256i b)
+    {
+        __m256i r = _mm256_add_epi16(_mm256_unpacklo_epi64(a, b),
+                                     _mm256_unpackhi_epi64(a, b));
+        return _mm256_permute4x64_epi64(r, _MM_SHUFFLE(3, 1, 2, 0));
+    }
+    
+    // Add 16 bytes from each of two rows as 16-bit values.
+    
+    AGL_TARGET_AVX2 inline __m256i sumRowsAVX2(const GLubyte* row0,
+                                               const GLubyte* row1)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+        return _mm256_add_epi16(_mm256_cvtepu8_epi16(a), _mm256_cvtepu8_epi16(b));
+    }
+    
+    template <int BytesPerPixel>
+    AGL_TARGET_AVX2 GLsizei reduceRowBy2AVX2(GLubyte* result, const GLubyte* row0,
+                                             const GLubyte* row1,
+                                             GLsizei resultWidth)
+    {
+        const GLsizei n = resultWidth * BytesPerPixel / 32;
+        
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            __m256i s0 = sumRowsAVX2(row0, row1);
+            __m256i s1 = sumRowsAVX2(row0 + 16, row1 + 16);
+            __m256i s2 = sumRowsAVX2(row0 + 32, row1 + 32);
+            __m256i s3 = sumRowsAVX2(row0 + 48, row1 + 48);
+            
+            __m256i lo = _mm256_srli_epi16(addPixelPairsAVX2<BytesPerPixel>(s0, s1), 2);
+            __m256i hi = _mm256_srli_epi16(addPixelPairsAVX2<BytesPerPixel>(s2, s3), 2);
+            __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi),
+                                                 _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(result), r);
+            
+            row0 += 64;
+            row1 += 64;
+            result += 32;
+        }
+        
+        return n * 32 / BytesPerPixel;
+    }
+    
+    // Three bytes per pixel uses the SSE2 kernel, because gathering the
+    // pixel pairs across the 128-bit lanes would cost more than it saves.
+    // The SSE2 kernels also finish the part of each row that is too short for
+    // another AVX2 iteration.
+    
+    void reduceRowBy2AVX2(GLubyte* result, const GLubyte* row0,
+                          const GLubyte* row1, GLsizei resultWidth,
+                          GLsizei bytesPerPixel)
+    {
+        GLsizei done = 0;
+        switch (bytesPerPixel)
+        {
+            case 1:
+                done = reduceRowBy2AVX2<1>(result, row0, row1, resultWidth);
+                break;
+            case 2:
+                done = reduceRowBy2AVX2<2>(result, row0, row1, resultWidth);
+                break;
+            case 4:
+                done = reduceRowBy2AVX2<4>(result, row0, row1, resultWidth);
+                break;
+            default:
+                break;
+        }
+        
+        GLsizei offset = done * bytesPerPixel;
+        reduceRowBy2SSE2(result + offset, row0 + 2 * offset, row1 + 2 * offset,
+                         resultWidth - done, bytesPerPixel);
+    }
+    
+#endif
+    
+#if defined(AGL_SIMD_NEON)
+    
+    // The NEON kernels use the deinterleaving loads to put each component in
+    // its own register, so the same pairwise additions work for every pixel
+    // size from 1 to 4 bytes.  Each iteration produces 8 result pixels.
+    
+#define AGL_REDUCE_ROW_BY_2_NEON(N, LoadType, StoreType, load, store)       \
+    GLsizei reduceRowBy2NEON##N(GLubyte* result, const GLubyte* row0,       \
+                                const GLubyte* row1, GLsizei resultWidth)   \
+    {                                                                       \
+        const GLsizei n = resultWidth / 8;                                  \
+        for (GLsizei i = 0; i < n; ++i)                                     \
+        {                                                                   \
+            LoadType a = load(row0);                                        \
+            LoadType b = load(row1);                                        \
+            StoreType r;                                                    \
+            for (int k = 0; k < N; ++k)                                     \
+            {                                                               \
+                uint16x8_t s = vpadalq_u8(vpaddlq_u8(a.val[k]), b.val[k]);  \
+                r.val[k] = vshrn_n_u16(s, 2);                               \
+            }                                                               \
+            store(result, r);                                               \
+            row0 += 16 * N;                                                 \
+            row1 += 16 * N;                                                 \
+            result += 8 * N;                                                \
+        }                                                                   \
+        return n * 8;                                                       \
+    }
+    
+    AGL_REDUCE_ROW_BY_2_NEON(2, uint8x16x2_t, uint8x8x2_t, vld2q_u8, vst2_u8)
+    AGL_REDUCE_ROW_BY_2_NEON(3, uint8x16x3_t, uint8x8x3_t, vld3q_u8, vst3_u8)
+    AGL_REDUCE_ROW_BY_2_NEON(4, uint8x16x4_t, uint8x8x4_t, vld4q_u8, vst4_u8)
+    
+#undef AGL_REDUCE_ROW_BY_2_NEON
+    
+    GLsizei reduceRowBy2NEON1(GLubyte* result, const GLubyte* row0,
+                              const GLubyte* row1, GLsizei resultWidth)
+    {
+        const GLsizei n = resultWidth / 8;
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            uint16x8_t s = vpadalq_u8(vpaddlq_u8(vld1q_u8(row0)), vld1q_u8(row1));
+            vst1_u8(result, vshrn_n_u16(s, 2));
+            row0 += 16;
+            row1 += 16;
+            result += 8;
+        }
+        return n * 8;
+    }
+    
+    void reduceRowBy2NEON(GLubyte* result, const GLubyte* row0,
+                          const GLubyte* row1, GLsizei resultWidth,
+                          GLsizei bytesPerPixel)
+    {
+        GLsizei done = 0;
+        switch (bytesPerPixel)
+        {
+            case 1:
+                done = reduceRowBy2NEON1(result, row0, row1, resultWidth);
+                break;
+            case 2:
+                done = reduceRowBy2NEON2(result, row0, row1, resultWidth);
+                break;
+            case 3:
+                done = reduceRowBy2NEON3(result, row0, row1, resultWidth);
+                break;
+            case 4:
+                done = reduceRowBy2NEON4(result, row0, row1, resultWidth);
+                break;
+            default:
+                break;
+        }
+        reduceRowBy2Scalar(result, row0, row1, resultWidth, bytesPerPixel, done);
+    }
+    
+#endif
+    
+    // Choose the fastest implementation the CPU supports.  SSE2 is part of
+    // every x86-64 CPU and NEON of every ARMv8 CPU, so only AVX2 needs to be
+    // detected at runtime.
+    
+    ReduceRowBy2Function chooseReduceRowBy2()
+    {
+#if defined(AGL_SIMD_AVX2)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return reduceRowBy2AVX2;
+#endif
+#if defined(AGL_SIMD_X86)
+        return reduceRowBy2SSE2;
+#elif defined(AGL_SIMD_NEON)
+        return reduceRowBy2NEON;
+#else
+        return reduceRowBy2Scalar;
+#endif
+    }
+    
+    ReduceRowBy2Function reduceRowBy2()
+    {
+        static const ReduceRowBy2Function function = chooseReduceRowBy2();
+        return function;
+    }
+    
+    // Split rowCount rows into at most threadCount bands, and call
+    // function(beginRow, endRow) for each band, in parallel on the threads of
+    // Agl::ThreadPool::shared() and the calling thread.  A threadCount of 0
+    // or less means every thread in the shared pool.
+    
+    template <typename Function>
+    void forEachBand(GLsizei rowCount, GLsizei threadCount, Function function)
+    {
+        Agl::ThreadPool& pool = Agl::ThreadPool::shared();
+        if (threadCount <= 0)
+            threadCount = GLsizei(pool.threadCount() + 1);
+        
+        GLsizei bandCount = std::min(threadCount, rowCount);
+        
+        pool.run(bandCount, [&](size_t band)
+        {
+            GLsizei beginRow = GLsizei(band * rowCount / bandCount);
+            GLsizei endRow = GLsizei((band + 1) * rowCount / bandCount);
+            function(beginRow, endRow);
+        });
+    }
+    
+    // Reduce the result rows from beginRow up to (but not including) endRow,
+    // with the other arguments as for Agl::reduceImageBy2().
+    
+    void reduceImageBy2Rows(GLubyte* result, const GLubyte* orig,
+                            GLsizei width, GLsizei bytesPerPixel,
+                            GLsizei rowLength, GLsizei skipPixels,
+                            GLsizei skipRows, GLsizei beginRow, GLsizei endRow)
+    {
+        if (rowLength == 0)
+            rowLength = width;
+        
+        GLsizei resultWidth = width / 2;
+        
+        const size_t origRowSize = size_t(rowLength) * bytesPerPixel;
+        const size_t resultRowSize = size_t(resultWidth) * bytesPerPixel;
+        
+        const GLubyte* origRow = orig + size_t(skipPixels) * bytesPerPixel +
+                                 (skipRows + 2 * size_t(beginRow)) * origRowSize;
+        GLubyte* resultRow = result + beginRow * resultRowSize;
+        
+        ReduceRowBy2Function reduceRow = reduceRowBy2();
+        
+        for (GLsizei i = beginRow; i < endRow; ++i)
+        {
+            reduceRow(resultRow, origRow, origRow + origRowSize, resultWidth,
+                      bytesPerPixel);
+            origRow += 2 * origRowSize;
+            resultRow += resultRowSize;
+        }
+    }
+    
+    // The versions of Agl::reduceImageBy2() for 16-bit, half-float and float
+    // components also work a row at a time, with componentsPerPixel in place
+    // of bytesPerPixel.  The 16-bit versions truncate the average, like the
+    // byte versions.  The floating-point versions add the two original rows
+    // first and then the horizontally adjacent pixels, in that order on every
+    // path, and multiply by 0.25, so every path gives the same result.  The
+    // half-float versions do that arithmetic in float and round the result to
+    // the nearest half.
+    
+    template <typename T>
+    struct ReduceRowBy2Typed
+    {
+        typedef void (*Function)(T* result, const T* row0, const T* row1,
+                                 GLsizei resultWidth,
+                                 GLsizei componentsPerPixel);
+    };
+    
+    // The average of the components a0 and b0 of adjacent pixels in one row
+    // and a1 and b1 of the pixels below them.
+    
+    inline GLushort averageOf4(GLushort a0, GLushort b0, GLushort a1,
+                               GLushort b1)
+    {
+        return GLushort((GLuint(a0) + a1 + b0 + b1) / 4);
+    }
+    
+    inline GLfloat averageOf4(GLfloat a0, GLfloat b0, GLfloat a1, GLfloat b1)
+    {
+        return ((a0 + a1) + (b0 + b1)) * 0.25f;
+    }
+    
+    inline half averageOf4(half a0, half b0, half a1, half b1)
+    {
+        return half(averageOf4(float(a0), float(b0), float(a1), float(b1)));
+    }
+    
+    template <typename T>
+    void reduceRowBy2Scalar(T* result, const T* row0, const T* row1,
+                            GLsizei resultWidth, GLsizei componentsPerPixel,
+                            GLsizei begin)
+    {
+        for (GLsizei j = begin; j < resultWidth; ++j)
+        {
+            const size_t a = 2 * size_t(j) * componentsPerPixel;
+            const size_t b = a + componentsPerPixel;
+            T* resultPtr = result + size_t(j) * componentsPerPixel;
+            for (GLsizei k = 0; k < componentsPerPixel; ++k)
+            {
+                resultPtr[k] = averageOf4(row0[a + k], row0[b + k],
+                                          row1[a + k], row1[b + k]);
+            }
+        }
+    }
+    
+    template <typename T>
+    void reduceRowBy2Scalar(T* result, const T* row0, const T* row1,
+                            GLsizei resultWidth, GLsizei componentsPerPixel)
+    {
+        reduceRowBy2Scalar(result, row0, row1, resultWidth, componentsPerPixel,
+                           0);
+    }
+    
+#if defined(AGL_SIMD_X86)
+    
+    // Separate the first and second pixels of each horizontally adjacent
+    // pair, from the 32-bit components of eight consecutive pixel components
+    // in a and b.  The result of the pair is then the sum of first and
+    // second.
+    
+    template <int ComponentsPerPixel>
+    inline void splitPixelPairsSSE2(__m128 a, __m128 b, __m128& first,
+                                    __m128& second);
+    
+    template <>
+    inline void splitPixelPairsSSE2<1>(__m128 a, __m128 b, __m128& first,
+                                       __m128& second)
+    {
+        first = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        second = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+    
+    template <>
+    inline void splitPixelPairsSSE2<2>(__m128 a, __m128 b, __m128& first,
+                                       __m128& second)
+    {
+        first = _mm_movelh_ps(a, b);
+        second = _mm_movehl_ps(b, a);
+    }
+    
+    template <>
+    inline void splitPixelPairsSSE2<4>(__m128 a, __m128 b, __m128& first,
+                                       __m128& second)
+    {
+        first = a;
+        second = b;
+    }
+    
+    template <int ComponentsPerPixel>
+    inline __m128 addPixelPairsSSE2(__m128 a, __m128 b)
+    {
+        __m128 first, second;
+        splitPixelPairsSSE2<ComponentsPerPixel>(a, b, first, second);
+        return _mm_add_ps(first, second);
+    }
+    
+    // Reduce as much of a row of 16-bit components as possible in groups of
+    // 8 result components, and return the number of result pixels produced.
+    // The sums need 32 bits, and SSE2 has no unsigned 32-bit pack, so the
+    // averages are biased into the signed range to be packed, and the bias
+    // is then removed from the 16-bit results.
+    
+    template <int ComponentsPerPixel>
+    GLsizei reduceRowBy2SSE2(GLushort* result, const GLushort* row0,
+                             const GLushort* row1, GLsizei resultWidth)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias32 = _mm_set1_epi32(0x8000);
+        const __m128i bias16 = _mm_set1_epi16(short(0x8000));
+        const GLsizei n = resultWidth * ComponentsPerPixel / 8;
+        
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8));
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+            __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8));
+            
+            __m128i s[4];
+            s[0] = _mm_add_epi32(_mm_unpacklo_epi16(a0, zero), _mm_unpacklo_epi16(b0, zero));
+            s[1] = _mm_add_epi32(_mm_unpackhi_epi16(a0, zero), _mm_unpackhi_epi16(b0, zero));
+            s[2] = _mm_add_epi32(_mm_unpacklo_epi16(a1, zero), _mm_unpacklo_epi16(b1, zero));
+            s[3] = _mm_add_epi32(_mm_unpackhi_epi16(a1, zero), _mm_unpackhi_epi16(b1, zero));
+            
+            __m128i r[2];
+            for (int h = 0; h < 2; ++h)
+            {
+                __m128 first, second;
+                splitPixelPairsSSE2<ComponentsPerPixel>(_mm_castsi128_ps(s[2 * h]),
+                                                        _mm_castsi128_ps(s[2 * h + 1]),
+                                                        first, second);
+                __m128i sum = _mm_add_epi32(_mm_castps_si128(first),
+                                            _mm_castps_si128(second));
+                r[h] = _mm_sub_epi32(_mm_srli_epi32(sum, 2), bias32);
+            }
+            __m128i packed = _mm_xor_si128(_mm_packs_epi32(r[0], r[1]), bias16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(result), packed);
+            
+            row0 += 16;
+            row1 += 16;
+            result += 8;
+        }
+        
+        return n * 8 / ComponentsPerPixel;
+    }
+    
+    // Reduce as much of a row of float components as possible in groups of
+    // 8 result components, and return the number of result pixels produced.
+    
+    template <int ComponentsPerPixel>
+    GLsizei reduceRowBy2SSE2(GLfloat* result, const GLfloat* row0,
+                             const GLfloat* row1, GLsizei resultWidth)
+    {
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        const GLsizei n = resultWidth * ComponentsPerPixel / 8;
+        
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            __m128 s0 = _mm_add_ps(_mm_loadu_ps(row0), _mm_loadu_ps(row1));
+            __m128 s1 = _mm_add_ps(_mm_loadu_ps(row0 + 4), _mm_loadu_ps(row1 + 4));
+            __m128 s2 = _mm_add_ps(_mm_loadu_ps(row0 + 8), _mm_loadu_ps(row1 + 8));
+            __m128 s3 = _mm_add_ps(_mm_loadu_ps(row0 + 12), _mm_loadu_ps(row1 + 12));
+            
+            _mm_storeu_ps(result, _mm_mul_ps(addPixelPairsSSE2<ComponentsPerPixel>(s0, s1),
+                                             quarter));
+            _mm_storeu_ps(result + 4, _mm_mul_ps(addPixelPairsSSE2<ComponentsPerPixel>(s2, s3),
+                                                 quarter));
+            
+            row0 += 16;
+            row1 += 16;
+            result += 8;
+        }
+        
+        return n * 8 / ComponentsPerPixel;
+    }
+    
+    // Dispatch on the number of components, for the 16-bit and float
+    // kernels, finishing the rest of the row with the scalar code.  Three
+    // components per pixel do not divide the 8 components of an iteration
+    // evenly, so they use only the scalar code.
+    
+    template <typename T>
+    void reduceRowBy2SSE2(T* result, const T* row0, const T* row1,
+                          GLsizei resultWidth, GLsizei componentsPerPixel)
+    {
+        GLsizei done = 0;
+        switch (componentsPerPixel)
+        {
+            case 1:
+                done = reduceRowBy2SSE2<1>(result, row0, row1, resultWidth);
+                break;
+            case 2:
+                done = reduceRowBy2SSE2<2>(result, row0, row1, resultWidth);
+                break;
+            case 4:
+                done = reduceRowBy2SSE2<4>(result, row0, row1, resultWidth);
+                break;
+            default:
+                break;
+        }
+        reduceRowBy2Scalar(result, row0, row1, resultWidth, componentsPerPixel,
+                           done);
+    }
+    
+#endif
+    
+#if defined(AGL_SIMD_F16C)
+    
+    // Convert four halves to floats.
+    
+    AGL_TARGET_F16C inline __m128 loadHalvesF16C(const half* p)
+    {
+        return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    }
+    
+    // The half-float kernel follows the float kernel, converting with the
+    // F16C instructions, which round to nearest like the half class.
+    
+    template <int ComponentsPerPixel>
+    AGL_TARGET_F16C GLsizei reduceRowBy2F16C(half* result, const half* row0,
+                                             const half* row1,
+                                             GLsizei resultWidth)
+    {
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        const GLsizei n = resultWidth * ComponentsPerPixel / 8;
+        
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            __m128 s0 = _mm_add_ps(loadHalvesF16C(row0), loadHalvesF16C(row1));
+            __m128 s1 = _mm_add_ps(loadHalvesF16C(row0 + 4), loadHalvesF16C(row1 + 4));
+            __m128 s2 = _mm_add_ps(loadHalvesF16C(row0 + 8), loadHalvesF16C(row1 + 8));
+            __m128 s3 = _mm_add_ps(loadHalvesF16C(row0 + 12), loadHalvesF16C(row1 + 12));
+            
+            __m128 r0 = _mm_mul_ps(addPixelPairsSSE2<ComponentsPerPixel>(s0, s1), quarter);
+            __m128 r1 = _mm_mul_ps(addPixelPairsSSE2<ComponentsPerPixel>(s2, s3), quarter);
+            __m128i packed = _mm_unpacklo_epi64(_mm_cvtps_ph(r0, _MM_FROUND_TO_NEAREST_INT),
+                                                _mm_cvtps_ph(r1, _MM_FROUND_TO_NEAREST_INT));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(result), packed);
+            
+            row0 += 16;
+            row1 += 16;
+            result += 8;
+        }
+        
+        return n * 8 / ComponentsPerPixel;
+    }
+    
+    void reduceRowBy2F16C(half* result, const half* row0, const half* row1,
+                          GLsizei resultWidth, GLsizei componentsPerPixel)
+    {
+        GLsizei done = 0;
+        switch (componentsPerPixel)
+        {
+            case 1:
+                done = reduceRowBy2F16C<1>(result, row0, row1, resultWidth);
+                break;
+            case 2:
+                done = reduceRowBy2F16C<2>(result, row0, row1, resultWidth);
+                break;
+            case 4:
+                done = reduceRowBy2F16C<4>(result, row0, row1, resultWidth);
+                break;
+            default:
+                break;
+        }
+        reduceRowBy2Scalar(result, row0, row1, resultWidth, componentsPerPixel,
+                           done);
+    }
+    
+#endif
+    
+#if defined(AGL_SIMD_NEON)
+    
+    // The NEON kernels for 16-bit components follow the byte kernels, using
+    // the deinterleaving loads so every pixel size from 1 to 4 components
+    // works the same way.  Each iteration produces 4 result pixels.
+    
+#define AGL_REDUCE_ROW_BY_2_NEON_U16(N, LoadType, StoreType, load, store)   \
+    GLsizei reduceRowBy2NEON##N(GLushort* result, const GLushort* row0,     \
+                                const GLushort* row1, GLsizei resultWidth)  \
+    {                                                                       \
+        const GLsizei n = resultWidth / 4;                                  \
+        for (GLsizei i = 0; i < n; ++i)                                     \
+        {                                                                   \
+            LoadType a = load(row0);                                        \
+            LoadType b = load(row1);                                        \
+            StoreType r;                                                    \
+            for (int k = 0; k < N; ++k)                                     \
+            {                                                               \
+                uint32x4_t s = vpadalq_u16(vpaddlq_u16(a.val[k]), b.val[k]);\
+                r.val[k] = vshrn_n_u32(s, 2);                               \
+            }                                                               \
+            store(result, r);                                               \
+            row0 += 8 * N;                                                  \
+            row1 += 8 * N;                                                  \
+            result += 4 * N;                                                \
+        }                                                                   \
+        return n * 4;                                                       \
+    }
+    
+    AGL_REDUCE_ROW_BY_2_NEON_U16(2, uint16x8x2_t, uint16x4x2_t, vld2q_u16, vst2_u16)
+    AGL_REDUCE_ROW_BY_2_NEON_U16(3, uint16x8x3_t, uint16x4x3_t, vld3q_u16, vst3_u16)
+    AGL_REDUCE_ROW_BY_2_NEON_U16(4, uint16x8x4_t, uint16x4x4_t, vld4q_u16, vst4_u16)
+    
+#undef AGL_REDUCE_ROW_BY_2_NEON_U16
+    
+    GLsizei reduceRowBy2NEON1(GLushort* result, const GLushort* row0,
+                              const GLushort* row1, GLsizei resultWidth)
+    {
+        const GLsizei n = resultWidth / 4;
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            uint32x4_t s = vpadalq_u16(vpaddlq_u16(vld1q_u16(row0)), vld1q_u16(row1));
+            vst1_u16(result, vshrn_n_u32(s, 2));
+            row0 += 8;
+            row1 += 8;
+            result += 4;
+        }
+        return n * 4;
+    }
+    
+#if defined(__aarch64__)
+    
+    // The float and half-float kernels need the pairwise addition of two
+    // float vectors, which only AArch64 has.  Each iteration produces 4
+    // result pixels, from two loads of 4 pixels from each row.  For half
+    // floats, the 8 halves of one load are converted to two float vectors.
+    
+    inline float32x4_t reduceFloatsBy2NEON(float32x4_t a0, float32x4_t a1,
+                                           float32x4_t b0, float32x4_t b1)
+    {
+        return vmulq_n_f32(vpaddq_f32(vaddq_f32(a0, b0), vaddq_f32(a1, b1)),
+                           0.25f);
+    }
+    
+#define AGL_REDUCE_ROW_BY_2_NEON_F32(N, LoadType, load, store)              \
+    GLsizei reduceRowBy2NEON##N(GLfloat* result, const GLfloat* row0,       \
+                                const GLfloat* row1, GLsizei resultWidth)   \
+    {                                                                       \
+        const GLsizei n = resultWidth / 4;                                  \
+        for (GLsizei i = 0; i < n; ++i)                                     \
+        {                                                                   \
+            LoadType a0 = load(row0);                                       \
+            LoadType a1 = load(row0 + 4 * N);                               \
+            LoadType b0 = load(row1);                                       \
+            LoadType b1 = load(row1 + 4 * N);                               \
+            LoadType r;                                                     \
+            for (int k = 0; k < N; ++k)                                     \
+            {                                                               \
+                r.val[k] = reduceFloatsBy2NEON(a0.val[k], a1.val[k],        \
+                                               b0.val[k], b1.val[k]);       \
+            }                                                               \
+            store(result, r);                                               \
+            row0 += 8 * N;                                                  \
+            row1 += 8 * N;                                                  \
+            result += 4 * N;                                                \
+        }                                                                   \
+        return n * 4;                                                       \
+    }
+    
+    AGL_REDUCE_ROW_BY_2_NEON_F32(2, float32x4x2_t, vld2q_f32, vst2q_f32)
+    AGL_REDUCE_ROW_BY_2_NEON_F32(3, float32x4x3_t, vld3q_f32, vst3q_f32)
+    AGL_REDUCE_ROW_BY_2_NEON_F32(4, float32x4x4_t, vld4q_f32, vst4q_f32)
+    
+#undef AGL_REDUCE_ROW_BY_2_NEON_F32
+    
+    GLsizei reduceRowBy2NEON1(GLfloat* result, const GLfloat* row0,
+                              const GLfloat* row1, GLsizei resultWidth)
+    {
+        const GLsizei n = resultWidth / 4;
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            vst1q_f32(result, reduceFloatsBy2NEON(vld1q_f32(row0),
+                                                  vld1q_f32(row0 + 4),
+                                                  vld1q_f32(row1),
+                                                  vld1q_f32(row1 + 4)));
+            row0 += 8;
+            row1 += 8;
+            result += 4;
+        }
+        return n * 4;
+    }
+    
+    inline uint16x4_t reduceHalvesBy2NEON(uint16x8_t a, uint16x8_t b)
+    {
+        float16x8_t ha = vreinterpretq_f16_u16(a);
+        float16x8_t hb = vreinterpretq_f16_u16(b);
+        float32x4_t r = reduceFloatsBy2NEON(vcvt_f32_f16(vget_low_f16(ha)),
+                                            vcvt_high_f32_f16(ha),
+                                            vcvt_f32_f16(vget_low_f16(hb)),
+                                            vcvt_high_f32_f16(hb));
+        return vreinterpret_u16_f16(vcvt_f16_f32(r));
+    }
+    
+#define AGL_REDUCE_ROW_BY_2_NEON_F16(N, LoadType, StoreType, load, store)   \
+    GLsizei reduceRowBy2NEON##N(half* result, const half* row0,             \
+                                const half* row1, GLsizei resultWidth)      \
+    {                                                                       \
+        uint16_t* r16 = reinterpret_cast<uint16_t*>(result);                \
+        const uint16_t* a16 = reinterpret_cast<const uint16_t*>(row0);      \
+        const uint16_t* b16 = reinterpret_cast<const uint16_t*>(row1);      \
+        const GLsizei n = resultWidth / 4;                                  \
+        for (GLsizei i = 0; i < n; ++i)                                     \
+        {                                                                   \
+            LoadType a = load(a16);                                         \
+            LoadType b = load(b16);                                         \
+            StoreType r;                                                    \
+            for (int k = 0; k < N; ++k)                                     \
+                r.val[k] = reduceHalvesBy2NEON(a.val[k], b.val[k]);         \
+            store(r16, r);                                                  \
+            a16 += 8 * N;                                                   \
+            b16 += 8 * N;                                                   \
+            r16 += 4 * N;                                                   \
+        }                                                                   \
+        return n * 4;                                                       \
+    }
+    
+    AGL_REDUCE_ROW_BY_2_NEON_F16(2, uint16x8x2_t, uint16x4x2_t, vld2q_u16, vst2_u16)
+    AGL_REDUCE_ROW_BY_2_NEON_F16(3, uint16x8x3_t, uint16x4x3_t, vld3q_u16, vst3_u16)
+    AGL_REDUCE_ROW_BY_2_NEON_F16(4, uint16x8x4_t, uint16x4x4_t, vld4q_u16, vst4_u16)
+    
+#undef AGL_REDUCE_ROW_BY_2_NEON_F16
+    
+    GLsizei reduceRowBy2NEON1(half* result, const half* row0,
+                              const half* row1, GLsizei resultWidth)
+    {
+        uint16_t* r16 = reinterpret_cast<uint16_t*>(result);
+        const uint16_t* a16 = reinterpret_cast<const uint16_t*>(row0);
+        const uint16_t* b16 = reinterpret_cast<const uint16_t*>(row1);
+        const GLsizei n = resultWidth / 4;
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            vst1_u16(r16, reduceHalvesBy2NEON(vld1q_u16(a16), vld1q_u16(b16)));
+            a16 += 8;
+            b16 += 8;
+            r16 += 4;
+        }
+        return n * 4;
+    }
+    
+#endif
+    
+    template <typename T>
+    void reduceRowBy2NEON(T* result, const T* row0, const T* row1,
+                          GLsizei resultWidth, GLsizei componentsPerPixel)
+    {
+        GLsizei done = 0;
+        switch (componentsPerPixel)
+        {
+            case 1:
+                done = reduceRowBy2NEON1(result, row0, row1, resultWidth);
+                break;
+            case 2:
+                done = reduceRowBy2NEON2(result, row0, row1, resultWidth);
+                break;
+            case 3:
+                done = reduceRowBy2NEON3(result, row0, row1, resultWidth);
+                break;
+            case 4:
+                done = reduceRowBy2NEON4(result, row0, row1, resultWidth);
+                break;
+            default:
+                break;
+        }
+        reduceRowBy2Scalar(result, row0, row1, resultWidth, componentsPerPixel,
+                           done);
+    }
+    
+#endif
+    
+    // Choose the fastest implementation the CPU supports for each component
+    // type.  F16C is detected at runtime, like AVX2.
+    
+    template <typename T>
+    typename ReduceRowBy2Typed<T>::Function chooseReduceRowBy2();
+    
+    template <>
+    ReduceRowBy2Typed<GLushort>::Function chooseReduceRowBy2<GLushort>()
+    {
+#if defined(AGL_SIMD_X86)
+        return reduceRowBy2SSE2<GLushort>;
+#elif defined(AGL_SIMD_NEON)
+        return reduceRowBy2NEON<GLushort>;
+#else
+        return reduceRowBy2Scalar<GLushort>;
+#endif
+    }
+    
+    template <>
+    ReduceRowBy2Typed<half>::Function chooseReduceRowBy2<half>()
+    {
+#if defined(AGL_SIMD_F16C)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("f16c"))
+            return reduceRowBy2F16C;
+#endif
+#if defined(AGL_SIMD_NEON) && defined(__aarch64__)
+        return reduceRowBy2NEON<half>;
+#else
+        return reduceRowBy2Scalar<half>;
+#endif
+    }
+    
+    template <>
+    ReduceRowBy2Typed<GLfloat>::Function chooseReduceRowBy2<GLfloat>()
+    {
+#if defined(AGL_SIMD_X86)
+        return reduceRowBy2SSE2<GLfloat>;
+#elif defined(AGL_SIMD_NEON) && defined(__aarch64__)
+        return reduceRowBy2NEON<GLfloat>;
+#else
+        return reduceRowBy2Scalar<GLfloat>;
+#endif
+    }
+    
+    template <typename T>
+    typename ReduceRowBy2Typed<T>::Function reduceRowBy2()
+    {
+        static const typename ReduceRowBy2Typed<T>::Function function =
+            chooseReduceRowBy2<T>();
+        return function;
+    }
+    
+    // Reduce the result rows from beginRow up to (but not including) endRow,
+    // with the other arguments as for the typed Agl::reduceImageBy2().
+    
+    template <typename T>
+    void reduceImageBy2Rows(T* result, const T* orig, GLsizei width,
+                            GLsizei componentsPerPixel, GLsizei rowLength,
+                            GLsizei skipPixels, GLsizei skipRows,
+                            GLsizei beginRow, GLsizei endRow)
+    {
+        if (rowLength == 0)
+            rowLength = width;
+        
+        GLsizei resultWidth = width / 2;
+        
+        const size_t origRowSize = size_t(rowLength) * componentsPerPixel;
+        const size_t resultRowSize = size_t(resultWidth) * componentsPerPixel;
+        
+        const T* origRow = orig + size_t(skipPixels) * componentsPerPixel +
+                           (skipRows + 2 * size_t(beginRow)) * origRowSize;
+        T* resultRow = result + beginRow * resultRowSize;
+        
+        typename ReduceRowBy2Typed<T>::Function reduceRow = reduceRowBy2<T>();
+        
+        for (GLsizei i = beginRow; i < endRow; ++i)
+        {
+            reduceRow(resultRow, origRow, origRow + origRowSize, resultWidth,
+                      componentsPerPixel);
+            origRow += 2 * origRowSize;
+            resultRow += resultRowSize;
+        }
+    }
+    
+    // The tables for Agl::reduceImageBy2Srgb().  The linear intensity of
+    // sRGB byte s is toLinear[s], scaled so 1 is 65535.  The sRGB byte for a
+    // linear intensity v is fromLinear[v >> 4], plus one if v is at least the
+    // threshold for that byte plus one.  The threshold for byte s is the
+    // smallest linear intensity that rounds to s.  No two thresholds fall in
+    // the same group of 16 intensities (the closest two, apart from byte 0's
+    // threshold of 0, are 19 apart), so one step of correction suffices.
+    
+    struct SrgbTables
+    {
+        SrgbTables();
+        
+        uint16_t    toLinear[256];
+        GLubyte     fromLinear[4096];
+        uint32_t    threshold[257];
+    };
+    
+    SrgbTables::SrgbTables()
+    {
+        for (int s = 0; s < 256; ++s)
+        {
+            double c = s / 255.0;
+            double v = (c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+            toLinear[s] = uint16_t(lround(v * 65535.0));
+        }
+        
+        threshold[0] = 0;
+        for (int s = 1; s < 256; ++s)
+        {
+            double c = (s - 0.5) / 255.0;
+            double v = (c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+            threshold[s] = uint32_t(ceil(v * 65535.0));
+        }
+        threshold[256] = 65536;
+        
+        int s = 0;
+        for (int i = 0; i < 4096; ++i)
+        {
+            while (threshold[s + 1] <= uint32_t(i << 4))
+                ++s;
+            fromLinear[i] = GLubyte(s);
+        }
+    }
+    
+    const SrgbTables& srgbTables()
+    {
+        static const SrgbTables tables;
+        return tables;
+    }
+    
+    inline GLubyte linearToSrgb(const SrgbTables& tables, uint32_t v)
+    {
+        GLubyte s = tables.fromLinear[v >> 4];
+        return GLubyte(s + (v >= tables.threshold[s + 1]));
+    }
+    
+    template <int BytesPerPixel, bool HasAlpha>
+    void reduceRowBy2Srgb(GLubyte* result, const GLubyte* row0,
+                          const GLubyte* row1, GLsizei resultWidth,
+                          const SrgbTables& tables)
+    {
+        const uint16_t* toLinear = tables.toLinear;
+        const int colorBytes = HasAlpha ? BytesPerPixel - 1 : BytesPerPixel;
+        
+        for (GLsizei j = 0; j < resultWidth; ++j)
+        {
+            for (int k = 0; k < colorBytes; ++k)
+            {
+                uint32_t sum = toLinear[row0[k]] +
+                               toLinear[row0[k + BytesPerPixel]] +
+                               toLinear[row1[k]] +
+                               toLinear[row1[k + BytesPerPixel]];
+                result[k] = linearToSrgb(tables, (sum + 2) >> 2);
+            }
+            if (HasAlpha)
+            {
+                const int k = BytesPerPixel - 1;
+                result[k] = GLubyte((row0[k] + row0[k + BytesPerPixel] +
+                                     row1[k] + row1[k + BytesPerPixel] + 2) >> 2);
+            }
+            
+            result += BytesPerPixel;
+            row0 += 2 * BytesPerPixel;
+            row1 += 2 * BytesPerPixel;
+        }
+    }
+    
+    // The fixed-point weights for reducing n original pixels to m result
+    // pixels in one dimension by area averaging.  Result pixel i is the sum
+    // over j from 0 to count[i] - 1 of weight[offset[i] + j] times original
+    // pixel first[i] + j.  The weights for each result pixel sum to exactly
+    // 1 << AreaWeightBits, so a constant image stays constant.
+    
+    const int AreaWeightBits = 14;
+    
+    struct AreaWeights
+    {
+        AreaWeights(GLsizei n, GLsizei m);
+        
+        std::vector<GLsizei>    first;
+        std::vector<GLsizei>    count;
+        std::vector<size_t>     offset;
+        std::vector<GLushort>   weight;
+    };
+    
+    AreaWeights::AreaWeights(GLsizei n, GLsizei m) :
+        first(m), count(m), offset(m)
+    {
+        // In units of 1 / m of an original pixel, original pixel j covers
+        // [j * m, (j + 1) * m) and result pixel i covers [i * n, (i + 1) * n).
+        
+        for (GLsizei i = 0; i < m; ++i)
+        {
+            const int64_t begin = int64_t(i) * n;
+            const int64_t end = begin + n;
+            
+            first[i] = GLsizei(begin / m);
+            count[i] = GLsizei((end - 1) / m) - first[i] + 1;
+            offset[i] = weight.size();
+            
+            GLuint sum = 0;
+            size_t largest = offset[i];
+            for (GLsizei j = first[i]; j < first[i] + count[i]; ++j)
+            {
+                int64_t overlap = std::min(end, int64_t(j + 1) * m) -
+                                  std::max(begin, int64_t(j) * m);
+                GLushort w = GLushort(((overlap << AreaWeightBits) + n / 2) / n);
+                weight.push_back(w);
+                if (w > weight[largest])
+                    largest = weight.size() - 1;
+                sum += w;
+            }
+            
+            // Put the rounding error in the largest weight, where it matters
+            // least.
+            
+            weight[largest] += GLushort((1 << AreaWeightBits) - GLint(sum));
+        }
+    }
+    
+    // The vertical pass of Agl::reduceImage() sums count original rows, each
+    // rowSize bytes after the previous one, multiplied by the weights.  The n
+    // sums are stored as 16-bit values with IntermediateBits fractional
+    // bits, which leaves them small enough for signed 16-bit arithmetic in
+    // the horizontal pass.
+    
+    const int IntermediateBits = 7;
+    
+    void sumWeightedRows(GLushort* result, const GLubyte* row, size_t rowSize,
+                         const GLushort* weight, GLsizei count, size_t n)
+    {
+        const int shift = AreaWeightBits - IntermediateBits;
+        size_t i = 0;
+        
+#if defined(AGL_SIMD_X86)
+        // Interleaving the bytes of two rows lets one multiply-add apply the
+        // weights of both rows.
+        
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i half = _mm_set1_epi32(1 << (shift - 1));
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i sum0 = half;
+            __m128i sum1 = half;
+            __m128i sum2 = half;
+            __m128i sum3 = half;
+            const GLubyte* r = row + i;
+            for (GLsizei k = 0; k < count; k += 2, r += 2 * rowSize)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r));
+                __m128i b = zero;
+                GLint w = weight[k];
+                if (k + 1 < count)
+                {
+                    b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + rowSize));
+                    w |= GLint(weight[k + 1]) << 16;
+                }
+                __m128i weights = _mm_set1_epi32(w);
+                __m128i lo = _mm_unpacklo_epi8(a, b);
+                __m128i hi = _mm_unpackhi_epi8(a, b);
+                sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), weights));
+                sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), weights));
+                sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), weights));
+                sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), weights));
+            }
+            __m128i* out = reinterpret_cast<__m128i*>(result + i);
+            _mm_storeu_si128(out, _mm_packs_epi32(_mm_srli_epi32(sum0, shift),
+                                                  _mm_srli_epi32(sum1, shift)));
+            _mm_storeu_si128(out + 1, _mm_packs_epi32(_mm_srli_epi32(sum2, shift),
+                                                      _mm_srli_epi32(sum3, shift)));
+        }
+#elif defined(AGL_SIMD_NEON)
+        for (; i + 8 <= n; i += 8)
+        {
+            uint32x4_t lo = vdupq_n_u32(0);
+            uint32x4_t hi = vdupq_n_u32(0);
+            for (GLsizei k = 0; k < count; ++k)
+            {
+                uint16x8_t values = vmovl_u8(vld1_u8(row + k * rowSize + i));
+                lo = vmlal_n_u16(lo, vget_low_u16(values), weight[k]);
+                hi = vmlal_n_u16(hi, vget_high_u16(values), weight[k]);
+            }
+            vst1q_u16(result + i, vcombine_u16(vrshrn_n_u32(lo, shift),
+                                               vrshrn_n_u32(hi, shift)));
+        }
+#endif
+        
+        for (; i < n; ++i)
+        {
+            GLuint sum = 0;
+            for (GLsizei k = 0; k < count; ++k)
+                sum += GLuint(row[k * rowSize + i]) * weight[k];
+            result[i] = GLushort((sum + (1 << (shift - 1))) >> shift);
+        }
+    }
+    
+    // The horizontal pass of Agl::reduceImage() computes one result row from
+    // the output of the vertical pass.  A non-zero BytesPerPixel lets the
+    // compiler unroll the loop over components.
+    
+    template <int BytesPerPixel>
+    void sumWeightedColumns(GLubyte* result, const GLushort* row,
+                            const AreaWeights& columnWeights,
+                            GLsizei bytesPerPixel)
+    {
+        if (BytesPerPixel != 0)
+            bytesPerPixel = BytesPerPixel;
+        
+        const int shift = AreaWeightBits + IntermediateBits;
+        const GLsizei resultWidth = GLsizei(columnWeights.first.size());
+        
+        for (GLsizei j = 0; j < resultWidth; ++j)
+        {
+            const GLushort* column = row + size_t(columnWeights.first[j]) * bytesPerPixel;
+            const GLushort* weight = columnWeights.weight.data() + columnWeights.offset[j];
+            const GLsizei count = columnWeights.count[j];
+            
+            for (GLsizei c = 0; c < bytesPerPixel; ++c)
+            {
+                GLuint sum = 1 << (shift - 1);
+                for (GLsizei k = 0; k < count; ++k)
+                    sum += GLuint(weight[k]) * column[k * bytesPerPixel + c];
+                *result++ = GLubyte(sum >> shift);
+            }
+        }
+    }
+    
+#if defined(AGL_SIMD_X86)
+    
+    // With four bytes per pixel, a pixel of the vertical pass output fits in
+    // 64 bits, so two adjacent pixels can be interleaved and multiplied by
+    // their weights with one multiply-add.
+    
+    template <>
+    void sumWeightedColumns<4>(GLubyte* result, const GLushort* row,
+                               const AreaWeights& columnWeights, GLsizei)
+    {
+        const int shift = AreaWeightBits + IntermediateBits;
+        const __m128i half = _mm_set1_epi32(1 << (shift - 1));
+        const GLsizei resultWidth = GLsizei(columnWeights.first.size());
+        
+        for (GLsizei j = 0; j < resultWidth; ++j)
+        {
+            const GLushort* column = row + size_t(columnWeights.first[j]) * 4;
+            const GLushort* weight = columnWeights.weight.data() + columnWeights.offset[j];
+            const GLsizei count = columnWeights.count[j];
+            
+            __m128i sum = half;
+            GLsizei k = 0;
+            for (; k + 2 <= count; k += 2)
+            {
+                __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + 4 * k));
+                __m128i pairs = _mm_unpacklo_epi16(pixels, _mm_srli_si128(pixels, 8));
+                __m128i w = _mm_set1_epi32(GLint(weight[k]) | (GLint(weight[k + 1]) << 16));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(pairs, w));
+            }
+            if (k < count)
+            {
+                __m128i pixel = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(column + 4 * k));
+                __m128i pairs = _mm_unpacklo_epi16(pixel, _mm_setzero_si128());
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(pairs, _mm_set1_epi32(weight[k])));
+            }
+            
+            __m128i r = _mm_srli_epi32(sum, shift);
+            r = _mm_packus_epi16(_mm_packs_epi32(r, r), r);
+            GLint bytes = _mm_cvtsi128_si32(r);
+            memcpy(result, &bytes, 4);
+            result += 4;
+        }
+    }
+    
+#endif
+    
+    
+    // The conversions from YUV to RGB use the BT.601 video-range matrix, in
+    // fixed point with YuvBits fractional bits.  Every path computes, for
+    // example, red as (YuvY * (Y - 16) + YuvRV * (V - 128) + YuvRound) >>
+    // YuvBits, clamped to a byte, so the paths give identical results.
+    
+    const int YuvBits = 13;
+    const int YuvRound = 1 << (YuvBits - 1);
+    const int YuvY = 9539;
+    const int YuvRV = 13075;
+    const int YuvGU = 3209;
+    const int YuvGV = 6660;
+    const int YuvBU = 16525;
+    
+    inline GLubyte clampToByte(int value)
+    {
+        return GLubyte(std::min(std::max(value, 0), 255));
+    }
+    
+    // Convert one pixel.  The y, u and v arguments are Y - 16, U - 128 and
+    // V - 128, times 1 << ExtraBits, so they can be sums of several samples
+    // (e.g., of the four samples averaged by a reduction).
+    
+    template <int ExtraBits>
+    inline void convertYuvToRgbaScalar(GLubyte* result, int y, int u, int v)
+    {
+        const int bits = YuvBits + ExtraBits;
+        int luma = YuvY * y + (YuvRound << ExtraBits);
+        result[0] = clampToByte((luma + YuvRV * v) >> bits);
+        result[1] = clampToByte((luma - YuvGU * u - YuvGV * v) >> bits);
+        result[2] = clampToByte((luma + YuvBU * u) >> bits);
+        result[3] = 255;
+    }
+    
+#if defined(AGL_SIMD_X86)
+    
+    // Convert eight pixels.  The y argument has Y - 16 for each pixel as 16-bit
+    // values.  The uv0 and uv1 arguments have U - 128 and V - 128 as pairs
+    // of 16-bit values, for pixels 0 to 3 and 4 to 7 respectively.  All are
+    // times 1 << ExtraBits, as for convertYuvToRgbaScalar().
+    
+    template <int ExtraBits>
+    inline void convertYuvToRgbaSSE2(GLubyte* result, __m128i y, __m128i uv0,
+                                     __m128i uv1)
+    {
+        const int bits = YuvBits + ExtraBits;
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i yCoefficient = _mm_set1_epi32(YuvY);
+        const __m128i round = _mm_set1_epi32(YuvRound << ExtraBits);
+        const __m128i rCoefficients = _mm_set1_epi32(YuvRV << 16);
+        const __m128i gCoefficients = _mm_setr_epi16(-YuvGU, -YuvGV, -YuvGU, -YuvGV,
+                                                     -YuvGU, -YuvGV, -YuvGU, -YuvGV);
+        const __m128i bCoefficients = _mm_set1_epi32(YuvBU);
+        
+        // With the high 16 bits zero, a multiply-add gives YuvY * (Y - 16).
+        
+        __m128i luma0 = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, zero),
+                                                     yCoefficient), round);
+        __m128i luma1 = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, zero),
+                                                     yCoefficient), round);
+        
+        __m128i r = _mm_packs_epi32(
+            _mm_srai_epi32(_mm_add_epi32(luma0, _mm_madd_epi16(uv0, rCoefficients)), bits),
+            _mm_srai_epi32(_mm_add_epi32(luma1, _mm_madd_epi16(uv1, rCoefficients)), bits));
+        __m128i g = _mm_packs_epi32(
+            _mm_srai_epi32(_mm_add_epi32(luma0, _mm_madd_epi16(uv0, gCoefficients)), bits),
+            _mm_srai_epi32(_mm_add_epi32(luma1, _mm_madd_epi16(uv1, gCoefficients)), bits));
+        __m128i b = _mm_packs_epi32(
+            _mm_srai_epi32(_mm_add_epi32(luma0, _mm_madd_epi16(uv0, bCoefficients)), bits),
+            _mm_srai_epi32(_mm_add_epi32(luma1, _mm_madd_epi16(uv1, bCoefficients)), bits));
+        
+        // Saturate to bytes, and interleave into RGBA pixels.
+        
+        __m128i rb = _mm_packus_epi16(r, b);
+        __m128i ga = _mm_packus_epi16(g, _mm_set1_epi16(255));
+        __m128i rg = _mm_unpacklo_epi8(rb, ga);
+        __m128i ba = _mm_unpackhi_epi8(rb, ga);
+        __m128i* out = reinterpret_cast<__m128i*>(result);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rg, ba));
+    }
+    
+#endif
+    
+    // Convert one row of width pixels.  The row argument starts at an even
+    // pixel, so its first two bytes are the Y and U of the first pixel.
+    
+    void convertYuyvRowToRgba(GLubyte* result, const GLubyte* row, GLsizei width)
+    {
+        GLsizei j = 0;
+#if defined(AGL_SIMD_X86)
+        const __m128i lowBytes = _mm_set1_epi16(0xff);
+        const __m128i yOffset = _mm_set1_epi16(16);
+        const __m128i uvOffset = _mm_set1_epi16(128);
+        for (; j + 8 <= width; j += 8)
+        {
+            __m128i yuyv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 2 * j));
+            __m128i y = _mm_sub_epi16(_mm_and_si128(yuyv, lowBytes), yOffset);
+            __m128i uv = _mm_sub_epi16(_mm_srli_epi16(yuyv, 8), uvOffset);
+            convertYuvToRgbaSSE2<0>(result + 4 * j, y, _mm_unpacklo_epi32(uv, uv),
+                                    _mm_unpackhi_epi32(uv, uv));
+        }
+#endif
+        for (; j < width; ++j)
+        {
+            const GLubyte* pair = row + 4 * (j / 2);
+            convertYuvToRgbaScalar<0>(result + 4 * j, row[2 * j] - 16,
+                                      pair[1] - 128, pair[3] - 128);
+        }
+    }
+    
+    // Convert one row of width pixels, with the uvRow argument being the row
+    // of the chroma plane for this row, starting at the first pixel's chroma.
+    
+    void convertNv12RowToRgba(GLubyte* result, const GLubyte* yRow,
+                              const GLubyte* uvRow, GLsizei width)
+    {
+        GLsizei j = 0;
+#if defined(AGL_SIMD_X86)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i yOffset = _mm_set1_epi16(16);
+        const __m128i uvOffset = _mm_set1_epi16(128);
+        for (; j + 8 <= width; j += 8)
+        {
+            __m128i y = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(yRow + j));
+            __m128i uv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(uvRow + j));
+            y = _mm_sub_epi16(_mm_unpacklo_epi8(y, zero), yOffset);
+            uv = _mm_sub_epi16(_mm_unpacklo_epi8(uv, zero), uvOffset);
+            convertYuvToRgbaSSE2<0>(result + 4 * j, y, _mm_unpacklo_epi32(uv, uv),
+                                    _mm_unpackhi_epi32(uv, uv));
+        }
+#endif
+        for (; j < width; ++j)
+        {
+            const GLubyte* pair = uvRow + 2 * (j / 2);
+            convertYuvToRgbaScalar<0>(result + 4 * j, yRow[j] - 16,
+                                      pair[0] - 128, pair[1] - 128);
+        }
+    }
+    
+    void convertBgraRowToRgba(GLubyte* result, const GLubyte* row, GLsizei width)
+    {
+        GLsizei j = 0;
+#if defined(AGL_SIMD_X86)
+        const __m128i greenAlpha = _mm_set1_epi32(0xff00ff00);
+        const __m128i lowByte = _mm_set1_epi32(0xff);
+        for (; j + 4 <= width; j += 4)
+        {
+            __m128i bgra = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 4 * j));
+            __m128i rgba = _mm_or_si128(_mm_and_si128(bgra, greenAlpha),
+                                        _mm_or_si128(_mm_and_si128(_mm_srli_epi32(bgra, 16), lowByte),
+                                                     _mm_slli_epi32(_mm_and_si128(bgra, lowByte), 16)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(result + 4 * j), rgba);
+        }
+#endif
+        for (; j < width; ++j)
+        {
+            result[4 * j] = row[4 * j + 2];
+            result[4 * j + 1] = row[4 * j + 1];
+            result[4 * j + 2] = row[4 * j];
+            result[4 * j + 3] = row[4 * j + 3];
+        }
+    }
+    
+    // Convert and reduce by 2 two rows of a YUYV image, starting at an even
+    // pixel, into one row of resultWidth RGBA pixels.  Each result pixel is
+    // converted from the sums of the four Y samples and the two U and V
+    // samples it covers, so the averaging is done before the conversion,
+    // with no rounding in between.
+    
+    void reduceYuyvRowsToRgbaBy2(GLubyte* result, const GLubyte* row0,
+                                 const GLubyte* row1, GLsizei resultWidth)
+    {
+        GLsizei j = 0;
+#if defined(AGL_SIMD_X86)
+        const __m128i lowByte = _mm_set1_epi32(0xff);
+        const __m128i yOffset = _mm_set1_epi16(4 * 16);
+        const __m128i uvOffset = _mm_set1_epi16(2 * 128);
+        for (; j + 8 <= resultWidth; j += 8)
+        {
+            const __m128i* p0 = reinterpret_cast<const __m128i*>(row0 + 4 * j);
+            const __m128i* p1 = reinterpret_cast<const __m128i*>(row1 + 4 * j);
+            __m128i a0 = _mm_loadu_si128(p0);
+            __m128i b0 = _mm_loadu_si128(p0 + 1);
+            __m128i a1 = _mm_loadu_si128(p1);
+            __m128i b1 = _mm_loadu_si128(p1 + 1);
+            
+            // Each 32-bit lane is Y0 U Y1 V for one result pixel.
+            
+            __m128i ya = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(a0, lowByte),
+                                                     _mm_and_si128(_mm_srli_epi32(a0, 16), lowByte)),
+                                       _mm_add_epi32(_mm_and_si128(a1, lowByte),
+                                                     _mm_and_si128(_mm_srli_epi32(a1, 16), lowByte)));
+            __m128i yb = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(b0, lowByte),
+                                                     _mm_and_si128(_mm_srli_epi32(b0, 16), lowByte)),
+                                       _mm_add_epi32(_mm_and_si128(b1, lowByte),
+                                                     _mm_and_si128(_mm_srli_epi32(b1, 16), lowByte)));
+            __m128i y = _mm_sub_epi16(_mm_packs_epi32(ya, yb), yOffset);
+            
+            __m128i uva = _mm_add_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8));
+            __m128i uvb = _mm_add_epi16(_mm_srli_epi16(b0, 8), _mm_srli_epi16(b1, 8));
+            uva = _mm_slli_epi16(_mm_sub_epi16(uva, uvOffset), 1);
+            uvb = _mm_slli_epi16(_mm_sub_epi16(uvb, uvOffset), 1);
+            
+            convertYuvToRgbaSSE2<2>(result + 4 * j, y, uva, uvb);
+        }
+#endif
+        for (; j < resultWidth; ++j)
+        {
+            const GLubyte* p0 = row0 + 4 * j;
+            const GLubyte* p1 = row1 + 4 * j;
+            convertYuvToRgbaScalar<2>(result + 4 * j,
+                                      p0[0] + p0[2] + p1[0] + p1[2] - 4 * 16,
+                                      2 * (p0[1] + p1[1] - 2 * 128),
+                                      2 * (p0[3] + p1[3] - 2 * 128));
+        }
+    }
+    
+    // Convert and reduce by 2 two rows of the Y plane of an NV12 image, and
+    // the row of the chroma plane they share, into one row of resultWidth
+    // RGBA pixels.  The chroma plane has one sample for each result pixel.
+    
+    void reduceNv12RowsToRgbaBy2(GLubyte* result, const GLubyte* yRow0,
+                                 const GLubyte* yRow1, const GLubyte* uvRow,
+                                 GLsizei resultWidth)
+    {
+        GLsizei j = 0;
+#if defined(AGL_SIMD_X86)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lowByte = _mm_set1_epi16(0xff);
+        const __m128i yOffset = _mm_set1_epi16(4 * 16);
+        const __m128i uvOffset = _mm_set1_epi16(128);
+        for (; j + 8 <= resultWidth; j += 8)
+        {
+            __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(yRow0 + 2 * j));
+            __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(yRow1 + 2 * j));
+            __m128i y = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(y0, lowByte),
+                                                    _mm_srli_epi16(y0, 8)),
+                                      _mm_add_epi16(_mm_and_si128(y1, lowByte),
+                                                    _mm_srli_epi16(y1, 8)));
+            y = _mm_sub_epi16(y, yOffset);
+            
+            __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uvRow + 2 * j));
+            __m128i uv0 = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(uv, zero), uvOffset), 2);
+            __m128i uv1 = _mm_slli_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(uv, zero), uvOffset), 2);
+            
+            convertYuvToRgbaSSE2<2>(result + 4 * j, y, uv0, uv1);
+        }
+#endif
+        for (; j < resultWidth; ++j)
+        {
+            const GLubyte* y0 = yRow0 + 2 * j;
+            const GLubyte* y1 = yRow1 + 2 * j;
+            const GLubyte* uv = uvRow + 2 * j;
+            convertYuvToRgbaScalar<2>(result + 4 * j,
+                                      y0[0] + y0[1] + y1[0] + y1[1] - 4 * 16,
+                                      4 * (uv[0] - 128), 4 * (uv[1] - 128));
+        }
+    }
+    
+    // Throw a std::invalid_argument exception if the images of a pool do not
+    // have the specified size.
+    
+    void checkPoolImageSize(const Agl::ImagePool& pool, GLsizei width,
+                            GLsizei height, GLsizei bytesPerPixel,
+                            const char* function)
+    {
+        if ((pool.imageWidth() != width) || (pool.imageHeight() != height) ||
+            (pool.bytesPerPixel() != bytesPerPixel))
+        {
+            throw std::invalid_argument(std::string(function) + ": the pool's "
+                                        "image size does not match");
+        }
+    }
+}
 
 namespace Agl
 {
@@ -53,40 +1691,709 @@ namespace Agl
                         GLsizei width, GLsizei height, GLsizei bytesPerPixel,
                         GLsizei rowLength, GLsizei skipPixels, GLsizei skipRows)
     {
+        reduceImageBy2Rows(result, orig, width, bytesPerPixel, rowLength,
+                           skipPixels, skipRows, 0, height / 2);
+    }
+    
+    void reduceImageBy2Parallel(GLubyte* result, const GLubyte* orig,
+                                GLsizei width, GLsizei height,
+                                GLsizei bytesPerPixel, GLsizei rowLength,
+                                GLsizei skipPixels, GLsizei skipRows,
+                                GLsizei threadCount)
+    {
+        forEachBand(height / 2, threadCount, [&](GLsizei beginRow,
+                                                 GLsizei endRow)
+        {
+            reduceImageBy2Rows(result, orig, width, bytesPerPixel, rowLength,
+                               skipPixels, skipRows, beginRow, endRow);
+        });
+    }
+
+    void reduceImageBy2(GLushort* result, const GLushort* orig,
+                        GLsizei width, GLsizei height,
+                        GLsizei componentsPerPixel, GLsizei rowLength,
+                        GLsizei skipPixels, GLsizei skipRows)
+    {
+        reduceImageBy2Rows(result, orig, width, componentsPerPixel, rowLength,
+                           skipPixels, skipRows, 0, height / 2);
+    }
+    
+    void reduceImageBy2(half* result, const half* orig,
+                        GLsizei width, GLsizei height,
+                        GLsizei componentsPerPixel, GLsizei rowLength,
+                        GLsizei skipPixels, GLsizei skipRows)
+    {
+        reduceImageBy2Rows(result, orig, width, componentsPerPixel, rowLength,
+                           skipPixels, skipRows, 0, height / 2);
+    }
+    
+    void reduceImageBy2(GLfloat* result, const GLfloat* orig,
+                        GLsizei width, GLsizei height,
+                        GLsizei componentsPerPixel, GLsizei rowLength,
+                        GLsizei skipPixels, GLsizei skipRows)
+    {
+        reduceImageBy2Rows(result, orig, width, componentsPerPixel, rowLength,
+                           skipPixels, skipRows, 0, height / 2);
+    }
+    
+    void reduceImageBy2Parallel(GLushort* result, const GLushort* orig,
+                                GLsizei width, GLsizei height,
+                                GLsizei componentsPerPixel, GLsizei rowLength,
+                                GLsizei skipPixels, GLsizei skipRows,
+                                GLsizei threadCount)
+    {
+        forEachBand(height / 2, threadCount, [&](GLsizei beginRow,
+                                                 GLsizei endRow)
+        {
+            reduceImageBy2Rows(result, orig, width, componentsPerPixel,
+                               rowLength, skipPixels, skipRows, beginRow,
+                               endRow);
+        });
+    }
+    
+    void reduceImageBy2Parallel(half* result, const half* orig,
+                                GLsizei width, GLsizei height,
+                                GLsizei componentsPerPixel, GLsizei rowLength,
+                                GLsizei skipPixels, GLsizei skipRows,
+                                GLsizei threadCount)
+    {
+        forEachBand(height / 2, threadCount, [&](GLsizei beginRow,
+                                                 GLsizei endRow)
+        {
+            reduceImageBy2Rows(result, orig, width, componentsPerPixel,
+                               rowLength, skipPixels, skipRows, beginRow,
+                               endRow);
+        });
+    }
+    
+    void reduceImageBy2Parallel(GLfloat* result, const GLfloat* orig,
+                                GLsizei width, GLsizei height,
+                                GLsizei componentsPerPixel, GLsizei rowLength,
+                                GLsizei skipPixels, GLsizei skipRows,
+                                GLsizei threadCount)
+    {
+        forEachBand(height / 2, threadCount, [&](GLsizei beginRow,
+                                                 GLsizei endRow)
+        {
+            reduceImageBy2Rows(result, orig, width, componentsPerPixel,
+                               rowLength, skipPixels, skipRows, beginRow,
+                               endRow);
+        });
+    }
+    
+    void reduceImage(GLubyte* result, GLsizei resultWidth,
+                     GLsizei resultHeight, const GLubyte* orig,
+                     GLsizei width, GLsizei height, GLsizei bytesPerPixel,
+                     GLsizei rowLength, GLsizei skipPixels, GLsizei skipRows)
+    {
+        if ((resultWidth > width) || (resultHeight > height))
+        {
+            throw std::invalid_argument("Agl::reduceImage(): the result "
+                                        "cannot be larger than the original");
+        }
+        
+        if ((resultWidth <= 0) || (resultHeight <= 0))
+            return;
+        
         if (rowLength == 0)
             rowLength = width;
         
-        const GLubyte* origPtr0a = orig + bytesPerPixel * (skipRows * rowLength +
-                                                           skipPixels);
-        const GLubyte* origPtr0b = origPtr0a + bytesPerPixel;
-        const GLubyte* origPtr1a = origPtr0a + rowLength * bytesPerPixel;
-        const GLubyte* origPtr1b = origPtr1a + bytesPerPixel;
-        GLubyte *resultPtr = result;
+        const size_t origRowSize = size_t(rowLength) * bytesPerPixel;
+        const GLubyte* origRegion = orig + size_t(skipRows) * origRowSize +
+                                    size_t(skipPixels) * bytesPerPixel;
+        const size_t resultRowSize = size_t(resultWidth) * bytesPerPixel;
+        
+        AreaWeights rowWeights(height, resultHeight);
+        AreaWeights columnWeights(width, resultWidth);
+        
+        // The vertical pass sums the weighted original rows for one result
+        // row, which vectorizes well since the rows are contiguous.  The
+        // horizontal pass then sums the weighted columns of that one row.
+        
+        std::vector<GLushort> row(size_t(width) * bytesPerPixel);
+        
+        for (GLsizei i = 0; i < resultHeight; ++i)
+        {
+            sumWeightedRows(row.data(), origRegion + rowWeights.first[i] * origRowSize,
+                            origRowSize, rowWeights.weight.data() + rowWeights.offset[i],
+                            rowWeights.count[i], row.size());
+            
+            GLubyte* resultRow = result + i * resultRowSize;
+            switch (bytesPerPixel)
+            {
+                case 1:
+                    sumWeightedColumns<1>(resultRow, row.data(), columnWeights, 1);
+                    break;
+                case 3:
+                    sumWeightedColumns<3>(resultRow, row.data(), columnWeights, 3);
+                    break;
+                case 4:
+                    sumWeightedColumns<4>(resultRow, row.data(), columnWeights, 4);
+                    break;
+                default:
+                    sumWeightedColumns<0>(resultRow, row.data(), columnWeights,
+                                          bytesPerPixel);
+                    break;
+            }
+        }
+    }
+    
+    void reduceImageBy2Srgb(GLubyte* result, const GLubyte* orig,
+                            GLsizei width, GLsizei height,
+                            GLsizei bytesPerPixel, GLsizei rowLength,
+                            GLsizei skipPixels, GLsizei skipRows)
+    {
+        if (rowLength == 0)
+            rowLength = width;
         
         GLsizei resultWidth = width / 2;
         GLsizei resultHeight = height / 2;
         
-        GLsizei toNextRowOrig = (2 * rowLength - width) * bytesPerPixel;
+        const size_t origRowSize = size_t(rowLength) * bytesPerPixel;
+        const size_t resultRowSize = size_t(resultWidth) * bytesPerPixel;
+        
+        const GLubyte* origRow = orig + size_t(skipPixels) * bytesPerPixel +
+                                 size_t(skipRows) * origRowSize;
+        
+        const SrgbTables& tables = srgbTables();
+        
+        for (GLsizei i = 0; i < resultHeight; ++i)
+        {
+            const GLubyte* row0 = origRow;
+            const GLubyte* row1 = origRow + origRowSize;
+            switch (bytesPerPixel)
+            {
+                case 1:
+                    reduceRowBy2Srgb<1, false>(result, row0, row1, resultWidth,
+                                               tables);
+                    break;
+                case 2:
+                    reduceRowBy2Srgb<2, true>(result, row0, row1, resultWidth,
+                                              tables);
+                    break;
+                case 3:
+                    reduceRowBy2Srgb<3, false>(result, row0, row1, resultWidth,
+                                               tables);
+                    break;
+                case 4:
+                    reduceRowBy2Srgb<4, true>(result, row0, row1, resultWidth,
+                                              tables);
+                    break;
+                default:
+                    throw std::invalid_argument("Agl::reduceImageBy2Srgb(): "
+                                                "unsupported bytesPerPixel");
+            }
+            origRow += 2 * origRowSize;
+            result += resultRowSize;
+        }
+    }
+    
+    void generateImagePyramid(GLubyte* result, GLsizei levelCount,
+                              const GLubyte* orig, GLsizei width,
+                              GLsizei height, GLsizei bytesPerPixel,
+                              GLsizei rowLength, GLsizei skipPixels,
+                              GLsizei skipRows)
+    {
+        if (rowLength == 0)
+            rowLength = width;
+        
+        // Levels past the point where the width or height reaches zero are
+        // empty, and ignoring them keeps the tile size reasonable.
+        
+        GLsizei usedLevelCount = 0;
+        while ((usedLevelCount < levelCount) &&
+               ((width >> (usedLevelCount + 1)) > 0) &&
+               ((height >> (usedLevelCount + 1)) > 0))
+            ++usedLevelCount;
+        
+        if (usedLevelCount == 0)
+            return;
+        
+        // Entry 0 describes the original image and entry n describes level n.
+        
+        std::vector<const GLubyte*> source(usedLevelCount + 1);
+        std::vector<GLubyte*> destination(usedLevelCount + 1);
+        std::vector<size_t> rowSize(usedLevelCount + 1);
+        
+        source[0] = orig + (size_t(skipRows) * rowLength + skipPixels) * bytesPerPixel;
+        rowSize[0] = size_t(rowLength) * bytesPerPixel;
+        
+        for (GLsizei n = 1; n <= usedLevelCount; ++n)
+        {
+            rowSize[n] = size_t(width / 2) * bytesPerPixel;
+            destination[n] = result + imagePyramidSkipRows(height, n) * rowSize[n];
+            source[n] = destination[n];
+        }
+        
+        // A tile of the original image is tileHeight rows, so it reduces to
+        // a whole number of rows at every level, and it is at least as wide as
+        // it is high.  The tile width is chosen so the tile fits in a typical
+        // level 2 cache.
         
-        for (size_t i = 0; i < resultHeight; ++i)
+        const size_t cacheSize = 256 * 1024;
+        const GLsizei tileHeight = 1 << usedLevelCount;
+        GLsizei tileWidth = GLsizei(cacheSize / (size_t(tileHeight) * bytesPerPixel));
+        tileWidth = std::max(tileHeight, tileWidth - tileWidth % tileHeight);
+        
+        ReduceRowBy2Function reduceRow = reduceRowBy2();
+        
+        for (GLsizei y0 = 0; y0 < height; y0 += tileHeight)
         {
-            for (size_t j = 0; j < resultWidth; ++j)
+            for (GLsizei x0 = 0; x0 < width; x0 += tileWidth)
             {
-                for (size_t k = 0; k < bytesPerPixel; ++k)
+                for (GLsizei n = 1; n <= usedLevelCount; ++n)
                 {
-                    GLuint r = *origPtr0a++ + *origPtr0b++ + *origPtr1a++ + *origPtr1b++;
-                    *resultPtr++ = r / 4;
+                    GLsizei rowBegin = y0 >> n;
+                    GLsizei rowEnd = std::min((y0 + tileHeight) >> n, height >> n);
+                    GLsizei columnBegin = x0 >> n;
+                    GLsizei columnEnd = std::min((x0 + tileWidth) >> n, width >> n);
+                    
+                    if (columnEnd <= columnBegin)
+                        continue;
+                    
+                    size_t offset = size_t(columnBegin) * bytesPerPixel;
+                    for (GLsizei i = rowBegin; i < rowEnd; ++i)
+                    {
+                        const GLubyte* row0 = source[n - 1] + 2 * i * rowSize[n - 1] +
+                                              2 * offset;
+                        reduceRow(destination[n] + i * rowSize[n] + offset, row0,
+                                  row0 + rowSize[n - 1], columnEnd - columnBegin,
+                                  bytesPerPixel);
+                    }
                 }
-                origPtr0a += bytesPerPixel;
-                origPtr0b += bytesPerPixel;
-                origPtr1a += bytesPerPixel;
-                origPtr1b += bytesPerPixel;
             }
-            origPtr0a += toNextRowOrig;
-            origPtr0b += toNextRowOrig;
-            origPtr1a += toNextRowOrig;
-            origPtr1b += toNextRowOrig;
         }
     }
+    
+    size_t imagePyramidSize(GLsizei width, GLsizei height,
+                            GLsizei bytesPerPixel, GLsizei levelCount)
+    {
+        return size_t(width / 2) * imagePyramidSkipRows(height, levelCount + 1) *
+               bytesPerPixel;
+    }
+    
+    GLsizei imagePyramidSkipRows(GLsizei height, GLsizei level)
+    {
+        GLsizei rows = 0;
+        for (GLsizei n = 1; n < level; ++n)
+            rows += height >> n;
+        return rows;
+    }
+
+    void convertYuyvToRgba(GLubyte* result, const GLubyte* orig,
+                           GLsizei width, GLsizei height, GLsizei rowLength,
+                           GLsizei skipPixels, GLsizei skipRows,
+                           GLsizei threadCount)
+    {
+        if (skipPixels % 2 != 0)
+        {
+            throw std::invalid_argument("Agl::convertYuyvToRgba(): "
+                                        "skipPixels must be even");
+        }
+        if (rowLength == 0)
+            rowLength = width;
+        
+        const size_t origRowSize = size_t(rowLength) * 2;
+        const size_t resultRowSize = size_t(width) * 4;
+        const GLubyte* origStart = orig + size_t(skipPixels) * 2 +
+                                   size_t(skipRows) * origRowSize;
+        
+        forEachBand(height, threadCount, [&](GLsizei beginRow, GLsizei endRow)
+        {
+            for (GLsizei i = beginRow; i < endRow; ++i)
+                convertYuyvRowToRgba(result + i * resultRowSize,
+                                     origStart + i * origRowSize, width);
+        });
+    }
+    
+    void convertNv12ToRgba(GLubyte* result, const GLubyte* yPlane,
+                           const GLubyte* uvPlane, GLsizei width,
+                           GLsizei height, GLsizei rowLength,
+                           GLsizei skipPixels, GLsizei skipRows,
+                           GLsizei threadCount)
+    {
+        if ((skipPixels % 2 != 0) || (skipRows % 2 != 0))
+        {
+            throw std::invalid_argument("Agl::convertNv12ToRgba(): "
+                                        "skipPixels and skipRows must be even");
+        }
+        if (rowLength == 0)
+            rowLength = width;
+        
+        const size_t resultRowSize = size_t(width) * 4;
+        const GLubyte* yStart = yPlane + skipPixels +
+                                size_t(skipRows) * rowLength;
+        const GLubyte* uvStart = uvPlane + skipPixels +
+                                 size_t(skipRows / 2) * rowLength;
+        
+        forEachBand(height, threadCount, [&](GLsizei beginRow, GLsizei endRow)
+        {
+            for (GLsizei i = beginRow; i < endRow; ++i)
+                convertNv12RowToRgba(result + i * resultRowSize,
+                                     yStart + size_t(i) * rowLength,
+                                     uvStart + size_t(i / 2) * rowLength, width);
+        });
+    }
+    
+    void convertBgraToRgba(GLubyte* result, const GLubyte* orig,
+                           GLsizei width, GLsizei height, GLsizei rowLength,
+                           GLsizei skipPixels, GLsizei skipRows,
+                           GLsizei threadCount)
+    {
+        if (rowLength == 0)
+            rowLength = width;
+        
+        const size_t origRowSize = size_t(rowLength) * 4;
+        const size_t resultRowSize = size_t(width) * 4;
+        const GLubyte* origStart = orig + size_t(skipPixels) * 4 +
+                                   size_t(skipRows) * origRowSize;
+        
+        forEachBand(height, threadCount, [&](GLsizei beginRow, GLsizei endRow)
+        {
+            for (GLsizei i = beginRow; i < endRow; ++i)
+                convertBgraRowToRgba(result + i * resultRowSize,
+                                     origStart + i * origRowSize, width);
+        });
+    }
+    
+    GLubyte* convertYuyvToRgba(ImagePool& pool, const GLubyte* orig,
+                               GLsizei width, GLsizei height, GLsizei rowLength,
+                               GLsizei skipPixels, GLsizei skipRows,
+                               GLsizei threadCount)
+    {
+        checkPoolImageSize(pool, width, height, 4, "Agl::convertYuyvToRgba()");
+        
+        GLubyte* result = pool.alloc();
+        try
+        {
+            convertYuyvToRgba(result, orig, width, height, rowLength,
+                              skipPixels, skipRows, threadCount);
+        }
+        catch (...)
+        {
+            pool.free(result);
+            throw;
+        }
+        return result;
+    }
+    
+    GLubyte* convertNv12ToRgba(ImagePool& pool, const GLubyte* yPlane,
+                               const GLubyte* uvPlane, GLsizei width,
+                               GLsizei height, GLsizei rowLength,
+                               GLsizei skipPixels, GLsizei skipRows,
+                               GLsizei threadCount)
+    {
+        checkPoolImageSize(pool, width, height, 4, "Agl::convertNv12ToRgba()");
+        
+        GLubyte* result = pool.alloc();
+        try
+        {
+            convertNv12ToRgba(result, yPlane, uvPlane, width, height,
+                              rowLength, skipPixels, skipRows, threadCount);
+        }
+        catch (...)
+        {
+            pool.free(result);
+            throw;
+        }
+        return result;
+    }
+    
+    GLubyte* convertBgraToRgba(ImagePool& pool, const GLubyte* orig,
+                               GLsizei width, GLsizei height, GLsizei rowLength,
+                               GLsizei skipPixels, GLsizei skipRows,
+                               GLsizei threadCount)
+    {
+        checkPoolImageSize(pool, width, height, 4, "Agl::convertBgraToRgba()");
+        
+        GLubyte* result = pool.alloc();
+        try
+        {
+            convertBgraToRgba(result, orig, width, height, rowLength,
+                              skipPixels, skipRows, threadCount);
+        }
+        catch (...)
+        {
+            pool.free(result);
+            throw;
+        }
+        return result;
+    }
+
+    void reduceYuyvToRgbaBy2(GLubyte* result, const GLubyte* orig,
+                             GLsizei width, GLsizei height, GLsizei rowLength,
+                             GLsizei skipPixels, GLsizei skipRows,
+                             GLsizei threadCount)
+    {
+        if (skipPixels % 2 != 0)
+        {
+            throw std::invalid_argument("Agl::reduceYuyvToRgbaBy2(): "
+                                        "skipPixels must be even");
+        }
+        if (rowLength == 0)
+            rowLength = width;
+        
+        const size_t origRowSize = size_t(rowLength) * 2;
+        const GLsizei resultWidth = width / 2;
+        const size_t resultRowSize = size_t(resultWidth) * 4;
+        const GLubyte* origStart = orig + size_t(skipPixels) * 2 +
+                                   size_t(skipRows) * origRowSize;
+        
+        forEachBand(height / 2, threadCount, [&](GLsizei beginRow,
+                                                 GLsizei endRow)
+        {
+            for (GLsizei i = beginRow; i < endRow; ++i)
+            {
+                const GLubyte* row0 = origStart + 2 * i * origRowSize;
+                reduceYuyvRowsToRgbaBy2(result + i * resultRowSize, row0,
+                                        row0 + origRowSize, resultWidth);
+            }
+        });
+    }
+    
+    void reduceNv12ToRgbaBy2(GLubyte* result, const GLubyte* yPlane,
+                             const GLubyte* uvPlane, GLsizei width,
+                             GLsizei height, GLsizei rowLength,
+                             GLsizei skipPixels, GLsizei skipRows,
+                             GLsizei threadCount)
+    {
+        if ((skipPixels % 2 != 0) || (skipRows % 2 != 0))
+        {
+            throw std::invalid_argument("Agl::reduceNv12ToRgbaBy2(): "
+                                        "skipPixels and skipRows must be even");
+        }
+        if (rowLength == 0)
+            rowLength = width;
+        
+        const GLsizei resultWidth = width / 2;
+        const size_t resultRowSize = size_t(resultWidth) * 4;
+        const GLubyte* yStart = yPlane + skipPixels +
+                                size_t(skipRows) * rowLength;
+        const GLubyte* uvStart = uvPlane + skipPixels +
+                                 size_t(skipRows / 2) * rowLength;
+        
+        forEachBand(height / 2, threadCount, [&](GLsizei beginRow,
+                                                 GLsizei endRow)
+        {
+            for (GLsizei i = beginRow; i < endRow; ++i)
+            {
+                const GLubyte* yRow0 = yStart + 2 * size_t(i) * rowLength;
+                reduceNv12RowsToRgbaBy2(result + i * resultRowSize, yRow0,
+                                        yRow0 + rowLength,
+                                        uvStart + size_t(i) * rowLength,
+                                        resultWidth);
+            }
+        });
+    }
+    
+    GLubyte* reduceYuyvToRgbaBy2(ImagePool& pool, const GLubyte* orig,
+                                 GLsizei width, GLsizei height,
+                                 GLsizei rowLength, GLsizei skipPixels,
+                                 GLsizei skipRows, GLsizei threadCount)
+    {
+        checkPoolImageSize(pool, width / 2, height / 2, 4,
+                           "Agl::reduceYuyvToRgbaBy2()");
+        
+        GLubyte* result = pool.alloc();
+        try
+        {
+            reduceYuyvToRgbaBy2(result, orig, width, height, rowLength,
+                                skipPixels, skipRows, threadCount);
+        }
+        catch (...)
+        {
+            pool.free(result);
+            throw;
+        }
+        return result;
+    }
+    
+    GLubyte* reduceNv12ToRgbaBy2(ImagePool& pool, const GLubyte* yPlane,
+                                 const GLubyte* uvPlane, GLsizei width,
+                                 GLsizei height, GLsizei rowLength,
+                                 GLsizei skipPixels, GLsizei skipRows,
+                                 GLsizei threadCount)
+    {
+        checkPoolImageSize(pool, width / 2, height / 2, 4,
+                           "Agl::reduceNv12ToRgbaBy2()");
+        
+        GLubyte* result = pool.alloc();
+        try
+        {
+            reduceNv12ToRgbaBy2(result, yPlane, uvPlane, width, height,
+                                rowLength, skipPixels, skipRows, threadCount);
+        }
+        catch (...)
+        {
+            pool.free(result);
+            throw;
+        }
+        return result;
+    }
+    
+    namespace
+    {
+        
+        // Throw a std::invalid_argument exception if a view has the wrong
+        // number of bytes per pixel for a conversion.
+        
+        void checkViewBytesPerPixel(const ImageView& view,
+                                    GLsizei bytesPerPixel, const char* function)
+        {
+            if (view.bytesPerPixel() != bytesPerPixel)
+            {
+                throw std::invalid_argument(std::string(function) + ": the "
+                                            "view has the wrong number of "
+                                            "bytes per pixel");
+            }
+        }
+        
+    }
+    
+    void reduceImageBy2(GLubyte* result, const ImageView& orig)
+    {
+        reduceImageBy2(result, orig.data(), orig.width(), orig.height(),
+                       orig.bytesPerPixel(), orig.rowLength(),
+                       orig.skipPixels(), orig.skipRows());
+    }
+    
+    void reduceImageBy2Parallel(GLubyte* result, const ImageView& orig,
+                                GLsizei threadCount)
+    {
+        reduceImageBy2Parallel(result, orig.data(), orig.width(), orig.height(),
+                               orig.bytesPerPixel(), orig.rowLength(),
+                               orig.skipPixels(), orig.skipRows(), threadCount);
+    }
+    
+    void generateImagePyramid(GLubyte* result, GLsizei levelCount,
+                              const ImageView& orig)
+    {
+        generateImagePyramid(result, levelCount, orig.data(), orig.width(),
+                             orig.height(), orig.bytesPerPixel(),
+                             orig.rowLength(), orig.skipPixels(),
+                             orig.skipRows());
+    }
+    
+    void reduceImage(GLubyte* result, GLsizei resultWidth, GLsizei resultHeight,
+                     const ImageView& orig)
+    {
+        reduceImage(result, resultWidth, resultHeight, orig.data(),
+                    orig.width(), orig.height(), orig.bytesPerPixel(),
+                    orig.rowLength(), orig.skipPixels(), orig.skipRows());
+    }
+    
+    void reduceImageBy2Srgb(GLubyte* result, const ImageView& orig)
+    {
+        reduceImageBy2Srgb(result, orig.data(), orig.width(), orig.height(),
+                           orig.bytesPerPixel(), orig.rowLength(),
+                           orig.skipPixels(), orig.skipRows());
+    }
+    
+    void convertYuyvToRgba(GLubyte* result, const ImageView& orig,
+                           GLsizei threadCount)
+    {
+        checkViewBytesPerPixel(orig, 2, "Agl::convertYuyvToRgba()");
+        convertYuyvToRgba(result, orig.data(), orig.width(), orig.height(),
+                          orig.rowLength(), orig.skipPixels(), orig.skipRows(),
+                          threadCount);
+    }
+    
+    void convertNv12ToRgba(GLubyte* result, const ImageView& yPlane,
+                           const GLubyte* uvPlane, GLsizei threadCount)
+    {
+        checkViewBytesPerPixel(yPlane, 1, "Agl::convertNv12ToRgba()");
+        convertNv12ToRgba(result, yPlane.data(), uvPlane, yPlane.width(),
+                          yPlane.height(), yPlane.rowLength(),
+                          yPlane.skipPixels(), yPlane.skipRows(), threadCount);
+    }
+    
+    void convertBgraToRgba(GLubyte* result, const ImageView& orig,
+                           GLsizei threadCount)
+    {
+        checkViewBytesPerPixel(orig, 4, "Agl::convertBgraToRgba()");
+        convertBgraToRgba(result, orig.data(), orig.width(), orig.height(),
+                          orig.rowLength(), orig.skipPixels(), orig.skipRows(),
+                          threadCount);
+    }
+    
+    GLubyte* convertYuyvToRgba(ImagePool& pool, const ImageView& orig,
+                               GLsizei threadCount)
+    {
+        checkViewBytesPerPixel(orig, 2, "Agl::convertYuyvToRgba()");
+        return convertYuyvToRgba(pool, orig.data(), orig.width(), orig.height(),
+                                 orig.rowLength(), orig.skipPixels(),
+                                 orig.skipRows(), threadCount);
+    }
+    
+    GLubyte* convertNv12ToRgba(ImagePool& pool, const ImageView& yPlane,
+                               const GLubyte* uvPlane, GLsizei threadCount)
+    {
+        checkViewBytesPerPixel(yPlane, 1, "Agl::convertNv12ToRgba()");
+        return convertNv12ToRgba(pool, yPlane.data(), uvPlane, yPlane.width(),
+                                 yPlane.height(), yPlane.rowLength(),
+                                 yPlane.skipPixels(), yPlane.skipRows(),
+                                 threadCount);
+    }
+    
+    GLubyte* convertBgraToRgba(ImagePool& pool, const ImageView& orig,
+                               GLsizei threadCount)
+    {
+        checkViewBytesPerPixel(orig, 4, "Agl::convertBgraToRgba()");
+        return convertBgraToRgba(pool, orig.data(), orig.width(), orig.height(),
+                                 orig.rowLength(), orig.skipPixels(),
+                                 orig.skipRows(), threadCount);
+    }
+    
+    void reduceYuyvToRgbaBy2(GLubyte* result, const ImageView& orig,
+                             GLsizei threadCount)
+    {
+        checkViewBytesPerPixel(orig, 2, "Agl::reduceYuyvToRgbaBy2()");
+        reduceYuyvToRgbaBy2(result, orig.data(), orig.width(), orig.height(),
+                            orig.rowLength(), orig.skipPixels(), orig.skipRows(),
+                            threadCount);
+    }
+    
+    void reduceNv12ToRgbaBy2(GLubyte* result, const ImageView& yPlane,
+                             const GLubyte* uvPlane, GLsizei threadCount)
+    {
+        checkViewBytesPerPixel(yPlane, 1, "Agl::reduceNv12ToRgbaBy2()");
+        reduceNv12ToRgbaBy2(result, yPlane.data(), uvPlane, yPlane.width(),
+                            yPlane.height(), yPlane.rowLength(),
+                            yPlane.skipPixels(), yPlane.skipRows(), threadCount);
+    }
+    
+    GLubyte* reduceYuyvToRgbaBy2(ImagePool& pool, const ImageView& orig,
+                                 GLsizei threadCount)
+    {
+        checkViewBytesPerPixel(orig, 2, "Agl::reduceYuyvToRgbaBy2()");
+        return reduceYuyvToRgbaBy2(pool, orig.data(), orig.width(),
+                                   orig.height(), orig.rowLength(),
+                                   orig.skipPixels(), orig.skipRows(),
+                                   threadCount);
+    }
+    
+    GLubyte* reduceNv12ToRgbaBy2(ImagePool& pool, const ImageView& yPlane,
+                                 const GLubyte* uvPlane, GLsizei threadCount)
+    {
+        checkViewBytesPerPixel(yPlane, 1, "Agl::reduceNv12ToRgbaBy2()");
+        return reduceNv12ToRgbaBy2(pool, yPlane.data(), uvPlane, yPlane.width(),
+                                   yPlane.height(), yPlane.rowLength(),
+                                   yPlane.skipPixels(), yPlane.skipRows(),
+                                   threadCount);
+    }
+    
+    ImageView imagePyramidLevel(const GLubyte* pyramid, GLsizei width,
+                                GLsizei height, GLsizei bytesPerPixel,
+                                GLsizei level)
+    {
+        if (level < 1)
+        {
+            throw std::out_of_range("Agl::imagePyramidLevel(): level must be "
+                                    "at least 1");
+        }
+        return ImageView(pyramid, width >> level, height >> level,
+                         bytesPerPixel, width / 2, 0,
+                         imagePyramidSkipRows(height, level));
+    }
 
-}
\ No newline at end of file
+}
@@ -32,8 +32,15 @@
 #include <OpenGL/gl3.h>
 #include <iostream>
 
+// The half-float type of the IlmBase library (which also provides Imath).
+
+class half;
+
 namespace Agl
 {
+    class ImagePool;
+    class ImageView;
+    
     // On OS X, glu.h, where gluErrorString() is defined, includes GL.h.
     // To avoid potential conflicts with the gl3.h that is needed for the
     // latest OpenGL functionality, here is an alternative routine for mapping
@@ -50,12 +57,304 @@ namespace Agl
     // region within the original image (like the GL_UNPACK_ROW_LENGTH,
     // GL_UNPACK_SKIP_PIXELS and GL_UNPACK_SKIP_ROWS parameters, respectively),
     // and that region is what will be reduced and stored as the result.
+    // Each result byte is the average of four original bytes, truncated.  The
+    // implementation uses SSE2, AVX2 or NEON instructions when the CPU has
+    // them, for images with 1 to 4 bytes per pixel, and the results are the
+    // same as without those instructions.
     
     void        reduceImageBy2(GLubyte* result, const GLubyte* orig,
                                GLsizei width, GLsizei height,
                                GLsizei bytesPerPixel,
                                GLsizei rowLength = 0, GLsizei skipPixels = 0,
                                GLsizei skipRows = 0);
+    
+    // A version of reduceImageBy2() that splits the result rows into bands and
+    // reduces the bands in parallel, on the threads of
+    // Agl::ThreadPool::shared() and the calling thread.  The threadCount
+    // argument is the number of bands, and thus the most threads that work
+    // at once.  The default of 0 uses every thread in the shared pool.
+    
+    void        reduceImageBy2Parallel(GLubyte* result, const GLubyte* orig,
+                                       GLsizei width, GLsizei height,
+                                       GLsizei bytesPerPixel,
+                                       GLsizei rowLength = 0,
+                                       GLsizei skipPixels = 0,
+                                       GLsizei skipRows = 0,
+                                       GLsizei threadCount = 0);
+    
+    // Versions of reduceImageBy2() and reduceImageBy2Parallel() for images
+    // with 16-bit, half-float or float components, as from HDR cameras, so
+    // those images need not be quantized to bytes before they are reduced.
+    // The componentsPerPixel argument takes the place of bytesPerPixel, and
+    // the row length and skips are still in pixels.  Each 16-bit result
+    // component is the average of four original components, truncated, as
+    // for bytes.  For half and float components the average is computed in
+    // float and, for half, rounded to the nearest half.  The implementation
+    // uses SSE2 or NEON instructions for 1, 2 or 4 components per pixel (and
+    // 3 with NEON), converting halves with F16C instructions when the CPU has
+    // them, and the results are the same as without those instructions.
+    
+    void        reduceImageBy2(GLushort* result, const GLushort* orig,
+                               GLsizei width, GLsizei height,
+                               GLsizei componentsPerPixel,
+                               GLsizei rowLength = 0, GLsizei skipPixels = 0,
+                               GLsizei skipRows = 0);
+    void        reduceImageBy2(half* result, const half* orig,
+                               GLsizei width, GLsizei height,
+                               GLsizei componentsPerPixel,
+                               GLsizei rowLength = 0, GLsizei skipPixels = 0,
+                               GLsizei skipRows = 0);
+    void        reduceImageBy2(GLfloat* result, const GLfloat* orig,
+                               GLsizei width, GLsizei height,
+                               GLsizei componentsPerPixel,
+                               GLsizei rowLength = 0, GLsizei skipPixels = 0,
+                               GLsizei skipRows = 0);
+    void        reduceImageBy2Parallel(GLushort* result, const GLushort* orig,
+                                       GLsizei width, GLsizei height,
+                                       GLsizei componentsPerPixel,
+                                       GLsizei rowLength = 0,
+                                       GLsizei skipPixels = 0,
+                                       GLsizei skipRows = 0,
+                                       GLsizei threadCount = 0);
+    void        reduceImageBy2Parallel(half* result, const half* orig,
+                                       GLsizei width, GLsizei height,
+                                       GLsizei componentsPerPixel,
+                                       GLsizei rowLength = 0,
+                                       GLsizei skipPixels = 0,
+                                       GLsizei skipRows = 0,
+                                       GLsizei threadCount = 0);
+    void        reduceImageBy2Parallel(GLfloat* result, const GLfloat* orig,
+                                       GLsizei width, GLsizei height,
+                                       GLsizei componentsPerPixel,
+                                       GLsizei rowLength = 0,
+                                       GLsizei skipPixels = 0,
+                                       GLsizei skipRows = 0,
+                                       GLsizei threadCount = 0);
+    
+    // Compute levelCount successive reductions by 2 of an image, as by
+    // repeated calls to reduceImageBy2(), but in one pass over the original
+    // image.  The pass works on tiles small enough to stay in the CPU cache,
+    // so each level is computed from the previous one before that level is
+    // evicted.  The orig, width, height, bytesPerPixel, rowLength, skipPixels
+    // and skipRows arguments are as for reduceImageBy2().  All the levels are
+    // stored in the one result buffer, which must be at least
+    // imagePyramidSize() bytes.  Level n (from 1 to levelCount) has
+    // dimensions width >> n by height >> n, and is stored as a region of an
+    // image with a row length of width / 2 pixels, starting at row
+    // imagePyramidSkipRows(height, n).  Thus a level can be passed directly to
+    // TextureUbyte::setData() with those rowLength and skipRows arguments.
+    // The size is at most half the size of the original image, so a buffer
+    // from an ImagePool for the original image size is always big enough.
+    
+    void        generateImagePyramid(GLubyte* result, GLsizei levelCount,
+                                     const GLubyte* orig,
+                                     GLsizei width, GLsizei height,
+                                     GLsizei bytesPerPixel,
+                                     GLsizei rowLength = 0,
+                                     GLsizei skipPixels = 0,
+                                     GLsizei skipRows = 0);
+    
+    // Reduce an image to an arbitrary smaller size, resultWidth by
+    // resultHeight, by area averaging: each result pixel is the average of
+    // the original pixels it covers, weighted by how much of each it covers.
+    // The ratio need not be an integer, nor the same in width and height.
+    // The weights are precomputed in fixed point, and the result is rounded
+    // to the nearest byte.  The other arguments are as for reduceImageBy2().
+    // If the result size is larger than the original image size, a
+    // std::invalid_argument exception is thrown.
+    
+    void        reduceImage(GLubyte* result, GLsizei resultWidth,
+                            GLsizei resultHeight, const GLubyte* orig,
+                            GLsizei width, GLsizei height,
+                            GLsizei bytesPerPixel, GLsizei rowLength = 0,
+                            GLsizei skipPixels = 0, GLsizei skipRows = 0);
+    
+    // A gamma-correct version of reduceImageBy2().  The original bytes are
+    // taken to be sRGB encoded, so they are converted to linear intensities
+    // (through a 16-bit lookup table) before being averaged, and the average
+    // is converted back to sRGB (through a compact inverse table, with one
+    // correction step that makes the rounding exact).  Averaging the encoded
+    // bytes directly, as reduceImageBy2() does, darkens edges between bright
+    // and dark areas.  With 2 or 4 bytes per pixel, the last byte of each
+    // pixel is taken to be alpha, which is linear already and is averaged
+    // directly.  Each result byte is rounded to nearest.  The arguments are
+    // as for reduceImageBy2(), except that bytesPerPixel must be from 1 to 4
+    // or a std::invalid_argument exception is thrown.
+    
+    void        reduceImageBy2Srgb(GLubyte* result, const GLubyte* orig,
+                                   GLsizei width, GLsizei height,
+                                   GLsizei bytesPerPixel,
+                                   GLsizei rowLength = 0,
+                                   GLsizei skipPixels = 0,
+                                   GLsizei skipRows = 0);
+    
+    // Convert a camera image to RGBA, four bytes per pixel, for use with
+    // TextureUbyte::setData().  The result must be allocated by the caller
+    // with width * height * 4 bytes.  The width and height arguments are the
+    // dimensions of the region to convert, and rowLength, skipPixels and
+    // skipRows specify the region within the original image, as for
+    // reduceImageBy2().  The result rows are converted in bands in parallel,
+    // as for reduceImageBy2Parallel() with the threadCount argument.  The
+    // implementation uses SSE2 instructions when the CPU has them, and the
+    // results are the same as without those instructions.
+    //
+    // YUYV (4:2:2) and NV12 (4:2:0) images are taken to use the ITU-R BT.601
+    // coefficients and video range (16 to 235 for Y, 16 to 240 for U and V),
+    // as is typical for cameras.  A YUYV image has two bytes per pixel, with
+    // each pair of pixels sharing the U and V bytes.  An NV12 image has a
+    // plane of Y bytes, and a plane of interleaved U and V bytes for each 2 by
+    // 2 block of pixels, whose rows have the same length in bytes as the rows
+    // of the Y plane.  Since the chroma is shared, skipPixels must be even for
+    // YUYV, and skipPixels and skipRows must be even for NV12, or a
+    // std::invalid_argument exception is thrown.  A BGRA image has four bytes
+    // per pixel, with blue and red swapped relative to RGBA.
+    
+    void        convertYuyvToRgba(GLubyte* result, const GLubyte* orig,
+                                  GLsizei width, GLsizei height,
+                                  GLsizei rowLength = 0,
+                                  GLsizei skipPixels = 0,
+                                  GLsizei skipRows = 0,
+                                  GLsizei threadCount = 0);
+    void        convertNv12ToRgba(GLubyte* result, const GLubyte* yPlane,
+                                  const GLubyte* uvPlane,
+                                  GLsizei width, GLsizei height,
+                                  GLsizei rowLength = 0,
+                                  GLsizei skipPixels = 0,
+                                  GLsizei skipRows = 0,
+                                  GLsizei threadCount = 0);
+    void        convertBgraToRgba(GLubyte* result, const GLubyte* orig,
+                                  GLsizei width, GLsizei height,
+                                  GLsizei rowLength = 0,
+                                  GLsizei skipPixels = 0,
+                                  GLsizei skipRows = 0,
+                                  GLsizei threadCount = 0);
+    
+    // Versions of the conversions that store the result in memory obtained
+    // from pool.alloc(), and return that memory, so the converted image can
+    // be passed on (e.g., to another thread) without being copied.  The
+    // pool's image size must be width by height with 4 bytes per pixel, or a
+    // std::invalid_argument exception is thrown.
+    
+    GLubyte*    convertYuyvToRgba(ImagePool& pool, const GLubyte* orig,
+                                  GLsizei width, GLsizei height,
+                                  GLsizei rowLength = 0,
+                                  GLsizei skipPixels = 0,
+                                  GLsizei skipRows = 0,
+                                  GLsizei threadCount = 0);
+    GLubyte*    convertNv12ToRgba(ImagePool& pool, const GLubyte* yPlane,
+                                  const GLubyte* uvPlane,
+                                  GLsizei width, GLsizei height,
+                                  GLsizei rowLength = 0,
+                                  GLsizei skipPixels = 0,
+                                  GLsizei skipRows = 0,
+                                  GLsizei threadCount = 0);
+    GLubyte*    convertBgraToRgba(ImagePool& pool, const GLubyte* orig,
+                                  GLsizei width, GLsizei height,
+                                  GLsizei rowLength = 0,
+                                  GLsizei skipPixels = 0,
+                                  GLsizei skipRows = 0,
+                                  GLsizei threadCount = 0);
+    
+    // Convert a YUYV or NV12 camera image to RGBA and reduce it by a factor
+    // of two in width and in height, in one pass that reads each original
+    // byte once and writes only the reduced result.  The arguments are as
+    // for convertYuyvToRgba() and convertNv12ToRgba(), and the result, which
+    // must be allocated by the caller, is (width / 2) * (height / 2) * 4
+    // bytes.  Each result pixel is converted from the averages of the Y, U
+    // and V samples it covers, rounded to nearest, which differs from
+    // converting and then averaging only where a color is out of the RGB
+    // range and is clamped.
+    
+    void        reduceYuyvToRgbaBy2(GLubyte* result, const GLubyte* orig,
+                                    GLsizei width, GLsizei height,
+                                    GLsizei rowLength = 0,
+                                    GLsizei skipPixels = 0,
+                                    GLsizei skipRows = 0,
+                                    GLsizei threadCount = 0);
+    void        reduceNv12ToRgbaBy2(GLubyte* result, const GLubyte* yPlane,
+                                    const GLubyte* uvPlane,
+                                    GLsizei width, GLsizei height,
+                                    GLsizei rowLength = 0,
+                                    GLsizei skipPixels = 0,
+                                    GLsizei skipRows = 0,
+                                    GLsizei threadCount = 0);
+    
+    // Versions that store the result in memory obtained from pool.alloc(),
+    // and return that memory.  The pool's image size must be width / 2 by
+    // height / 2 with 4 bytes per pixel, or a std::invalid_argument
+    // exception is thrown.
+    
+    GLubyte*    reduceYuyvToRgbaBy2(ImagePool& pool, const GLubyte* orig,
+                                    GLsizei width, GLsizei height,
+                                    GLsizei rowLength = 0,
+                                    GLsizei skipPixels = 0,
+                                    GLsizei skipRows = 0,
+                                    GLsizei threadCount = 0);
+    GLubyte*    reduceNv12ToRgbaBy2(ImagePool& pool, const GLubyte* yPlane,
+                                    const GLubyte* uvPlane,
+                                    GLsizei width, GLsizei height,
+                                    GLsizei rowLength = 0,
+                                    GLsizei skipPixels = 0,
+                                    GLsizei skipRows = 0,
+                                    GLsizei threadCount = 0);
+    
+    // Versions of the image utilities that take the original image as an
+    // Agl::ImageView, whose parameters take the place of the orig, width,
+    // height, bytesPerPixel, rowLength, skipPixels and skipRows arguments.
+    // The YUYV, NV12 and BGRA conversions need views with 2, 1 and 4 bytes
+    // per pixel, respectively, or a std::invalid_argument exception is
+    // thrown.  For NV12, the view is of the Y plane, and the UV plane has the
+    // same row length.
+    
+    void        reduceImageBy2(GLubyte* result, const ImageView& orig);
+    void        reduceImageBy2Parallel(GLubyte* result, const ImageView& orig,
+                                       GLsizei threadCount = 0);
+    void        generateImagePyramid(GLubyte* result, GLsizei levelCount,
+                                     const ImageView& orig);
+    void        reduceImage(GLubyte* result, GLsizei resultWidth,
+                            GLsizei resultHeight, const ImageView& orig);
+    void        reduceImageBy2Srgb(GLubyte* result, const ImageView& orig);
+    void        convertYuyvToRgba(GLubyte* result, const ImageView& orig,
+                                  GLsizei threadCount = 0);
+    void        convertNv12ToRgba(GLubyte* result, const ImageView& yPlane,
+                                  const GLubyte* uvPlane,
+                                  GLsizei threadCount = 0);
+    void        convertBgraToRgba(GLubyte* result, const ImageView& orig,
+                                  GLsizei threadCount = 0);
+    GLubyte*    convertYuyvToRgba(ImagePool& pool, const ImageView& orig,
+                                  GLsizei threadCount = 0);
+    GLubyte*    convertNv12ToRgba(ImagePool& pool, const ImageView& yPlane,
+                                  const GLubyte* uvPlane,
+                                  GLsizei threadCount = 0);
+    GLubyte*    convertBgraToRgba(ImagePool& pool, const ImageView& orig,
+                                  GLsizei threadCount = 0);
+    void        reduceYuyvToRgbaBy2(GLubyte* result, const ImageView& orig,
+                                    GLsizei threadCount = 0);
+    void        reduceNv12ToRgbaBy2(GLubyte* result, const ImageView& yPlane,
+                                    const GLubyte* uvPlane,
+                                    GLsizei threadCount = 0);
+    GLubyte*    reduceYuyvToRgbaBy2(ImagePool& pool, const ImageView& orig,
+                                    GLsizei threadCount = 0);
+    GLubyte*    reduceNv12ToRgbaBy2(ImagePool& pool, const ImageView& yPlane,
+                                    const GLubyte* uvPlane,
+                                    GLsizei threadCount = 0);
+    
+    // The number of bytes needed for the result of generateImagePyramid().
+    
+    size_t      imagePyramidSize(GLsizei width, GLsizei height,
+                                 GLsizei bytesPerPixel, GLsizei levelCount);
+    
+    // The first row of level n in the result of generateImagePyramid().
+    
+    GLsizei     imagePyramidSkipRows(GLsizei height, GLsizei level);
+    
+    // A view of level n, for n >= 1, in the result of generateImagePyramid()
+    // for an original image of the specified dimensions.  A level less than 1
+    // throws a std::out_of_range exception.
+    
+    ImageView   imagePyramidLevel(const GLubyte* pyramid, GLsizei width,
+                                  GLsizei height, GLsizei bytesPerPixel,
+                                  GLsizei level);
 
 }
 